@@ -2,17 +2,15 @@
 #include <QFile> 
 #include <QStyleFactory> 
 #include <QThreadPool> // For managing global thread pool
-#include <QThread>     // For idealThreadCount
+#include "utils/ThreadBudget.h"
 #include "mainwindow.h"
 
 int main(int argc, char *argv[])
 {
     // It's good practice to set this early, before threads might be implicitly started.
-    // Limit concurrent thumbnail threads to reduce choppiness.
-    // Using half of ideal thread count, but at least 1, and max around 4-8 for I/O bound tasks.
-    int idealThreads = QThread::idealThreadCount();
-    int thumbnailThreads = qMax(1, qMin(idealThreads / 2, 4)); 
-    QThreadPool::globalInstance()->setMaxThreadCount(thumbnailThreads);
+    // Limit concurrent thumbnail threads to reduce choppiness. The rest of the machine is
+    // left to the tagger's intra-op pool (see ThreadBudget).
+    QThreadPool::globalInstance()->setMaxThreadCount(ThreadBudget::thumbnailThreads());
     qDebug() << "Global thread pool max threads set to:" << QThreadPool::globalInstance()->maxThreadCount();
 
 
@@ -0,0 +1,115 @@
+#include "TagDictionary.h"
+
+TagDictionary &TagDictionary::instance()
+{
+    static TagDictionary dictionary;
+    return dictionary;
+}
+
+quint32 TagDictionary::intern(const QString &tag)
+{
+    const QString trimmed = tag.trimmed();
+    if (trimmed.isEmpty()) {
+        return InvalidId;
+    }
+    {
+        QReadLocker locker(&m_lock);
+        const auto it = m_ids.constFind(trimmed);
+        if (it != m_ids.constEnd()) {
+            return it.value();
+        }
+    }
+    QWriteLocker locker(&m_lock);
+    return internLocked(trimmed);
+}
+
+QVector<quint32> TagDictionary::intern(const QStringList &tags)
+{
+    QVector<quint32> ids;
+    ids.reserve(tags.size());
+    for (const QString &tag : tags) {
+        const quint32 id = intern(tag);
+        if (id != InvalidId) {
+            ids.append(id);
+        }
+    }
+    return ids;
+}
+
+quint32 TagDictionary::internLocked(const QString &tag)
+{
+    const auto existing = m_ids.constFind(tag); // Another thread may have added it between the locks
+    if (existing != m_ids.constEnd()) {
+        return existing.value();
+    }
+    const quint32 id = static_cast<quint32>(m_entries.size());
+    Entry entry;
+    entry.text = tag;
+    entry.spaced = tag.contains('_') ? QString(tag).replace('_', ' ') : tag;
+    entry.underscored = tag.contains(' ') ? QString(tag).replace(' ', '_') : tag;
+    entry.foldedId = id;
+    m_entries.push_back(entry);
+    m_ids.insert(tag, id);
+
+    const QString folded = entry.spaced.toCaseFolded();
+    if (folded != tag) {
+        const quint32 foldedId = internLocked(folded); // The folded form folds to itself, so this recurses once
+        m_entries[id].foldedId = foldedId;
+    }
+    return id;
+}
+
+quint32 TagDictionary::find(const QString &tag) const
+{
+    QReadLocker locker(&m_lock);
+    return m_ids.value(tag.trimmed(), InvalidId);
+}
+
+quint32 TagDictionary::findFolded(const QString &tag) const
+{
+    // Interning a tag also interns its folded form, which is its own folded id
+    return find(tag.trimmed().replace('_', ' ').toCaseFolded());
+}
+
+QString TagDictionary::text(quint32 id) const
+{
+    QReadLocker locker(&m_lock);
+    return id < m_entries.size() ? m_entries[id].text : QString();
+}
+
+QString TagDictionary::spaced(quint32 id) const
+{
+    QReadLocker locker(&m_lock);
+    return id < m_entries.size() ? m_entries[id].spaced : QString();
+}
+
+QString TagDictionary::underscored(quint32 id) const
+{
+    QReadLocker locker(&m_lock);
+    return id < m_entries.size() ? m_entries[id].underscored : QString();
+}
+
+quint32 TagDictionary::foldedId(quint32 id) const
+{
+    QReadLocker locker(&m_lock);
+    return id < m_entries.size() ? m_entries[id].foldedId : InvalidId;
+}
+
+QStringList TagDictionary::texts(const QVector<quint32> &ids) const
+{
+    QStringList result;
+    result.reserve(ids.size());
+    QReadLocker locker(&m_lock);
+    for (quint32 id : ids) {
+        if (id < m_entries.size()) {
+            result.append(m_entries[id].text);
+        }
+    }
+    return result;
+}
+
+int TagDictionary::size() const
+{
+    QReadLocker locker(&m_lock);
+    return static_cast<int>(m_entries.size());
+}
@@ -0,0 +1,52 @@
+#ifndef TAGDICTIONARY_H
+#define TAGDICTIONARY_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QReadWriteLock>
+#include <deque>
+
+// Process-wide tag interning: every distinct tag string gets a stable quint32 id, so captions,
+// vocabularies and statistics can hold, compare and count integers instead of strings.
+// Each entry keeps its spaced ("long hair") and underscored ("long_hair") spellings and the id of
+// its folded form (case-folded, spaced), so case/underscore-insensitive dedup is an id comparison.
+// Ids are never reused or freed. Thread-safe; lookups of known tags only take a read lock.
+class TagDictionary
+{
+public:
+    static const quint32 InvalidId = 0xFFFFFFFFu;
+
+    static TagDictionary &instance();
+
+    quint32 intern(const QString &tag); // Trimmed first; InvalidId for an empty tag
+    QVector<quint32> intern(const QStringList &tags); // Empty tags are skipped
+    quint32 find(const QString &tag) const; // InvalidId if never interned
+    quint32 findFolded(const QString &tag) const; // foldedId() of tag without interning it; InvalidId if nothing folds the same
+
+    QString text(quint32 id) const;        // As interned
+    QString spaced(quint32 id) const;      // Underscores shown as spaces
+    QString underscored(quint32 id) const; // Spaces stored as underscores
+    quint32 foldedId(quint32 id) const;    // Same for tags differing only in case or '_' vs ' '
+    QStringList texts(const QVector<quint32> &ids) const;
+    int size() const;
+
+private:
+    TagDictionary() = default;
+
+    struct Entry {
+        QString text;
+        QString spaced;      // Shares text's data when there is nothing to replace
+        QString underscored;
+        quint32 foldedId;
+    };
+
+    quint32 internLocked(const QString &tag); // m_lock held for writing
+
+    mutable QReadWriteLock m_lock;
+    std::deque<Entry> m_entries; // Index is the id
+    QHash<QString, quint32> m_ids;
+};
+
+#endif // TAGDICTIONARY_H
@@ -0,0 +1,28 @@
+#include "TaggingResult.h"
+#include "TagDictionary.h"
+
+void TaggingResult::reserve(size_t count)
+{
+    tagIds.reserve(count);
+    scores.reserve(count);
+    categories.reserve(count);
+}
+
+void TaggingResult::append(quint32 tagId, float score, quint8 category)
+{
+    tagIds.push_back(tagId);
+    scores.push_back(score);
+    categories.push_back(category);
+}
+
+QStringList TaggingResult::toStringList(bool spaced) const
+{
+    // Both spellings are precomputed per dictionary entry, so this is a lookup, not a replace pass
+    const TagDictionary &dictionary = TagDictionary::instance();
+    QStringList tags;
+    tags.reserve(size());
+    for (quint32 tagId : tagIds) {
+        tags.append(spaced ? dictionary.spaced(tagId) : dictionary.text(tagId));
+    }
+    return tags;
+}
@@ -0,0 +1,26 @@
+#ifndef TAGGINGRESULT_H
+#define TAGGINGRESULT_H
+
+#include <QStringList>
+#include <vector>
+
+// One image's tagger output in caption order: TagDictionary ids with their confidences and CSV
+// categories. Stays numeric through the pipeline; text is only produced where a caption is shown
+// or written (toStringList).
+struct TaggingResult
+{
+    enum Category : quint8 { GeneralCategory = 0, CharacterCategory = 4, RatingCategory = 9 };
+
+    std::vector<quint32> tagIds;    // TagDictionary ids
+    std::vector<float> scores;      // Confidence in [0, 1], parallel to tagIds
+    std::vector<quint8> categories; // CSV category, parallel to tagIds
+
+    int size() const { return static_cast<int>(tagIds.size()); }
+    bool isEmpty() const { return tagIds.empty(); }
+    void reserve(size_t count);
+    void append(quint32 tagId, float score, quint8 category);
+
+    QStringList toStringList(bool spaced) const; // spaced: "long hair" rather than "long_hair" (remove_separator)
+};
+
+#endif // TAGGINGRESULT_H
@@ -3,6 +3,9 @@
 #include <QFileInfo>
 #include <QPixmap>
 #include <QPainter> // For placeholder icon drawing if needed
+#include <QHash>
+#include <QVector>
+#include <algorithm>
 
 ThumbnailListModel::ThumbnailListModel(QObject *parent)
     : QAbstractListModel(parent)
@@ -16,7 +19,7 @@ ThumbnailListModel::ThumbnailListModel(QObject *parent)
     // QPainter p(&placeholderPixmap);
     // p.drawText(placeholderPixmap.rect(), Qt::AlignCenter, "?");
     // p.end();
-    m_placeholderIcon = QIcon(placeholderPixmap);
+    m_placeholderPixmap = placeholderPixmap;
 }
 
 int ThumbnailListModel::rowCount(const QModelIndex &parent) const
@@ -36,14 +39,11 @@ QVariant ThumbnailListModel::data(const QModelIndex &index, int role) const
     if (role == Qt::DisplayRole) {
         return QFileInfo(filePath).fileName();
     } else if (role == Qt::DecorationRole) {
-        if (index.row() < m_thumbnails.count() && !m_thumbnails.at(index.row()).isNull()) {
-            QPixmap p = m_thumbnails.at(index.row()).pixmap(m_thumbnailSize);
-            // qDebug() << "ThumbnailListModel::data returning for row" << index.row() << "Pixmap isNull:" << p.isNull() << "Size:" << p.size();
-            return p; 
+        QPixmap pixmap = m_residency.find(index.row()); // Counts as a view for LRU purposes
+        if (!pixmap.isNull()) {
+            return pixmap; // Composited at m_thumbnailSize by the decode pool
         } else {
-            QPixmap p = m_placeholderIcon.pixmap(m_thumbnailSize);
-            // qDebug() << "ThumbnailListModel::data returning PLACEHOLDER for row" << index.row() << "Pixmap isNull:" << p.isNull() << "Size:" << p.size();
-            return p; 
+            return m_placeholderPixmap; 
         }
     }
     return QVariant();
@@ -53,13 +53,103 @@ void ThumbnailListModel::setFilePaths(const QStringList &paths)
 {
     beginResetModel();
     m_filePaths = paths;
-    m_thumbnails.clear();
-    m_thumbnails.resize(m_filePaths.count()); // Resize to hold icons, initially null
+    m_residency.clear();
     endResetModel();
+    emit residencyChanged();
 
     // Do NOT request any thumbnails here. MainWindow will handle it.
 }
 
+void ThumbnailListModel::appendFilePaths(const QStringList &paths)
+{
+    if (paths.isEmpty()) {
+        return;
+    }
+    beginInsertRows(QModelIndex(), m_filePaths.count(), m_filePaths.count() + paths.count() - 1);
+    m_filePaths.append(paths);
+    endInsertRows();
+}
+
+void ThumbnailListModel::reorderFilePaths(const QStringList &orderedPaths)
+{
+    if (orderedPaths.count() != m_filePaths.count()) {
+        setFilePaths(orderedPaths); // Not a permutation, fall back to a reset
+        return;
+    }
+    QHash<QString, int> newRowOfPath;
+    newRowOfPath.reserve(orderedPaths.count());
+    for (int row = 0; row < orderedPaths.count(); ++row) {
+        newRowOfPath.insert(orderedPaths.at(row), row);
+    }
+    QVector<int> newRowForOldRow(m_filePaths.count(), -1);
+    for (int row = 0; row < m_filePaths.count(); ++row) {
+        newRowForOldRow[row] = newRowOfPath.value(m_filePaths.at(row), -1);
+    }
+
+    emit layoutAboutToBeChanged();
+    const QModelIndexList oldIndexes = persistentIndexList();
+    QModelIndexList newIndexes;
+    newIndexes.reserve(oldIndexes.size());
+    for (const QModelIndex &oldIndex : oldIndexes) {
+        const int newRow = newRowForOldRow.value(oldIndex.row(), -1);
+        newIndexes.append(newRow >= 0 ? index(newRow, oldIndex.column()) : QModelIndex());
+    }
+    m_filePaths = orderedPaths;
+    m_residency.remapRows(newRowForOldRow);
+    changePersistentIndexList(oldIndexes, newIndexes);
+    emit layoutChanged();
+}
+
+void ThumbnailListModel::insertFilePath(int row, const QString &path)
+{
+    row = qBound(0, row, m_filePaths.count());
+    beginInsertRows(QModelIndex(), row, row);
+    m_filePaths.insert(row, path);
+    m_residency.shiftRows(row, 1);
+    endInsertRows();
+}
+
+void ThumbnailListModel::removeFilePath(int row)
+{
+    if (row < 0 || row >= m_filePaths.count()) {
+        return;
+    }
+    beginRemoveRows(QModelIndex(), row, row);
+    m_filePaths.removeAt(row);
+    m_residency.remove(row);
+    m_residency.shiftRows(row + 1, -1);
+    endRemoveRows();
+    emit residencyChanged();
+}
+
+void ThumbnailListModel::moveFilePath(int fromRow, int toRow, const QString &newPath)
+{
+    if (fromRow < 0 || fromRow >= m_filePaths.count() || toRow < 0 || toRow >= m_filePaths.count()) {
+        return;
+    }
+    if (fromRow == toRow) {
+        m_filePaths[fromRow] = newPath;
+        emit dataChanged(index(fromRow, 0), index(fromRow, 0), {Qt::DisplayRole});
+        return;
+    }
+    // Qt's destination is the row to insert before, counted before the move
+    beginMoveRows(QModelIndex(), fromRow, fromRow, QModelIndex(), toRow > fromRow ? toRow + 1 : toRow);
+    m_filePaths.move(fromRow, toRow);
+    m_filePaths[toRow] = newPath;
+    m_residency.moveRow(fromRow, toRow); // Same content, so the thumbnail moves along
+    endMoveRows();
+}
+
+void ThumbnailListModel::invalidateThumbnail(int row)
+{
+    if (row < 0 || row >= m_filePaths.count() || !m_residency.contains(row)) {
+        return;
+    }
+    m_residency.remove(row);
+    emit dataChanged(index(row, 0), index(row, 0), {Qt::DecorationRole});
+    emit residencyChanged();
+}
+
 QString ThumbnailListModel::filePathAt(int row) const
 {
     if (row >= 0 && row < m_filePaths.count()) {
@@ -72,8 +162,9 @@ void ThumbnailListModel::clear()
 {
     beginResetModel();
     m_filePaths.clear();
-    m_thumbnails.clear();
+    m_residency.clear();
     endResetModel();
+    emit residencyChanged();
     if (m_thumbnailLoader) {
         m_thumbnailLoader->clearQueue();
     }
@@ -84,23 +175,10 @@ void ThumbnailListModel::clearCache()
     if (m_filePaths.isEmpty()) {
         return;
     }
-    // To effectively clear the cache and trigger re-fetch,
-    // we can re-initialize m_thumbnails to a list of null QIcons
-    // of the same size as m_filePaths.
-    // Then emit dataChanged for all items to make the view re-query.
-    
-    // Simpler: just clear and resize. data() will request if null.
     beginResetModel(); // This is heavy but ensures view updates correctly.
-    m_thumbnails.clear();
-    m_thumbnails.resize(m_filePaths.count()); // Fill with null QIcons
+    m_residency.clear();
     endResetModel();
-
-    // Alternative: emit dataChanged for all rows if beginResetModel is too disruptive
-    // if (!m_filePaths.isEmpty()) {
-    //     m_thumbnails.clear();
-    //     m_thumbnails.resize(m_filePaths.count());
-    //     emit dataChanged(index(0, 0), index(m_filePaths.count() - 1, 0), {Qt::DecorationRole});
-    // }
+    emit residencyChanged();
 }
 
 void ThumbnailListModel::setThumbnailLoader(ThumbnailLoader *loader)
@@ -108,7 +186,7 @@ void ThumbnailListModel::setThumbnailLoader(ThumbnailLoader *loader)
     m_thumbnailLoader = loader;
     if (m_thumbnailLoader) {
         // Connect the loader's signal to our slot
-        connect(m_thumbnailLoader, &ThumbnailLoader::thumbnailReady, this, &ThumbnailListModel::onThumbnailReady);
+        connect(m_thumbnailLoader, &ThumbnailLoader::thumbnailsReady, this, &ThumbnailListModel::onThumbnailsReady);
     }
 }
 
@@ -118,29 +196,48 @@ void ThumbnailListModel::setThumbnailSize(const QSize &size)
     // Recreate placeholder with new size
     QPixmap placeholderPixmap(m_thumbnailSize);
     placeholderPixmap.fill(Qt::gray);
-    m_placeholderIcon = QIcon(placeholderPixmap);
+    m_placeholderPixmap = placeholderPixmap;
     // Existing thumbnails might need to be re-requested or re-scaled if size changes significantly.
     // For simplicity, we'll assume size is set once.
 }
 
+void ThumbnailListModel::setMemoryBudget(qint64 byteBudget, qint64 compressedByteBudget)
+{
+    m_residency.setBudget(byteBudget, compressedByteBudget);
+    emit residencyChanged();
+}
+
 bool ThumbnailListModel::isThumbnailLoaded(int row) const
 {
-    if (row >= 0 && row < m_thumbnails.count()) {
-        // A thumbnail is considered "loaded" if it's not null AND not the placeholder.
-        // This assumes m_placeholderIcon is distinct from any validly loaded (even if blank) icon.
-        // If m_thumbnails can contain null QIcons for unloaded items, then !m_thumbnails.at(row).isNull() is enough.
-        // Since we initialize m_thumbnails with default-constructed QIcons (which are null),
-        // checking for !isNull is the correct way.
-        return !m_thumbnails.at(row).isNull();
-    }
-    return false; // Or true if out of bounds should mean "nothing to load"
+    return m_residency.contains(row); // False again once evicted, so the next viewport pass re-requests it
 }
 
-void ThumbnailListModel::onThumbnailReady(int row, const QIcon &thumbnail)
+void ThumbnailListModel::onThumbnailsReady(const QList<ThumbnailResult> &results)
 {
-    if (row >= 0 && row < m_thumbnails.count()) {
-        m_thumbnails[row] = thumbnail;
-        QModelIndex idx = index(row, 0);
-        emit dataChanged(idx, idx, {Qt::DecorationRole});
+    QList<int> updatedRows;
+    updatedRows.reserve(results.size());
+    for (const ThumbnailResult &result : results) {
+        // Results can outlive the folder they were requested for; the path check keeps them off the new rows
+        if (result.row < 0 || result.row >= m_filePaths.count() || m_filePaths.at(result.row) != result.filePath) {
+            continue;
+        }
+        m_residency.insert(result.row, QPixmap::fromImage(result.image));
+        updatedRows.append(result.row);
+    }
+    if (updatedRows.isEmpty()) {
+        return;
+    }
+    emit residencyChanged();
+
+    std::sort(updatedRows.begin(), updatedRows.end());
+    int rangeStart = updatedRows.first();
+    for (int i = 1; i <= updatedRows.size(); ++i) {
+        if (i < updatedRows.size() && updatedRows.at(i) <= updatedRows.at(i - 1) + 1) {
+            continue;
+        }
+        emit dataChanged(index(rangeStart, 0), index(updatedRows.at(i - 1), 0), {Qt::DecorationRole});
+        if (i < updatedRows.size()) {
+            rangeStart = updatedRows.at(i);
+        }
     }
 }
@@ -6,6 +6,9 @@
 #include <QPixmapCache>
 #include <QSize>
 #include <QIcon>
+#include <QPixmap>
+#include "services/ThumbnailWorker.h" // ThumbnailResult
+#include "ThumbnailResidency.h"
 
 // Forward declaration if ThumbnailLoader is a separate class
 class ThumbnailLoader; 
@@ -21,6 +24,13 @@ public:
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
 
     void setFilePaths(const QStringList &paths);
+    void appendFilePaths(const QStringList &paths);     // Streaming population, no reset
+    void reorderFilePaths(const QStringList &orderedPaths); // Same paths in a new order; keeps loaded thumbnails
+    // Row-level edits for files changed on disk; loaded thumbnails of the other rows are kept
+    void insertFilePath(int row, const QString &path);
+    void removeFilePath(int row);
+    void moveFilePath(int fromRow, int toRow, const QString &newPath); // toRow is the row it ends up at
+    void invalidateThumbnail(int row); // Content changed; re-requested on the next viewport pass
     QString filePathAt(int row) const;
     void clear();
 
@@ -29,13 +39,20 @@ public:
     bool isThumbnailLoaded(int row) const; 
     void clearCache(); // New method to clear cached thumbnails
 
+    // Memory ceiling for resident thumbnails; evicted rows report !isThumbnailLoaded() and get re-requested
+    void setMemoryBudget(qint64 byteBudget, qint64 compressedByteBudget);
+    const ThumbnailResidency &residency() const { return m_residency; }
+
+signals:
+    void residencyChanged(); // After thumbnails were added or evicted
+
 public slots:
-    void onThumbnailReady(int row, const QIcon &thumbnail); 
+    void onThumbnailsReady(const QList<ThumbnailResult> &results); // One dataChanged per contiguous run of rows
 
 private:
     QStringList m_filePaths;
-    QList<QIcon> m_thumbnails; // Cache for loaded thumbnails (or use QPixmapCache)
-    QIcon m_placeholderIcon;
+    mutable ThumbnailResidency m_residency; // Ready-to-draw thumbnails by row; data() refreshes recency
+    QPixmap m_placeholderPixmap;
     QSize m_thumbnailSize;
     mutable ThumbnailLoader *m_thumbnailLoader; // Made mutable
 };
@@ -0,0 +1,181 @@
+#include "ThumbnailResidency.h"
+#include <QBuffer>
+#include <QImage>
+
+ThumbnailResidency::ThumbnailResidency(qint64 byteBudget, qint64 compressedByteBudget)
+    : m_byteBudget(byteBudget)
+    , m_compressedByteBudget(compressedByteBudget)
+    , m_pixmapBytes(0)
+    , m_compressedBytes(0)
+{
+}
+
+void ThumbnailResidency::setBudget(qint64 byteBudget, qint64 compressedByteBudget)
+{
+    m_byteBudget = qMax<qint64>(0, byteBudget);
+    m_compressedByteBudget = qMax<qint64>(0, compressedByteBudget);
+    evictPixmaps();
+    evictCompressed();
+}
+
+qint64 ThumbnailResidency::bytesFor(const QPixmap &pixmap)
+{
+    return qint64(pixmap.width()) * pixmap.height() * qMax(1, pixmap.depth() / 8);
+}
+
+QPixmap ThumbnailResidency::find(int row)
+{
+    auto it = m_pixmapIndex.constFind(row);
+    if (it != m_pixmapIndex.constEnd()) {
+        m_pixmaps.splice(m_pixmaps.begin(), m_pixmaps, it.value()); // Iterators stay valid across splice
+        return m_pixmaps.front().pixmap;
+    }
+
+    auto compressed = m_compressedIndex.constFind(row);
+    if (compressed == m_compressedIndex.constEnd()) {
+        return QPixmap();
+    }
+    QImage image;
+    image.loadFromData(compressed.value()->data);
+    removeCompressed(row);
+    if (image.isNull()) {
+        return QPixmap();
+    }
+    QPixmap pixmap = QPixmap::fromImage(image);
+    insert(row, pixmap); // Promote back to the pixmap tier
+    return pixmap;
+}
+
+bool ThumbnailResidency::contains(int row) const
+{
+    return m_pixmapIndex.contains(row) || m_compressedIndex.contains(row);
+}
+
+void ThumbnailResidency::insert(int row, const QPixmap &pixmap)
+{
+    auto it = m_pixmapIndex.constFind(row);
+    if (it != m_pixmapIndex.constEnd()) {
+        m_pixmapBytes -= it.value()->bytes;
+        m_pixmaps.erase(it.value());
+        m_pixmapIndex.remove(row);
+    }
+    removeCompressed(row);
+
+    const qint64 bytes = bytesFor(pixmap);
+    m_pixmaps.push_front({row, pixmap, bytes});
+    m_pixmapIndex.insert(row, m_pixmaps.begin());
+    m_pixmapBytes += bytes;
+    evictPixmaps();
+}
+
+void ThumbnailResidency::clear()
+{
+    m_pixmaps.clear();
+    m_pixmapIndex.clear();
+    m_pixmapBytes = 0;
+    m_compressed.clear();
+    m_compressedIndex.clear();
+    m_compressedBytes = 0;
+}
+
+void ThumbnailResidency::remove(int row)
+{
+    auto it = m_pixmapIndex.constFind(row);
+    if (it != m_pixmapIndex.constEnd()) {
+        m_pixmapBytes -= it.value()->bytes;
+        m_pixmaps.erase(it.value());
+        m_pixmapIndex.remove(row);
+    }
+    removeCompressed(row);
+}
+
+template <typename RowMap>
+void ThumbnailResidency::remapRowsWith(RowMap newRowFor)
+{
+    m_pixmapIndex.clear();
+    for (auto it = m_pixmaps.begin(); it != m_pixmaps.end();) {
+        it->row = newRowFor(it->row);
+        if (it->row < 0) {
+            m_pixmapBytes -= it->bytes;
+            it = m_pixmaps.erase(it);
+        } else {
+            m_pixmapIndex.insert(it->row, it);
+            ++it;
+        }
+    }
+    m_compressedIndex.clear();
+    for (auto it = m_compressed.begin(); it != m_compressed.end();) {
+        it->row = newRowFor(it->row);
+        if (it->row < 0) {
+            m_compressedBytes -= it->data.size();
+            it = m_compressed.erase(it);
+        } else {
+            m_compressedIndex.insert(it->row, it);
+            ++it;
+        }
+    }
+}
+
+void ThumbnailResidency::remapRows(const QVector<int> &newRowForOldRow)
+{
+    remapRowsWith([&newRowForOldRow](int row) { return row >= 0 && row < newRowForOldRow.size() ? newRowForOldRow.at(row) : -1; });
+}
+
+void ThumbnailResidency::shiftRows(int firstRow, int delta)
+{
+    // Only resident entries are touched, so this stays cheap on huge models
+    remapRowsWith([firstRow, delta](int row) { return row >= firstRow ? row + delta : row; });
+}
+
+void ThumbnailResidency::moveRow(int fromRow, int toRow)
+{
+    remapRowsWith([fromRow, toRow](int row) {
+        if (row == fromRow) return toRow;
+        if (fromRow < toRow && row > fromRow && row <= toRow) return row - 1;
+        if (toRow < fromRow && row >= toRow && row < fromRow) return row + 1;
+        return row;
+    });
+}
+
+void ThumbnailResidency::evictPixmaps()
+{
+    // The entry just inserted is never evicted, even if it alone exceeds the budget
+    while (m_pixmapBytes > m_byteBudget && m_pixmaps.size() > 1) {
+        PixmapEntry &victim = m_pixmaps.back();
+        if (m_compressedByteBudget > 0) {
+            QByteArray data;
+            QBuffer buffer(&data);
+            buffer.open(QIODevice::WriteOnly);
+            const QImage image = victim.pixmap.toImage();
+            if (image.save(&buffer, image.hasAlphaChannel() ? "PNG" : "JPG", 85)) { // Letterboxed cells keep their transparency
+                m_compressed.push_front({victim.row, data});
+                m_compressedIndex.insert(victim.row, m_compressed.begin());
+                m_compressedBytes += data.size();
+            }
+        }
+        m_pixmapBytes -= victim.bytes;
+        m_pixmapIndex.remove(victim.row);
+        m_pixmaps.pop_back();
+    }
+    evictCompressed();
+}
+
+void ThumbnailResidency::evictCompressed()
+{
+    while (m_compressedBytes > m_compressedByteBudget && !m_compressed.empty()) {
+        m_compressedBytes -= m_compressed.back().data.size();
+        m_compressedIndex.remove(m_compressed.back().row);
+        m_compressed.pop_back();
+    }
+}
+
+void ThumbnailResidency::removeCompressed(int row)
+{
+    auto it = m_compressedIndex.constFind(row);
+    if (it == m_compressedIndex.constEnd()) {
+        return;
+    }
+    m_compressedBytes -= it.value()->data.size();
+    m_compressed.erase(it.value());
+    m_compressedIndex.remove(row);
+}
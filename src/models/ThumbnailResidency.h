@@ -0,0 +1,65 @@
+#ifndef THUMBNAILRESIDENCY_H
+#define THUMBNAILRESIDENCY_H
+
+#include <QHash>
+#include <QPixmap>
+#include <QByteArray>
+#include <QVector>
+#include <list>
+
+// Keeps the thumbnails of a ThumbnailListModel under a fixed memory budget.
+// Pixmaps are evicted least-recently-viewed first. With a compressed budget set, evicted
+// thumbnails are JPEG/PNG-encoded into a second, smaller in-RAM tier and decoded
+// again on the next view; otherwise, or once that tier is full too, they are dropped and the
+// next request is served from the on-disk thumbnail cache.
+class ThumbnailResidency
+{
+public:
+    explicit ThumbnailResidency(qint64 byteBudget = 256ll * 1024 * 1024, qint64 compressedByteBudget = 0);
+
+    void setBudget(qint64 byteBudget, qint64 compressedByteBudget);
+
+    QPixmap find(int row);        // Null if not resident; a hit marks the row most recently viewed
+    bool contains(int row) const; // Either tier, no LRU update
+    void insert(int row, const QPixmap &pixmap);
+    void clear();
+    void remove(int row);
+    void remapRows(const QVector<int> &newRowForOldRow); // After the model reorders its rows; -1 drops the entry
+    void shiftRows(int firstRow, int delta);  // After rows were inserted (delta > 0) or removed before firstRow
+    void moveRow(int fromRow, int toRow);     // After a single row moved; rows in between shift by one
+
+    int residentCount() const { return int(m_pixmapIndex.size()); }
+    qint64 residentBytes() const { return m_pixmapBytes; }
+    int compressedCount() const { return int(m_compressedIndex.size()); }
+    qint64 compressedBytes() const { return m_compressedBytes; }
+
+private:
+    struct PixmapEntry {
+        int row;
+        QPixmap pixmap;
+        qint64 bytes;
+    };
+    struct CompressedEntry {
+        int row;
+        QByteArray data;
+    };
+
+    static qint64 bytesFor(const QPixmap &pixmap);
+    template <typename RowMap> void remapRowsWith(RowMap newRowFor);
+    void evictPixmaps();
+    void evictCompressed();
+    void removeCompressed(int row);
+
+    qint64 m_byteBudget;
+    qint64 m_compressedByteBudget;
+
+    std::list<PixmapEntry> m_pixmaps; // Front is most recently viewed
+    QHash<int, std::list<PixmapEntry>::iterator> m_pixmapIndex;
+    qint64 m_pixmapBytes;
+
+    std::list<CompressedEntry> m_compressed;
+    QHash<int, std::list<CompressedEntry>::iterator> m_compressedIndex;
+    qint64 m_compressedBytes;
+};
+
+#endif // THUMBNAILRESIDENCY_H
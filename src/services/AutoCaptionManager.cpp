@@ -7,6 +7,7 @@
 #include <QtConcurrent/QtConcurrent> 
 #include <QNetworkRequest> // Added
 #include <QFileInfo>       // Added
+#include <QSettings>
 
 AutoCaptionManager::AutoCaptionManager(QObject *parent) 
     : QObject(parent), 
@@ -14,16 +15,35 @@ AutoCaptionManager::AutoCaptionManager(QObject *parent)
       m_useAmdGpu(false),
       m_isModelLoaded(false),
       m_enableSuggestionWhileTyping(true), 
-      m_taggerEngine(nullptr),
+      m_vocabularyEngine(nullptr),
+      m_reloadPending(false),
       m_tagGenerationWatcher(nullptr),
+      m_bulkCaptionJob(nullptr),
       m_networkManager(new QNetworkAccessManager(this)), // Initialize network manager
       m_currentReply(nullptr),
       m_downloadedFile(nullptr)
 {
-    m_taggerEngine = new WdVIT_TaggerEngine(); 
-    m_tagGenerationWatcher = new QFutureWatcher<QStringList>(this);
+    m_vocabularyEngine = new WdVIT_TaggerEngine(); 
+    m_tagGenerationWatcher = new QFutureWatcher<TaggingResult>(this);
     m_modelLoadWatcher = new QFutureWatcher<QPair<bool, QString>>(this); 
     m_modelSettings["remove_separator"] = true; 
+    m_modelSettings["inference_sessions"] = 0; // 0 = auto, see ThreadBudget
+    m_modelSettings["intra_op_threads"] = 0; // 0 = auto, see ThreadBudget
+    m_modelSettings["inter_op_threads"] = 0;
+    m_modelSettings["execution_mode"] = "sequential";
+    m_modelSettings["graph_optimization_level"] = "extended";
+    m_modelSettings["thread_affinity"] = "os";
+    m_modelSettings["use_optimized_model_cache"] = true;
+    m_modelSettings["model_variant"] = "fp32"; // "int8" loads model_quantized.onnx when present
+    QSettings appSettings("KetenganDiffusion", "HaigakuManager");
+    for (const QString &key : sessionSettingKeys()) { // Thread counts etc. are machine specific, so they persist
+        if (appSettings.contains("tagger/" + key)) { // Keep the stored type so applyModelSettings() compares like with like
+            QVariant value = appSettings.value("tagger/" + key);
+            if (value.convert(m_modelSettings.value(key).metaType())) {
+                m_modelSettings[key] = value;
+            }
+        }
+    }
     connect(m_modelLoadWatcher, &QFutureWatcher<QPair<bool, QString>>::finished, this, &AutoCaptionManager::handleModelLoadFinished);
     connect(this, &AutoCaptionManager::allDownloadsCompleted, this, &AutoCaptionManager::onAllDownloadsCompleted); // For full model load
     
@@ -34,6 +54,11 @@ AutoCaptionManager::AutoCaptionManager(QObject *parent)
 
 AutoCaptionManager::~AutoCaptionManager()
 {
+    if (m_bulkCaptionJob) { // Stop the pipeline before the engine goes away
+        m_bulkCaptionJob->cancel();
+        delete m_bulkCaptionJob;
+        m_bulkCaptionJob = nullptr;
+    }
     if (m_currentReply) { // Clean up ongoing download if any
         m_currentReply->abort();
         m_currentReply->deleteLater();
@@ -43,23 +68,26 @@ AutoCaptionManager::~AutoCaptionManager()
         m_downloadedFile->remove(); // Remove partially downloaded file
     }
     delete m_downloadedFile;
-    delete m_taggerEngine; 
+    m_tagGenerationWatcher->waitForFinished(); // Its worker may hold a lease
+    m_enginePool.reset(); // Last holder now; a load still running drops its pool when it finishes
+    delete m_vocabularyEngine; 
     qDebug() << "AutoCaptionManager destroyed.";
 }
 
 void AutoCaptionManager::loadModel(const QString &modelName)
 {
-    if (!m_taggerEngine) { // Should not happen normally
-        m_taggerEngine = new WdVIT_TaggerEngine();
+    if (m_modelLoadWatcher->isRunning()) {
+        qDebug() << "Model loading already in progress, loading" << modelName << "once it finishes.";
+        m_queuedModelName = modelName; // Run from handleModelLoadFinished()
+        return;
     }
 
     qDebug() << "Request to load model:" << modelName << "on device" << (m_selectedDevice == Device::GPU ? "GPU" : "CPU") << (m_useAmdGpu && m_selectedDevice == Device::GPU ? "(AMD)" : "");
     
     m_modelNameToLoadAfterDownload = modelName; // Store for when downloads (if any) complete
 
-    QString appDirPath = QCoreApplication::applicationDirPath();
-    QString modelBasePath = QDir(appDirPath).filePath("models/" + modelName); // Use modelName for subfolder
-    QString onnxPath = QDir(modelBasePath).filePath("model.onnx");
+    QString modelBasePath = modelDirectory(modelName); // Use modelName for subfolder
+    QString onnxPath = modelFileForVariant(modelBasePath, "fp32");
     QString csvPath = QDir(modelBasePath).filePath("selected_tags.csv");
     
     QFileInfo onnxFileInfo(onnxPath);
@@ -67,26 +95,26 @@ void AutoCaptionManager::loadModel(const QString &modelName)
 
     if (onnxFileInfo.exists() && csvFileInfo.exists()) {
         qDebug() << "Model files found locally. Proceeding to load.";
-        m_currentModelName = modelName; // Set for status updates during direct load
+        // The loaded model (if any) keeps serving until the new one is swapped in
         emit modelStatusChanged(tr("Model: Loading %1...").arg(modelName), "yellow");
         QCoreApplication::processEvents(); 
 
-        if (m_modelLoadWatcher->isRunning()) {
-            qDebug() << "Model loading already in progress.";
-            return;
-        }
         Device currentDevice = m_selectedDevice;
         bool useAmd = m_useAmdGpu;
+        QString loadPath = modelFileToLoad(modelBasePath);
+        std::shared_ptr<TaggerEnginePool> pool = std::make_shared<TaggerEnginePool>();
+        m_pendingPool = pool;
         
-        QFuture<QPair<bool, QString>> future = QtConcurrent::run([this, onnxPath, csvPath, currentDevice, useAmd]() {
-            if (!m_taggerEngine) return qMakePair(false, QString("Tagger engine not initialized."));
+        QFuture<QPair<bool, QString>> future = QtConcurrent::run([pool, onnxPath, loadPath, csvPath, currentDevice, useAmd, settings = m_modelSettings]() {
             bool useCuda_thread = currentDevice == Device::GPU && !useAmd;
-            bool success_thread = m_taggerEngine->loadModel(onnxPath, csvPath,
-                                                     currentDevice == Device::CPU, useAmd, useCuda_thread);
+            bool success_thread = pool->load(loadPath, csvPath,
+                                                     currentDevice == Device::CPU, useAmd, useCuda_thread, settings);
             QString deviceStr_thread = (currentDevice == Device::GPU ? "GPU" : "CPU");
             if (currentDevice == Device::GPU) {
                 if(useAmd) deviceStr_thread += " (DirectML)"; else deviceStr_thread += " (CUDA/Default)";
             }
+            if (loadPath != onnxPath) deviceStr_thread += ", INT8";
+            if (success_thread && pool->size() > 1) deviceStr_thread += QString(", %1 sessions").arg(pool->size());
             return qMakePair(success_thread, deviceStr_thread);
         });
         m_modelLoadWatcher->setFuture(future);
@@ -226,11 +254,11 @@ void AutoCaptionManager::onDownloadFinished() {
     emit downloadComplete(justDownloadedFileName, success, errorString);
 
     if (success) {
-        if (justDownloadedFileName == "selected_tags.csv" && m_taggerEngine && !m_taggerEngine->isVocabularyLoaded()) {
+        if (justDownloadedFileName == "selected_tags.csv" && m_vocabularyEngine && !m_vocabularyEngine->isVocabularyLoaded()) {
             if (!downloadedFilePath.isEmpty()) {
                 qDebug() << "Attempting to load vocabulary from just downloaded CSV:" << downloadedFilePath;
-                if (m_taggerEngine->loadTagVocabulary(downloadedFilePath)) {
-                    emit vocabularyReady(m_taggerEngine->getKnownTags());
+                if (m_vocabularyEngine->loadTagVocabulary(downloadedFilePath)) {
+                    emit vocabularyReady(m_vocabularyEngine->getKnownTags());
                 } else {
                     emit errorOccurred(tr("Failed to load downloaded vocabulary file: %1").arg(downloadedFilePath));
                 }
@@ -249,29 +277,31 @@ void AutoCaptionManager::onAllDownloadsCompleted() {
     emit modelStatusChanged(tr("Downloads complete. Loading %1...").arg(m_modelNameToLoadAfterDownload), "yellow");
     
     // Now trigger the actual model loading logic (similar to when files existed initially)
-    m_currentModelName = m_modelNameToLoadAfterDownload; // Ensure m_currentModelName is set for handleModelLoadFinished
-
-    QString appDirPath = QCoreApplication::applicationDirPath();
-    QString modelBasePath = QDir(appDirPath).filePath("models/" + m_currentModelName);
-    QString onnxPath = QDir(modelBasePath).filePath("model.onnx");
+    QString modelBasePath = modelDirectory(m_modelNameToLoadAfterDownload);
+    QString onnxPath = modelFileForVariant(modelBasePath, "fp32");
     QString csvPath = QDir(modelBasePath).filePath("selected_tags.csv");
 
     if (m_modelLoadWatcher->isRunning()) {
         qDebug() << "Model loading already in progress (after download)."; // Should ideally not happen
+        m_queuedModelName = m_modelNameToLoadAfterDownload;
         return;
     }
     Device currentDevice = m_selectedDevice;
     bool useAmd = m_useAmdGpu;
+    QString loadPath = modelFileToLoad(modelBasePath);
+    std::shared_ptr<TaggerEnginePool> pool = std::make_shared<TaggerEnginePool>();
+    m_pendingPool = pool;
     
-    QFuture<QPair<bool, QString>> future = QtConcurrent::run([this, onnxPath, csvPath, currentDevice, useAmd]() {
-        if (!m_taggerEngine) return qMakePair(false, QString("Tagger engine not initialized."));
+    QFuture<QPair<bool, QString>> future = QtConcurrent::run([pool, onnxPath, loadPath, csvPath, currentDevice, useAmd, settings = m_modelSettings]() {
         bool useCuda_thread = currentDevice == Device::GPU && !useAmd;
-        bool success_thread = m_taggerEngine->loadModel(onnxPath, csvPath,
-                                                 currentDevice == Device::CPU, useAmd, useCuda_thread);
+        bool success_thread = pool->load(loadPath, csvPath,
+                                                 currentDevice == Device::CPU, useAmd, useCuda_thread, settings);
         QString deviceStr_thread = (currentDevice == Device::GPU ? "GPU" : "CPU");
         if (currentDevice == Device::GPU) {
             if(useAmd) deviceStr_thread += " (DirectML)"; else deviceStr_thread += " (CUDA/Default)";
         }
+        if (loadPath != onnxPath) deviceStr_thread += ", INT8";
+        if (success_thread && pool->size() > 1) deviceStr_thread += QString(", %1 sessions").arg(pool->size());
         return qMakePair(success_thread, deviceStr_thread);
     });
     m_modelLoadWatcher->setFuture(future);
@@ -285,22 +315,62 @@ void AutoCaptionManager::handleModelLoadFinished()
     QPair<bool, QString> result = m_modelLoadWatcher->result();
     bool success = result.first;
     QString deviceStr = result.second;
+    std::shared_ptr<TaggerEnginePool> loadedPool = std::move(m_pendingPool);
+    m_pendingPool.reset();
 
-    if (success) {
+    if (success && loadedPool) {
+        {
+            QMutexLocker locker(&m_poolMutex);
+            m_enginePool.swap(loadedPool); // New requests and the next bulk image use the new sessions
+        }
+        loadedPool.reset(); // The old pool goes with its last in-flight request
         m_isModelLoaded = true;
+        m_currentModelName = m_modelNameToLoadAfterDownload;
+        m_loadedDeviceDescription = deviceStr;
         emit modelStatusChanged(tr("Model: %1 Loaded (%2)").arg(m_currentModelName).arg(deviceStr), "green");
+    } else if (success) {
+        qDebug() << "Model load finished after unloadModel(), discarding it.";
+    } else if (m_isModelLoaded) { // The previous model is still serving
+        emit modelStatusChanged(tr("Model: %1 Loaded (%2)").arg(m_currentModelName).arg(m_loadedDeviceDescription), "green");
+        emit errorOccurred(tr("Failed to load %1, still using %2. Check paths, model integrity, or console output.")
+                               .arg(m_modelNameToLoadAfterDownload, m_currentModelName));
     } else {
-        m_isModelLoaded = false;
-        emit modelStatusChanged(tr("Error loading %1").arg(m_currentModelName), "red");
+        emit modelStatusChanged(tr("Error loading %1").arg(m_modelNameToLoadAfterDownload), "red");
         emit errorOccurred(tr("Failed to load model files. Check paths, model integrity, or console output."));
     }
+
+    if (!m_queuedModelName.isEmpty()) { // Requested while this load was running; picks up new settings too
+        const QString modelName = m_queuedModelName;
+        m_queuedModelName.clear();
+        m_reloadPending = false;
+        loadModel(modelName);
+    } else if (m_reloadPending) { // Settings changed while this load was running
+        m_reloadPending = false;
+        reloadInBackground();
+    }
 }
 
 void AutoCaptionManager::unloadModel()
 {
     qDebug() << "Unloading model:" << m_currentModelName;
-    if (m_taggerEngine) {
-        m_taggerEngine->unloadModel();
+    if (m_bulkCaptionJob) {
+        qDebug() << "Cancelling bulk caption job before unloading.";
+        m_bulkCaptionJob->cancel();
+        m_bulkCaptionJob->wait();
+    }
+    if (m_tagGenerationWatcher->isRunning()) {
+        m_tagGenerationWatcher->waitForFinished(); // shutdown() would wait for its lease anyway
+    }
+    m_pendingPool.reset(); // A load still running is discarded when it finishes
+    m_reloadPending = false;
+    m_queuedModelName.clear();
+    std::shared_ptr<TaggerEnginePool> pool;
+    {
+        QMutexLocker locker(&m_poolMutex);
+        pool.swap(m_enginePool);
+    }
+    if (pool) {
+        pool->shutdown(); // Frees the sessions now, even while the finished job still references the pool
     }
     m_isModelLoaded = false;
     m_currentModelName.clear();
@@ -311,30 +381,93 @@ void AutoCaptionManager::unloadModel()
 void AutoCaptionManager::setSelectedDevice(const QString &device)
 {
     qDebug() << "Device selected:" << device;
+    const Device previousDevice = m_selectedDevice;
+    const bool previousUseAmd = m_useAmdGpu;
     if (device.toLower() == "gpu") {
         m_selectedDevice = Device::GPU;
     } else {
         m_selectedDevice = Device::CPU;
         m_useAmdGpu = false; 
     }
-    if (m_isModelLoaded) {
-         emit modelStatusChanged(tr("Device changed. Reload model to apply."), "orange");
+    if (m_selectedDevice != previousDevice || m_useAmdGpu != previousUseAmd) {
+        reloadInBackground();
     }
 }
 
 void AutoCaptionManager::setUseAmdGpu(bool useAmd)
 {
     qDebug() << "Use AMD GPU (DirectML) set to:" << useAmd;
+    const bool changed = m_useAmdGpu != useAmd;
     m_useAmdGpu = useAmd;
-    if (m_selectedDevice == Device::GPU && m_isModelLoaded) {
-        emit modelStatusChanged(tr("Device setting changed. Reload model to apply."), "orange");
+    if (changed && m_selectedDevice == Device::GPU) {
+        reloadInBackground();
     }
 }
 
 void AutoCaptionManager::applyModelSettings(const QString &modelName, const QVariantMap &settings)
 {
     qDebug() << "Applying settings for model" << modelName << ":" << settings;
+    bool sessionSettingsChanged = false;
+    QSettings appSettings("KetenganDiffusion", "HaigakuManager");
+    for (const QString &key : sessionSettingKeys()) {
+        if (m_modelSettings.value(key) != settings.value(key)) {
+            sessionSettingsChanged = true;
+        }
+        if (settings.contains(key)) {
+            appSettings.setValue("tagger/" + key, settings.value(key));
+        }
+    }
     m_modelSettings = settings;
+    if (sessionSettingsChanged) {
+        reloadInBackground();
+    }
+}
+
+void AutoCaptionManager::reloadInBackground()
+{
+    if (!m_isModelLoaded || m_currentModelName.isEmpty()) {
+        return; // Applied by the next load
+    }
+    if (m_modelLoadWatcher->isRunning()) {
+        m_reloadPending = true; // Rebuilt with the latest settings once the running load finishes
+        return;
+    }
+    qDebug() << "Rebuilding" << m_currentModelName << "in the background with the new settings.";
+    loadModel(m_currentModelName);
+}
+
+std::shared_ptr<TaggerEnginePool> AutoCaptionManager::currentPool() const
+{
+    QMutexLocker locker(&m_poolMutex);
+    return m_enginePool;
+}
+
+QStringList AutoCaptionManager::sessionSettingKeys()
+{
+    return {"inference_sessions", "intra_op_threads", "inter_op_threads", "execution_mode", "graph_optimization_level", "thread_affinity",
+            "use_optimized_model_cache", "model_variant"};
+}
+
+QString AutoCaptionManager::modelDirectory(const QString &modelName)
+{
+    return QDir(QCoreApplication::applicationDirPath()).filePath("models/" + modelName);
+}
+
+QString AutoCaptionManager::modelFileForVariant(const QString &modelDirectory, const QString &variant)
+{
+    // The quantized variant is produced locally (onnxruntime.quantization) and dropped next to model.onnx
+    return QDir(modelDirectory).filePath(variant == "int8" ? "model_quantized.onnx" : "model.onnx");
+}
+
+QString AutoCaptionManager::modelFileToLoad(const QString &modelDirectory) const
+{
+    const QString variant = m_modelSettings.value("model_variant", "fp32").toString();
+    const QString variantPath = modelFileForVariant(modelDirectory, variant);
+    if (variant != "fp32" && !QFileInfo::exists(variantPath)) {
+        qWarning() << "Model variant" << variant << "not found at" << variantPath << ", loading the fp32 model instead.";
+        return modelFileForVariant(modelDirectory, "fp32");
+    }
+    return variantPath;
 }
 
 void AutoCaptionManager::generateCaptionForImage(const QString &imagePath)
@@ -349,7 +482,8 @@ void AutoCaptionManager::generateCaptionForImage(const QString &imagePath)
         emit errorOccurred(tr("No image selected or path is invalid."));
         return;
     }
-    if (!m_taggerEngine) {
+    std::shared_ptr<TaggerEnginePool> pool = currentPool();
+    if (!pool) {
          qDebug() << "Tagger engine not initialized.";
          emit errorOccurred(tr("Tagger engine not available."));
         return;
@@ -363,40 +497,55 @@ void AutoCaptionManager::generateCaptionForImage(const QString &imagePath)
         return;
     }
 
-    QFuture<QStringList> future = QtConcurrent::run([this, imagePath, settings = m_modelSettings]() {
-        QImage image(imagePath); 
+    // The worker keeps this pool alive, so a model swapped in meanwhile doesn't pull it away
+    QFuture<TaggingResult> future = QtConcurrent::run([pool, imagePath, settings = m_modelSettings]() {
+        const std::shared_ptr<TagScoreCache> scoreCache = pool->scoreCache();
+        // Cached scores make a threshold tweak + regenerate instant, without waiting for a session
+        const bool useCache = pool->cachedScoresCover(settings);
+        TagScoreCache::Scores scores;
+        if (useCache && scoreCache->lookup(imagePath, &scores)) {
+            return pool->tagsFromScores(scores, settings);
+        }
+        QFile imageFile(imagePath);
+        const QByteArray imageData = imageFile.open(QIODevice::ReadOnly) ? imageFile.readAll() : QByteArray();
+        const quint64 contentKey = TagScoreCache::contentKey(imageData);
+        if (useCache && scoreCache->lookupContent(imagePath, contentKey, &scores)) {
+            return pool->tagsFromScores(scores, settings);
+        }
+        QImage image = QImage::fromData(imageData);
         if (image.isNull()) {
             qWarning() << "Worker Thread: Failed to load image for captioning:" << imagePath;
-            return QStringList(); 
+            return TaggingResult(); 
         }
-        if (!m_taggerEngine || !m_taggerEngine->isModelLoaded()) {
+        // Leased for inference only; waits for a free session while a bulk job keeps the others busy
+        TaggerEnginePool::Lease engine = pool->acquire();
+        if (!engine) {
              qWarning() << "Worker Thread: Tagger engine not ready.";
-             return QStringList();
+             return TaggingResult();
         }
-        return m_taggerEngine->generateTags(image, settings);
+        TaggingResult result = engine->generateTags(image, settings, &scores);
+        engine.release();
+        if (!result.isEmpty() || !scores.empty()) {
+            scoreCache->store(imagePath, contentKey, scores);
+        }
+        return result;
     });
 
-    disconnect(m_tagGenerationWatcher, &QFutureWatcher<QStringList>::finished, nullptr, nullptr);
+    disconnect(m_tagGenerationWatcher, &QFutureWatcher<TaggingResult>::finished, nullptr, nullptr);
 
-    connect(m_tagGenerationWatcher, &QFutureWatcher<QStringList>::finished, 
+    connect(m_tagGenerationWatcher, &QFutureWatcher<TaggingResult>::finished, 
             this, [this, imagePath]() {
-        QStringList tags = m_tagGenerationWatcher->result();
-        handleTagsGenerated(tags, imagePath); 
+        handleTagsGenerated(m_tagGenerationWatcher->result(), imagePath); 
     });
     
     m_tagGenerationWatcher->setFuture(future);
     emit modelStatusChanged(tr("Model: Generating tags..."), "blue"); 
 }
 
-void AutoCaptionManager::handleTagsGenerated(const QStringList &tags, const QString &forImagePath)
+void AutoCaptionManager::handleTagsGenerated(const TaggingResult &result, const QString &forImagePath)
 {
-    QStringList processedTags = tags;
-    bool removeSeparatorFromSettings = m_modelSettings.value("remove_separator", true).toBool(); 
-    if (removeSeparatorFromSettings) {
-        for (QString &tag : processedTags) {
-            tag.replace('_', ' ');
-        }
-    }
+    // Text is produced here, at the UI boundary; the dictionary already holds both spellings
+    const QStringList processedTags = result.toStringList(m_modelSettings.value("remove_separator", true).toBool());
 
     if (processedTags.isEmpty() && !forImagePath.isEmpty()) { 
         qDebug() << "Tag generation resulted in empty list for" << forImagePath;
@@ -415,6 +564,93 @@ void AutoCaptionManager::handleTagsGenerated(const QStringList &tags, const QStr
     }
 }
 
+void AutoCaptionManager::startBulkCaption(const QStringList &imagePaths, bool overwriteExisting, bool cachedScoresOnly)
+{
+    if (!m_isModelLoaded || !currentPool()) {
+        emit errorOccurred(tr("No model loaded. Please load a model first."));
+        return;
+    }
+    if (m_bulkCaptionJob) {
+        emit errorOccurred(tr("A bulk captioning job is already running."));
+        return;
+    }
+    if (imagePaths.isEmpty()) {
+        emit errorOccurred(tr("No images to caption."));
+        return;
+    }
+
+    if (cachedScoresOnly && !currentPool()->cachedScoresCover(m_modelSettings)) {
+        emit errorOccurred(tr("Thresholds below %1 cannot be re-applied from cached scores, which only keep tags "
+                              "scoring at least that much. Raise the thresholds or caption with the model instead.")
+                               .arg(TagScoreCache::MinStoredScore));
+        return;
+    }
+
+    QVariantMap jobSettings = m_modelSettings;
+    jobSettings["bulk_overwrite_existing"] = overwriteExisting || cachedScoresOnly;
+    jobSettings["bulk_cached_only"] = cachedScoresOnly;
+
+    // Fetched per image, so the job carries on across a model or device switch
+    m_bulkCaptionJob = new BulkCaptionJob([this]() { return currentPool(); }, imagePaths, jobSettings);
+    connect(m_bulkCaptionJob, &BulkCaptionJob::progress, this, &AutoCaptionManager::bulkCaptionProgress);
+    connect(m_bulkCaptionJob, &BulkCaptionJob::captionWritten, this, &AutoCaptionManager::bulkCaptionWritten);
+    connect(m_bulkCaptionJob, &BulkCaptionJob::imageFailed, this, [](const QString &imagePath, const QString &reason) {
+        qWarning() << "Bulk caption failed for" << imagePath << ":" << reason;
+    });
+    connect(m_bulkCaptionJob, &BulkCaptionJob::finished, this, &AutoCaptionManager::handleBulkCaptionFinished);
+
+    emit modelStatusChanged(tr("Model: Captioning %1 images...").arg(imagePaths.size()), "blue");
+    emit bulkCaptionProgress(0, imagePaths.size());
+    m_bulkCaptionJob->start();
+}
+
+void AutoCaptionManager::pauseBulkCaption()
+{
+    if (m_bulkCaptionJob) {
+        m_bulkCaptionJob->pause();
+        emit modelStatusChanged(tr("Model: Bulk captioning paused"), "orange");
+    }
+}
+
+void AutoCaptionManager::resumeBulkCaption()
+{
+    if (m_bulkCaptionJob) {
+        m_bulkCaptionJob->resume();
+        emit modelStatusChanged(tr("Model: Captioning %1 images...").arg(m_bulkCaptionJob->totalCount()), "blue");
+    }
+}
+
+void AutoCaptionManager::cancelBulkCaption()
+{
+    if (m_bulkCaptionJob) {
+        m_bulkCaptionJob->cancel(); // finished() follows once the last inference thread exits
+    }
+}
+
+bool AutoCaptionManager::isBulkCaptionRunning() const
+{
+    return m_bulkCaptionJob != nullptr;
+}
+
+bool AutoCaptionManager::isBulkCaptionPaused() const
+{
+    return m_bulkCaptionJob && m_bulkCaptionJob->isPaused();
+}
+
+void AutoCaptionManager::handleBulkCaptionFinished(int written, int skipped, int failed, bool cancelled)
+{
+    if (m_bulkCaptionJob) {
+        m_bulkCaptionJob->deleteLater(); // Destructor joins the remaining pipeline threads
+        m_bulkCaptionJob = nullptr;
+    }
+    if (m_isModelLoaded) {
+        emit modelStatusChanged(tr("Model: %1 Loaded (%2)").arg(m_currentModelName).arg(m_loadedDeviceDescription), "green");
+    } else {
+        emit modelStatusChanged(tr("Model: Unloaded"), "red");
+    }
+    emit bulkCaptionFinished(written, skipped, failed, cancelled);
+}
+
 void AutoCaptionManager::setEnableSuggestionWhileTyping(bool enabled)
 {
     qDebug() << "Enable suggestion while typing set to:" << enabled;
@@ -428,8 +664,8 @@ QVariantMap AutoCaptionManager::getModelSettings() const
 
 QStringList AutoCaptionManager::getVocabularyForCompletions() const
 {
-    if (m_taggerEngine && m_taggerEngine->isVocabularyLoaded()) { // Check if vocab is loaded
-        QStringList tags = m_taggerEngine->getKnownTags();
+    if (m_vocabularyEngine && m_vocabularyEngine->isVocabularyLoaded()) { // Check if vocab is loaded
+        QStringList tags = m_vocabularyEngine->getKnownTags();
         qDebug() << "AutoCaptionManager::getVocabularyForCompletions returning" << tags.size() << "tags. First few:" << tags.mid(0, 5);
         return tags;
     }
@@ -438,24 +674,23 @@ QStringList AutoCaptionManager::getVocabularyForCompletions() const
 }
 
 void AutoCaptionManager::ensureVocabularyLoaded(const QString &modelName) {
-    if (!m_taggerEngine) {
-        m_taggerEngine = new WdVIT_TaggerEngine();
+    if (!m_vocabularyEngine) {
+        m_vocabularyEngine = new WdVIT_TaggerEngine();
     }
-    if (m_taggerEngine->isVocabularyLoaded()) {
+    if (m_vocabularyEngine->isVocabularyLoaded()) {
         qDebug() << "Vocabulary already loaded for TagEditor.";
-        emit vocabularyReady(m_taggerEngine->getKnownTags());
+        emit vocabularyReady(m_vocabularyEngine->getKnownTags());
         return;
     }
 
-    QString appDirPath = QCoreApplication::applicationDirPath();
-    QString modelBasePath = QDir(appDirPath).filePath("models/" + modelName);
+    QString modelBasePath = modelDirectory(modelName);
     QString csvPath = QDir(modelBasePath).filePath("selected_tags.csv");
     QFileInfo csvFileInfo(csvPath);
 
     if (csvFileInfo.exists()) {
         qDebug() << "selected_tags.csv found locally for" << modelName;
-        if (m_taggerEngine->loadTagVocabulary(csvPath)) {
-            emit vocabularyReady(m_taggerEngine->getKnownTags());
+        if (m_vocabularyEngine->loadTagVocabulary(csvPath)) {
+            emit vocabularyReady(m_vocabularyEngine->getKnownTags());
         } else {
             emit errorOccurred(tr("Failed to load existing vocabulary file: %1").arg(csvPath));
         }
@@ -6,12 +6,17 @@
 #include <QStringList>
 #include <QVariantMap>
 #include "WdVIT_TaggerEngine.h" 
+#include "BulkCaptionJob.h"
+#include "TaggerEnginePool.h"
+#include "TagScoreCache.h"
 #include <QtConcurrent>   
 #include <QFutureWatcher> 
 #include <QNetworkAccessManager> // Added
 #include <QNetworkReply>         // Added
 #include <QFile>                 // Added
 #include <QUrl>                  // Added
+#include <QMutex>
+#include <memory>
 
 class AutoCaptionManager : public QObject
 {
@@ -26,6 +31,11 @@ public:
     QVariantMap getModelSettings() const; 
     QStringList getVocabularyForCompletions() const; 
     void ensureVocabularyLoaded(const QString &modelName = "SmilingWolf/wd-vit-tagger-v3"); // New
+    bool isBulkCaptionRunning() const;
+    bool isBulkCaptionPaused() const;
+    static QStringList sessionSettingKeys(); // m_modelSettings keys that need new sessions; changing one rebuilds the model in the background
+    static QString modelDirectory(const QString &modelName); // <app dir>/models/<modelName>
+    static QString modelFileForVariant(const QString &modelDirectory, const QString &variant); // "fp32" or "int8"
 
 public slots:
     // Slots to be called from UI (Task Pane, Settings Dialog)
@@ -40,6 +50,13 @@ public slots:
     // Slot to be called from MainWindow (bulb button)
     void generateCaptionForImage(const QString &imagePath);
 
+    // Bulk captioning of a folder/selection; writes a .txt next to every image as it completes.
+    // cachedScoresOnly rewrites captions from the TagScoreCache with the current thresholds and skips the rest.
+    void startBulkCaption(const QStringList &imagePaths, bool overwriteExisting, bool cachedScoresOnly = false);
+    void pauseBulkCaption();
+    void resumeBulkCaption();
+    void cancelBulkCaption();
+
 
 signals:
     void modelStatusChanged(const QString &statusMessage, const QString &color);
@@ -50,11 +67,16 @@ signals:
     void downloadProgress(const QString &fileName, qint64 bytesReceived, qint64 bytesTotal);
     void downloadComplete(const QString &fileName, bool success, const QString &errorString); 
     void allDownloadsCompleted();
+    // Bulk captioning signals
+    void bulkCaptionProgress(int processed, int total);
+    void bulkCaptionWritten(const QString &imagePath);
+    void bulkCaptionFinished(int written, int skipped, int failed, bool cancelled);
 
 
 private slots: 
-    void handleTagsGenerated(const QStringList &tags, const QString &forImagePath);
+    void handleTagsGenerated(const TaggingResult &result, const QString &forImagePath);
     void handleModelLoadFinished(); 
+    void handleBulkCaptionFinished(int written, int skipped, int failed, bool cancelled);
     // Download slots
     void processNextDownload();
     void onDownloadProgress(qint64 bytesReceived, qint64 bytesTotal);
@@ -63,9 +85,21 @@ private slots:
 
 
 private:
-    WdVIT_TaggerEngine *m_taggerEngine; 
-    QFutureWatcher<QStringList> *m_tagGenerationWatcher; 
+    QString modelFileToLoad(const QString &modelDirectory) const; // Selected variant, falling back to fp32
+    void reloadInBackground(); // Rebuilds the loaded model with the current device/session settings
+    std::shared_ptr<TaggerEnginePool> currentPool() const; // Null while unloaded; callable from any thread
+
+    WdVIT_TaggerEngine *m_vocabularyEngine; // Tag vocabulary for completions only, never loads a model
+    // Sessions of the loaded model; all inference goes through leases. Replaced whole by a reload,
+    // and every holder of the old pool (a caption request, a queued bulk image) finishes on it.
+    mutable QMutex m_poolMutex;
+    std::shared_ptr<TaggerEnginePool> m_enginePool;
+    std::shared_ptr<TaggerEnginePool> m_pendingPool; // Being built by m_modelLoadWatcher
+    bool m_reloadPending; // Settings changed during a load
+    QString m_queuedModelName; // loadModel() called during a load; wins over m_reloadPending
+    QFutureWatcher<TaggingResult> *m_tagGenerationWatcher; 
     QFutureWatcher<QPair<bool, QString>> *m_modelLoadWatcher; 
+    BulkCaptionJob *m_bulkCaptionJob; // Non-null while a bulk job is running
 
     // Download members
     QNetworkAccessManager *m_networkManager;
@@ -82,6 +116,7 @@ private:
     // bool m_removeSeparator; // Setting now comes via m_modelSettings
     QVariantMap m_modelSettings; 
     bool m_isModelLoaded;
+    QString m_loadedDeviceDescription; // e.g. "CPU, INT8", shown in the status line
 
     // Placeholder for model files path
     // QString m_modelBasePath; 
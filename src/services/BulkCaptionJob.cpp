@@ -0,0 +1,341 @@
+#include "BulkCaptionJob.h"
+#include "WdVIT_TaggerEngine.h"
+#include "TaggerEnginePool.h"
+#include "utils/ThreadBudget.h"
+#include <QImageReader>
+#include <QBuffer>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QMutexLocker>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+int sessionCountOf(const std::shared_ptr<TaggerEnginePool> &pool)
+{
+    return pool ? qMax(1, pool->size()) : 1;
+}
+} // namespace
+
+BulkCaptionJob::BulkCaptionJob(const PoolProvider &poolProvider, const QStringList &imagePaths, const QVariantMap &settings,
+                               QObject *parent)
+    : QObject(parent)
+    , m_poolProvider(poolProvider)
+    , m_imagePaths(imagePaths)
+    , m_settings(settings)
+    , m_batchSize(qMax(1, settings.value("batch_size", 8).toInt()))
+    , m_decoderCount(ThreadBudget::bulkDecodeThreads())
+    , m_inferenceCount(sessionCountOf(poolProvider()))
+    , m_overwriteExisting(settings.value("bulk_overwrite_existing", false).toBool())
+    , m_removeSeparator(settings.value("remove_separator", true).toBool())
+    , m_cachedOnly(settings.value("bulk_cached_only", false).toBool())
+    , m_queue(m_batchSize * (m_inferenceCount + 2)) // Enough to build the next batch while every session runs one
+    , m_nextIndex(0)
+    , m_cancelled(false)
+    , m_activeDecoders(0)
+    , m_activeInference(0)
+    , m_processed(0)
+    , m_written(0)
+    , m_skipped(0)
+    , m_failed(0)
+    , m_paused(false)
+{
+    m_threadPool.setMaxThreadCount(m_decoderCount + m_inferenceCount); // Decoders + one inference thread per session
+}
+
+BulkCaptionJob::~BulkCaptionJob()
+{
+    cancel();
+    wait();
+}
+
+void BulkCaptionJob::start()
+{
+    qDebug() << "BulkCaptionJob: Starting for" << m_imagePaths.size() << "images with" << m_decoderCount
+             << "decode threads," << m_inferenceCount << "inference threads, batch size" << m_batchSize;
+    m_activeDecoders = m_decoderCount;
+    m_activeInference = m_inferenceCount;
+    for (int i = 0; i < m_decoderCount; ++i) {
+        m_threadPool.start([this]() { runDecoder(); });
+    }
+    for (int i = 0; i < m_inferenceCount; ++i) {
+        m_threadPool.start([this]() { runInference(); });
+    }
+}
+
+void BulkCaptionJob::pause()
+{
+    QMutexLocker locker(&m_pauseMutex);
+    m_paused = true;
+}
+
+void BulkCaptionJob::resume()
+{
+    QMutexLocker locker(&m_pauseMutex);
+    m_paused = false;
+    m_resumeCondition.wakeAll();
+}
+
+void BulkCaptionJob::cancel()
+{
+    m_cancelled = true;
+    resume();        // Release threads parked on the pause gate
+    m_queue.close(); // Release threads blocked on a full/empty queue
+}
+
+void BulkCaptionJob::wait()
+{
+    m_threadPool.waitForDone();
+}
+
+bool BulkCaptionJob::isPaused() const
+{
+    QMutexLocker locker(&m_pauseMutex);
+    return m_paused;
+}
+
+bool BulkCaptionJob::waitWhilePaused()
+{
+    QMutexLocker locker(&m_pauseMutex);
+    while (m_paused && !m_cancelled) {
+        m_resumeCondition.wait(&m_pauseMutex);
+    }
+    return !m_cancelled;
+}
+
+QString BulkCaptionJob::captionPathForImage(const QString &imagePath)
+{
+    QFileInfo mediaInfo(imagePath);
+    return mediaInfo.absolutePath() + "/" + mediaInfo.completeBaseName() + ".txt";
+}
+
+void BulkCaptionJob::runDecoder()
+{
+    while (waitWhilePaused()) {
+        const int index = m_nextIndex.fetch_add(1);
+        if (index >= m_imagePaths.size()) {
+            break;
+        }
+        const QString &imagePath = m_imagePaths.at(index);
+
+        BulkCaptionItem item;
+        item.index = index;
+        item.pool = m_poolProvider(); // Per image, so a model swapped in mid-job takes over from here
+        const std::shared_ptr<TagScoreCache> scoreCache = item.pool ? item.pool->scoreCache() : nullptr;
+        const bool useCache = item.pool && item.pool->cachedScoresCover(m_settings); // Low thresholds need every score
+        if (!m_overwriteExisting) {
+            QFileInfo mediaInfo(imagePath);
+            QString baseName = mediaInfo.absolutePath() + "/" + mediaInfo.completeBaseName();
+            if (QFile::exists(baseName + ".txt") || QFile::exists(baseName + ".caption")) {
+                item.skipped = true;
+            }
+        }
+
+        if (!item.skipped && !item.pool) {
+            item.error = tr("No model loaded");
+        } else if (!item.skipped && useCache && scoreCache->lookup(imagePath, &item.cachedScores)) {
+            item.cached = true;
+        } else if (!item.skipped && m_cachedOnly) {
+            item.skipped = true; // Never tagged with this model; hashing the content would cost a full read
+        } else if (!item.skipped) {
+            // Read once: the bytes are hashed for the cache and then decoded from memory
+            QFile imageFile(imagePath);
+            QByteArray imageData = imageFile.open(QIODevice::ReadOnly) ? imageFile.readAll() : QByteArray();
+            item.contentKey = TagScoreCache::contentKey(imageData);
+            if (imageData.isEmpty()) {
+                item.error = imageFile.errorString();
+            } else if (useCache && scoreCache->lookupContent(imagePath, item.contentKey, &item.cachedScores)) {
+                item.cached = true; // Renamed or copied since it was tagged
+            } else {
+                QBuffer buffer(&imageData);
+                QImageReader reader(&buffer);
+                reader.setAutoTransform(true);
+                QImage image = reader.read();
+                if (image.isNull()) {
+                    item.error = reader.errorString();
+                } else {
+                    const QSize inputSize = item.pool->modelInputSize();
+                    item.tensorValues = acquireTensorBuffer();
+                    item.tensorValues.resize(static_cast<size_t>(inputSize.height()) * inputSize.width() * 3); // No-op for a recycled buffer
+                    if (!WdVIT_TaggerEngine::preprocessImage(image, inputSize.height(), inputSize.width(), item.tensorValues.data())) {
+                        recycleTensorBuffer(item.tensorValues);
+                        item.error = tr("Preprocessing failed");
+                    }
+                }
+            }
+        }
+
+        if (!m_queue.push(std::move(item))) {
+            break; // Queue closed by cancel()
+        }
+    }
+    if (m_activeDecoders.fetch_sub(1) == 1) {
+        m_queue.close(); // Every image is queued; the inference threads drain what is left and exit
+    }
+}
+
+void BulkCaptionJob::runInference()
+{
+    const int total = m_imagePaths.size();
+    InferenceScratch scratch;
+
+    while (waitWhilePaused()) {
+        QVector<BulkCaptionItem> batch = m_queue.popBatch(m_batchSize);
+        if (batch.isEmpty()) {
+            break; // Closed and drained
+        }
+
+        // Only a batch straddling a model swap has more than one run of items sharing a pool
+        bool modelAvailable = true;
+        for (int first = 0; first < batch.size() && modelAvailable;) {
+            int last = first + 1;
+            while (last < batch.size() && batch.at(last).pool == batch.at(first).pool) {
+                ++last;
+            }
+            modelAvailable = processItems(batch, first, last, scratch);
+            first = last;
+        }
+        if (!modelAvailable) {
+            qWarning() << "BulkCaptionJob: Model unloaded, stopping.";
+            m_cancelled = true;
+            m_queue.close();
+            break;
+        }
+
+        const int processed = m_processed.fetch_add(batch.size()) + batch.size();
+        emit progress(processed, total);
+    }
+
+    if (m_activeInference.fetch_sub(1) != 1) {
+        return; // The last inference thread out reports for the whole job
+    }
+    const bool cancelled = m_cancelled || m_processed < total;
+    m_queue.close(); // Unblock any decoder still waiting to push
+    const int written = m_written;
+    const int skipped = m_skipped;
+    const int failed = m_failed;
+    qDebug() << "BulkCaptionJob: Finished. Written:" << written << "Skipped:" << skipped << "Failed:" << failed << "Cancelled:" << cancelled;
+    emit finished(written, skipped, failed, cancelled);
+}
+
+bool BulkCaptionJob::processItems(QVector<BulkCaptionItem> &batch, int first, int last, InferenceScratch &scratch)
+{
+    const std::shared_ptr<TaggerEnginePool> pool = batch.at(first).pool; // Outlives the lease below
+    bool needsModel = false;
+    for (int i = first; i < last; ++i) {
+        const BulkCaptionItem &item = batch.at(i);
+        if (item.skipped) {
+            ++m_skipped;
+        } else if (!item.error.isEmpty()) {
+            ++m_failed;
+            emit imageFailed(m_imagePaths.at(item.index), item.error);
+        } else {
+            needsModel = true;
+        }
+    }
+    if (!needsModel) {
+        return true;
+    }
+    if (!pool->isLoaded()) {
+        return false;
+    }
+
+    const QSize inputSize = pool->modelInputSize();
+    const size_t imageElementCount = static_cast<size_t>(inputSize.height()) * inputSize.width() * 3;
+    const std::shared_ptr<TagScoreCache> scoreCache = pool->scoreCache();
+
+    QVector<QPair<QString, TaggingResult>> captions; // Written once inference is done
+    scratch.packedIndices.clear();
+    scratch.packedContentKeys.clear();
+    scratch.packedValues.resize(imageElementCount * (last - first));
+    for (int i = first; i < last; ++i) {
+        BulkCaptionItem &item = batch[i];
+        if (item.skipped || !item.error.isEmpty()) {
+            continue; // Counted above
+        } else if (item.cached) {
+            captions.append({m_imagePaths.at(item.index), pool->tagsFromScores(item.cachedScores, m_settings)}); // No session needed
+        } else if (item.tensorValues.size() != imageElementCount) {
+            ++m_failed;
+            emit imageFailed(m_imagePaths.at(item.index), tr("Preprocessing failed"));
+        } else {
+            std::copy(item.tensorValues.begin(), item.tensorValues.end(),
+                      scratch.packedValues.begin() + imageElementCount * scratch.packedIndices.size());
+            recycleTensorBuffer(item.tensorValues); // Back to the decoders before inference starts
+            scratch.packedIndices.append(item.index);
+            scratch.packedContentKeys.append(item.contentKey);
+        }
+    }
+
+    scratch.results.clear();
+    const bool storeScores = scoreCache->isOpen();
+    if (!scratch.packedIndices.isEmpty()) {
+        // Waits for a free session; with every session busy this thread stops taking batches
+        TaggerEnginePool::Lease lease = pool->acquire();
+        if (!lease) {
+            return false;
+        }
+        scratch.results = lease->generateTagsPreprocessed(scratch.packedValues.data(), static_cast<int>(scratch.packedIndices.size()),
+                                                          m_settings, storeScores ? &scratch.rawScores : nullptr);
+    } // Cache and file writes don't need the session
+
+    for (int i = 0; i < scratch.packedIndices.size(); ++i) {
+        const QString &imagePath = m_imagePaths.at(scratch.packedIndices.at(i));
+        if (i >= scratch.results.size()) {
+            ++m_failed;
+            emit imageFailed(imagePath, tr("Inference failed"));
+            continue;
+        }
+        if (storeScores && i < scratch.rawScores.size()) {
+            scoreCache->store(imagePath, scratch.packedContentKeys.at(i), scratch.rawScores.at(i));
+        }
+        captions.append({imagePath, scratch.results.at(i)});
+    }
+    for (const auto &caption : captions) {
+        if (writeCaption(caption.first, caption.second)) {
+            ++m_written;
+            emit captionWritten(caption.first);
+        } else {
+            ++m_failed;
+            emit imageFailed(caption.first, tr("Could not write caption file"));
+        }
+    }
+    return true;
+}
+
+std::vector<float> BulkCaptionJob::acquireTensorBuffer()
+{
+    QMutexLocker locker(&m_tensorPoolMutex);
+    if (m_freeTensorBuffers.empty()) {
+        return std::vector<float>();
+    }
+    std::vector<float> buffer = std::move(m_freeTensorBuffers.back());
+    m_freeTensorBuffers.pop_back();
+    return buffer;
+}
+
+void BulkCaptionJob::recycleTensorBuffer(std::vector<float> &buffer)
+{
+    if (buffer.capacity() == 0) {
+        return;
+    }
+    QMutexLocker locker(&m_tensorPoolMutex);
+    m_freeTensorBuffers.push_back(std::move(buffer));
+    buffer = std::vector<float>(); // Leaves the item with an empty tensor, as before
+}
+
+bool BulkCaptionJob::writeCaption(const QString &imagePath, const TaggingResult &result)
+{
+    const QStringList processedTags = result.toStringList(m_removeSeparator);
+
+    QString captionPath = captionPathForImage(imagePath);
+    QFile captionFile(captionPath);
+    if (!captionFile.open(QIODevice::WriteOnly | QIODevice::Text | QIODevice::Truncate)) {
+        qWarning() << "BulkCaptionJob: Could not write caption file:" << captionPath;
+        return false;
+    }
+    QTextStream out(&captionFile);
+    out << processedTags.join(", ");
+    captionFile.close();
+    return true;
+}
@@ -0,0 +1,124 @@
+#ifndef BULKCAPTIONJOB_H
+#define BULKCAPTIONJOB_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVariantMap>
+#include <QThreadPool>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "utils/BoundedQueue.h"
+#include "utils/AlignedBuffer.h"
+#include "TagScoreCache.h"
+#include "models/TaggingResult.h"
+
+class TaggerEnginePool;
+
+// One decoded + preprocessed image travelling from a decode thread to the inference thread
+struct BulkCaptionItem {
+    int index = -1;                  // Index into the job's image list
+    std::shared_ptr<TaggerEnginePool> pool; // Model the item was prepared for, kept alive until it is captioned
+    std::vector<float> tensorValues; // H*W*3 BGR floats, empty if skipped or failed; recycled through the job's pool
+    bool skipped = false;            // Caption already exists and overwrite is off
+    QString error;                   // Non-empty if decoding/preprocessing failed
+    bool cached = false;             // Scores came from the TagScoreCache, no inference needed
+    TagScoreCache::Scores cachedScores;
+    quint64 contentKey = 0;          // Hash of the file bytes, used to store fresh scores
+};
+
+// Captions a list of images in the background and writes a .txt next to each one.
+// Decode threads load and preprocess images into a bounded queue (which gives back-pressure
+// when inference is the slower side), and one inference thread per pool session drains it in
+// batches, leasing a session for each batch.
+// The pool is fetched per image, so a model swapped in while the job runs takes over from the
+// next image on; images already prepared finish on the pool they were prepared for.
+// Images with scores in the pool's TagScoreCache skip decoding and inference; with "bulk_cached_only"
+// set, images without cached scores are skipped too (re-thresholding an already tagged dataset).
+class BulkCaptionJob : public QObject
+{
+    Q_OBJECT
+
+public:
+    typedef std::function<std::shared_ptr<TaggerEnginePool>()> PoolProvider; // Current pool, null once unloaded
+
+    BulkCaptionJob(const PoolProvider &poolProvider, const QStringList &imagePaths, const QVariantMap &settings,
+                   QObject *parent = nullptr);
+    ~BulkCaptionJob();
+
+    void start();
+    void pause();
+    void resume();
+    void cancel();
+    void wait(); // Blocks until all pipeline threads have exited
+
+    bool isPaused() const;
+    int totalCount() const { return m_imagePaths.size(); }
+
+    static QString captionPathForImage(const QString &imagePath);
+
+signals:
+    // Emitted from pipeline threads; connect with the default (queued) connection type
+    void progress(int processed, int total);
+    void captionWritten(const QString &imagePath);
+    void imageFailed(const QString &imagePath, const QString &reason);
+    void finished(int written, int skipped, int failed, bool cancelled);
+
+private:
+    // Per inference thread, reused across batches
+    struct InferenceScratch {
+        AlignedBuffer<float> packedValues; // Grows to one full batch, then reused
+        QVector<int> packedIndices;
+        QVector<quint64> packedContentKeys;
+        QVector<TagScoreCache::Scores> rawScores;
+        QVector<TaggingResult> results;
+    };
+
+    void runDecoder();
+    void runInference();
+    // Captions batch[first, last), which all share one pool; false if that pool no longer serves
+    bool processItems(QVector<BulkCaptionItem> &batch, int first, int last, InferenceScratch &scratch);
+    bool waitWhilePaused(); // Returns false if the job was cancelled
+    bool writeCaption(const QString &imagePath, const TaggingResult &result);
+    // Tensor buffers circulate between decoders and the inference thread instead of being
+    // allocated (and page-faulted in) for every image; at most queue capacity + a batch per session + decoders exist
+    std::vector<float> acquireTensorBuffer();
+    void recycleTensorBuffer(std::vector<float> &buffer);
+
+    PoolProvider m_poolProvider;
+    QStringList m_imagePaths;
+    QVariantMap m_settings;
+    int m_batchSize;
+    int m_decoderCount;
+    // One inference thread per session of the pool at start, fixed for the whole job. Each batch
+    // leases from whatever pool is current, so after a reload to fewer sessions the extra threads
+    // wait in acquire(), and extra sessions of a bigger pool stay idle until the next job.
+    int m_inferenceCount;
+    bool m_overwriteExisting;
+    bool m_removeSeparator;
+    bool m_cachedOnly;
+
+    QThreadPool m_threadPool;
+    BoundedQueue<BulkCaptionItem> m_queue;
+    std::atomic<int> m_nextIndex;
+    std::atomic<bool> m_cancelled;
+    std::atomic<int> m_activeDecoders;  // The last one to exit closes the queue: no more input
+    std::atomic<int> m_activeInference; // The last one to exit reports finished()
+    std::atomic<int> m_processed;
+    std::atomic<int> m_written;
+    std::atomic<int> m_skipped;
+    std::atomic<int> m_failed;
+
+    QMutex m_tensorPoolMutex;
+    std::vector<std::vector<float>> m_freeTensorBuffers;
+
+    mutable QMutex m_pauseMutex;
+    QWaitCondition m_resumeCondition;
+    bool m_paused;
+};
+
+#endif // BULKCAPTIONJOB_H
@@ -0,0 +1,460 @@
+#include "DatasetIndex.h"
+#include "utils/ImageHeaderProbe.h"
+#include "utils/ExifThumbnailReader.h"
+#include "models/TagDictionary.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QSet>
+#include <QMutexLocker>
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+const char IndexMagic[4] = {'H', 'G', 'D', 'X'};
+const quint32 IndexVersion = 2; // 2: dimensions are EXIF-oriented
+
+#pragma pack(push, 1)
+struct IndexHeader {
+    char magic[4];
+    quint32 version;
+    quint32 entryCount;
+    quint32 tagIdCount;
+    quint32 tagCount;
+    quint32 reserved;
+    quint64 stringBytes;
+};
+struct EntryRecord {
+    quint32 pathOffset; // Into the string blob, relative UTF-8 path
+    quint32 pathLength;
+    qint64 fileSize;
+    qint64 modifiedMs;
+    qint64 captionModifiedMs;
+    qint32 width;
+    qint32 height;
+    quint32 captionHash;
+    quint32 tagsOffset; // Into the tag id array
+    quint32 tagCount;
+    quint8 mediaType;
+    quint8 captionKind;
+    quint16 reserved;
+};
+struct StringRef {
+    quint32 offset;
+    quint32 length;
+};
+#pragma pack(pop)
+static_assert(sizeof(IndexHeader) == 32, "Index header must stay 32 bytes");
+static_assert(sizeof(EntryRecord) == 56, "Entry records must stay 56 bytes");
+static_assert(sizeof(StringRef) == 8, "String refs must stay 8 bytes");
+
+quint32 fnv1a32(const QByteArray &data)
+{
+    quint32 hash = 2166136261u;
+    for (char c : data) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+} // namespace
+
+DatasetIndex::DatasetIndex()
+    : m_mapped(nullptr)
+    , m_mappedSize(0)
+    , m_entryCount(0)
+    , m_tagIdsOffset(0)
+    , m_tagTableOffset(0)
+    , m_stringsOffset(0)
+    , m_dirty(false)
+{
+}
+
+DatasetIndex::~DatasetIndex()
+{
+    close();
+}
+
+DatasetIndexEntry::MediaType DatasetIndex::mediaTypeForSuffix(const QString &suffix)
+{
+    static const QStringList imageExts = {"jpg", "jpeg", "png", "bmp", "gif", "webp", "tiff"};
+    static const QStringList videoExts = {"mp4", "mkv", "webm", "avi", "mov"};
+    const QString lowerSuffix = suffix.toLower();
+    if (imageExts.contains(lowerSuffix)) return DatasetIndexEntry::ImageMedia;
+    if (videoExts.contains(lowerSuffix)) return DatasetIndexEntry::VideoMedia;
+    return DatasetIndexEntry::UnknownMedia;
+}
+
+bool DatasetIndex::open(const QString &datasetDirectory)
+{
+    close();
+    QMutexLocker locker(&m_mutex);
+    m_directory = QDir(datasetDirectory).absolutePath();
+    m_indexFile.setFileName(QDir(m_directory).filePath(".haigaku/index.bin"));
+    if (!m_indexFile.exists()) {
+        qDebug() << "DatasetIndex: No index yet for" << m_directory;
+        return true; // Built up by refresh() and written on save()
+    }
+    if (!mapIndexFile()) {
+        qWarning() << "DatasetIndex: Ignoring unreadable index" << m_indexFile.fileName();
+        unmapIndexFile();
+        return false;
+    }
+    qDebug() << "DatasetIndex: Mapped" << m_entryCount << "entries and" << m_fileTagIds.size() << "tags from" << m_indexFile.fileName();
+    return true;
+}
+
+void DatasetIndex::close()
+{
+    if (isDirty()) {
+        save();
+    }
+    QMutexLocker locker(&m_mutex);
+    unmapIndexFile();
+    m_changed.clear();
+    m_directory.clear();
+    m_dirty = false;
+}
+
+bool DatasetIndex::isDirty() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_dirty;
+}
+
+bool DatasetIndex::mapIndexFile()
+{
+    if (!m_indexFile.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const qint64 fileSize = m_indexFile.size();
+    if (fileSize < static_cast<qint64>(sizeof(IndexHeader))) {
+        return false;
+    }
+    m_mapped = m_indexFile.map(0, fileSize);
+    if (!m_mapped) {
+        return false;
+    }
+    m_mappedSize = fileSize;
+
+    IndexHeader header;
+    memcpy(&header, m_mapped, sizeof(header));
+    if (memcmp(header.magic, IndexMagic, sizeof(IndexMagic)) != 0 || header.version != IndexVersion) {
+        return false;
+    }
+    const qint64 recordsEnd = sizeof(IndexHeader) + static_cast<qint64>(header.entryCount) * sizeof(EntryRecord);
+    const qint64 tagIdsEnd = recordsEnd + static_cast<qint64>(header.tagIdCount) * sizeof(quint32);
+    const qint64 tagTableEnd = tagIdsEnd + static_cast<qint64>(header.tagCount) * sizeof(StringRef);
+    if (tagTableEnd + static_cast<qint64>(header.stringBytes) != fileSize) {
+        return false; // Truncated or written by something else
+    }
+    m_entryCount = header.entryCount;
+    m_tagIdsOffset = recordsEnd;
+    m_tagTableOffset = tagIdsEnd;
+    m_stringsOffset = tagTableEnd;
+
+    // The tag table is the one section read up front: entries are handed out with dictionary ids
+    TagDictionary &dictionary = TagDictionary::instance();
+    m_fileTagIds.reserve(header.tagCount);
+    for (quint32 i = 0; i < header.tagCount; ++i) {
+        StringRef ref;
+        memcpy(&ref, m_mapped + m_tagTableOffset + static_cast<qint64>(i) * sizeof(StringRef), sizeof(ref));
+        if (static_cast<quint64>(ref.offset) + ref.length > header.stringBytes) {
+            return false;
+        }
+        m_fileTagIds.append(dictionary.intern(QString::fromUtf8(reinterpret_cast<const char *>(m_mapped + m_stringsOffset + ref.offset), ref.length)));
+    }
+    return true;
+}
+
+void DatasetIndex::unmapIndexFile()
+{
+    if (m_mapped) {
+        m_indexFile.unmap(m_mapped);
+    }
+    m_indexFile.close();
+    m_mapped = nullptr;
+    m_mappedSize = 0;
+    m_entryCount = 0;
+    m_tagIdsOffset = m_tagTableOffset = m_stringsOffset = 0;
+    m_fileTagIds.clear();
+}
+
+QByteArray DatasetIndex::relativeKey(const QString &filePath) const
+{
+    return QDir(m_directory).relativeFilePath(filePath).toUtf8();
+}
+
+DatasetIndexEntry DatasetIndex::entryAt(quint32 recordIndex) const
+{
+    EntryRecord record;
+    memcpy(&record, m_mapped + sizeof(IndexHeader) + static_cast<qint64>(recordIndex) * sizeof(EntryRecord), sizeof(record));
+
+    DatasetIndexEntry entry;
+    entry.fileSize = record.fileSize;
+    entry.modifiedMs = record.modifiedMs;
+    entry.dimensions = QSize(record.width, record.height);
+    entry.mediaType = static_cast<DatasetIndexEntry::MediaType>(record.mediaType);
+    entry.captionKind = static_cast<DatasetIndexEntry::CaptionKind>(record.captionKind);
+    entry.captionModifiedMs = record.captionModifiedMs;
+    entry.captionHash = record.captionHash;
+    if (static_cast<qint64>(record.tagsOffset) + record.tagCount <= (m_tagTableOffset - m_tagIdsOffset) / static_cast<qint64>(sizeof(quint32))) {
+        const uchar *fileTagIds = m_mapped + m_tagIdsOffset + static_cast<qint64>(record.tagsOffset) * sizeof(quint32);
+        entry.tagIds.reserve(record.tagCount);
+        for (quint32 i = 0; i < record.tagCount; ++i) {
+            quint32 fileTagId;
+            memcpy(&fileTagId, fileTagIds + i * sizeof(quint32), sizeof(fileTagId));
+            if (fileTagId < static_cast<quint32>(m_fileTagIds.size())) {
+                entry.tagIds.append(m_fileTagIds.at(fileTagId));
+            }
+        }
+    }
+    return entry;
+}
+
+bool DatasetIndex::findMapped(const QByteArray &key, DatasetIndexEntry *entry) const
+{
+    if (!m_mapped) {
+        return false;
+    }
+    // Records are sorted by path bytes, so this is a plain binary search over the mapping
+    quint32 low = 0;
+    quint32 high = m_entryCount;
+    while (low < high) {
+        const quint32 mid = low + (high - low) / 2;
+        EntryRecord record;
+        memcpy(&record, m_mapped + sizeof(IndexHeader) + static_cast<qint64>(mid) * sizeof(EntryRecord), sizeof(record));
+        if (m_stringsOffset + record.pathOffset + record.pathLength > m_mappedSize) {
+            return false;
+        }
+        const QByteArray path = QByteArray::fromRawData(reinterpret_cast<const char *>(m_mapped + m_stringsOffset + record.pathOffset), record.pathLength);
+        if (path < key) {
+            low = mid + 1;
+        } else if (key < path) {
+            high = mid;
+        } else {
+            if (entry) *entry = entryAt(mid);
+            return true;
+        }
+    }
+    return false;
+}
+
+QStringList DatasetIndex::parseCaptionTags(const QByteArray &content)
+{
+    QStringList tags;
+    const QString caption = QString::fromUtf8(content).trimmed();
+    if (caption.isEmpty()) {
+        return tags;
+    }
+    static const QRegularExpression separator("\\s*,\\s*");
+    for (const QString &tag : caption.split(separator, Qt::SkipEmptyParts)) {
+        const QString trimmedTag = tag.trimmed();
+        if (!trimmedTag.isEmpty()) {
+            tags.append(trimmedTag);
+        }
+    }
+    return tags;
+}
+
+DatasetIndexEntry DatasetIndex::refresh(const QString &filePath)
+{
+    DatasetIndexEntry current;
+    QFileInfo fileInfo(filePath);
+    if (!fileInfo.exists()) {
+        return current;
+    }
+    current.fileSize = fileInfo.size();
+    current.modifiedMs = fileInfo.lastModified().toMSecsSinceEpoch();
+    current.mediaType = mediaTypeForSuffix(fileInfo.suffix());
+
+    const QString captionBase = fileInfo.absolutePath() + "/" + fileInfo.completeBaseName();
+    QString captionPath = captionBase + ".txt";
+    QFileInfo captionInfo(captionPath);
+    current.captionKind = DatasetIndexEntry::TxtCaption;
+    if (!captionInfo.exists()) {
+        captionPath = captionBase + ".caption";
+        captionInfo.setFile(captionPath);
+        current.captionKind = captionInfo.exists() ? DatasetIndexEntry::CaptionFileCaption : DatasetIndexEntry::NoCaption;
+    }
+    if (current.captionKind != DatasetIndexEntry::NoCaption) {
+        current.captionModifiedMs = captionInfo.lastModified().toMSecsSinceEpoch();
+    }
+
+    DatasetIndexEntry known;
+    bool isKnown = false;
+    QByteArray key;
+    {
+        QMutexLocker locker(&m_mutex);
+        key = relativeKey(fileInfo.absoluteFilePath());
+        auto changed = m_changed.constFind(key);
+        if (changed != m_changed.constEnd()) {
+            known = changed.value();
+            isKnown = true;
+        } else {
+            isKnown = findMapped(key, &known);
+        }
+    }
+
+    const bool mediaUnchanged = isKnown && known.fileSize == current.fileSize && known.modifiedMs == current.modifiedMs;
+    const bool captionUnchanged = isKnown && known.captionKind == current.captionKind && known.captionModifiedMs == current.captionModifiedMs;
+    if (mediaUnchanged && captionUnchanged) {
+        return known;
+    }
+
+    // Probe outside the lock; the header read and the caption are the only file contents touched
+    if (mediaUnchanged) {
+        current.dimensions = known.dimensions;
+    } else if (current.mediaType == DatasetIndexEntry::ImageMedia) {
+        current.dimensions = ImageHeaderProbe::probe(filePath); // Reads a few dozen bytes for the common formats
+        if (ExifThumbnailReader::swapsAxes(ExifThumbnailReader::readOrientation(filePath))) {
+            current.dimensions.transpose(); // Same orientation as the decoded preview shows
+        }
+    }
+    QStringList captionTags;
+    if (captionUnchanged) {
+        current.captionHash = known.captionHash;
+        current.tagIds = known.tagIds;
+    } else if (current.captionKind != DatasetIndexEntry::NoCaption) {
+        QFile captionFile(captionPath);
+        if (captionFile.open(QIODevice::ReadOnly)) {
+            const QByteArray content = captionFile.readAll();
+            current.captionHash = fnv1a32(content);
+            captionTags = parseCaptionTags(content);
+        }
+    }
+
+    if (!captionUnchanged) {
+        current.tagIds = TagDictionary::instance().intern(captionTags);
+    }
+    QMutexLocker locker(&m_mutex);
+    m_changed.insert(key, current);
+    m_dirty = true;
+    return current;
+}
+
+bool DatasetIndex::save(const QStringList &keepFilePaths)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_directory.isEmpty()) {
+        return false; // In-memory only
+    }
+
+    QSet<QByteArray> keep;
+    for (const QString &filePath : keepFilePaths) {
+        keep.insert(relativeKey(filePath));
+    }
+
+    // Merge the mapped records with what changed since, before the mapping goes away
+    QVector<QPair<QByteArray, DatasetIndexEntry>> entries;
+    entries.reserve(static_cast<int>(m_entryCount) + m_changed.size());
+    for (quint32 i = 0; m_mapped && i < m_entryCount; ++i) {
+        EntryRecord record;
+        memcpy(&record, m_mapped + sizeof(IndexHeader) + static_cast<qint64>(i) * sizeof(EntryRecord), sizeof(record));
+        if (m_stringsOffset + record.pathOffset + record.pathLength > m_mappedSize) {
+            continue;
+        }
+        const QByteArray key(reinterpret_cast<const char *>(m_mapped + m_stringsOffset + record.pathOffset), record.pathLength);
+        if (m_changed.contains(key) || (!keep.isEmpty() && !keep.contains(key))) {
+            continue;
+        }
+        entries.append({key, entryAt(i)});
+    }
+    for (auto it = m_changed.constBegin(); it != m_changed.constEnd(); ++it) {
+        if (keep.isEmpty() || keep.contains(it.key())) {
+            entries.append({it.key(), it.value()});
+        }
+    }
+    std::sort(entries.begin(), entries.end(), [](const QPair<QByteArray, DatasetIndexEntry> &a, const QPair<QByteArray, DatasetIndexEntry> &b) {
+        return a.first < b.first;
+    });
+
+    QByteArray records;
+    QByteArray tagIds;
+    QByteArray tagTable;
+    QByteArray strings;
+    records.reserve(entries.size() * static_cast<int>(sizeof(EntryRecord)));
+    quint32 tagIdCount = 0;
+    QHash<quint32, quint32> fileTagIdOf; // Dictionary id -> index in this file's tag table, only tags still in use
+    QVector<quint32> fileTags;
+    for (const auto &pair : entries) {
+        const DatasetIndexEntry &entry = pair.second;
+        EntryRecord record = {};
+        record.pathOffset = static_cast<quint32>(strings.size());
+        record.pathLength = static_cast<quint32>(pair.first.size());
+        record.fileSize = entry.fileSize;
+        record.modifiedMs = entry.modifiedMs;
+        record.captionModifiedMs = entry.captionModifiedMs;
+        record.width = entry.dimensions.width();
+        record.height = entry.dimensions.height();
+        record.captionHash = entry.captionHash;
+        record.tagsOffset = tagIdCount;
+        record.tagCount = static_cast<quint32>(entry.tagIds.size());
+        record.mediaType = entry.mediaType;
+        record.captionKind = entry.captionKind;
+        strings.append(pair.first);
+        records.append(reinterpret_cast<const char *>(&record), sizeof(record));
+        for (quint32 tagId : entry.tagIds) {
+            auto fileTagId = fileTagIdOf.constFind(tagId);
+            if (fileTagId == fileTagIdOf.constEnd()) {
+                fileTagId = fileTagIdOf.insert(tagId, static_cast<quint32>(fileTags.size()));
+                fileTags.append(tagId);
+            }
+            tagIds.append(reinterpret_cast<const char *>(&fileTagId.value()), sizeof(quint32));
+        }
+        tagIdCount += record.tagCount;
+    }
+    const QStringList tagNames = TagDictionary::instance().texts(fileTags);
+    for (const QString &tag : tagNames) {
+        const QByteArray utf8 = tag.toUtf8();
+        const StringRef ref = {static_cast<quint32>(strings.size()), static_cast<quint32>(utf8.size())};
+        strings.append(utf8);
+        tagTable.append(reinterpret_cast<const char *>(&ref), sizeof(ref));
+    }
+
+    IndexHeader header = {};
+    memcpy(header.magic, IndexMagic, sizeof(IndexMagic));
+    header.version = IndexVersion;
+    header.entryCount = static_cast<quint32>(entries.size());
+    header.tagIdCount = tagIdCount;
+    header.tagCount = static_cast<quint32>(tagNames.size());
+    header.stringBytes = static_cast<quint64>(strings.size());
+
+    if (!QDir().mkpath(QDir(m_directory).filePath(".haigaku"))) {
+        qWarning() << "DatasetIndex: Cannot create .haigaku in" << m_directory << "(read-only dataset?)";
+        return false;
+    }
+    const QString indexPath = m_indexFile.fileName();
+    unmapIndexFile(); // The file is replaced underneath; Windows refuses while it is mapped
+
+    QSaveFile indexFile(indexPath);
+    bool written = indexFile.open(QIODevice::WriteOnly);
+    written = written && indexFile.write(reinterpret_cast<const char *>(&header), sizeof(header)) == sizeof(header);
+    written = written && indexFile.write(records) == records.size();
+    written = written && indexFile.write(tagIds) == tagIds.size();
+    written = written && indexFile.write(tagTable) == tagTable.size();
+    written = written && indexFile.write(strings) == strings.size();
+    written = written && indexFile.commit();
+    if (!written) {
+        qWarning() << "DatasetIndex: Could not write" << indexPath << indexFile.errorString();
+        for (const auto &pair : std::as_const(entries)) {
+            m_changed.insert(pair.first, pair.second); // The mapping is gone, so keep everything in memory instead
+        }
+        m_indexFile.setFileName(indexPath);
+        return false;
+    }
+
+    m_changed.clear();
+    m_dirty = false;
+    m_indexFile.setFileName(indexPath);
+    if (!mapIndexFile()) {
+        qWarning() << "DatasetIndex: Could not remap" << indexPath;
+        unmapIndexFile();
+        return false;
+    }
+    qDebug() << "DatasetIndex: Saved" << header.entryCount << "entries to" << indexPath;
+    return true;
+}
@@ -0,0 +1,73 @@
+#ifndef DATASETINDEX_H
+#define DATASETINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QSize>
+#include <QVector>
+#include <QHash>
+#include <QMutex>
+#include <QFile>
+
+// What the index remembers about one media file and its caption
+struct DatasetIndexEntry {
+    enum MediaType : quint8 { UnknownMedia = 0, ImageMedia = 1, VideoMedia = 2 };
+    enum CaptionKind : quint8 { NoCaption = 0, TxtCaption = 1, CaptionFileCaption = 2 }; // .txt wins over .caption
+
+    qint64 fileSize = -1; // -1 if the file doesn't exist
+    qint64 modifiedMs = 0;
+    QSize dimensions;     // As displayed (after EXIF rotation), invalid for videos / unreadable images
+    MediaType mediaType = UnknownMedia;
+    CaptionKind captionKind = NoCaption;
+    qint64 captionModifiedMs = 0;
+    quint32 captionHash = 0; // FNV-1a of the caption file bytes
+    QVector<quint32> tagIds; // Comma-separated caption entries, trimmed; TagDictionary ids
+};
+
+// Per-dataset metadata index stored next to the data in <dataset>/.haigaku/index.bin.
+// Layout: 32-byte header, fixed 56-byte entry records sorted by relative UTF-8 path, a flat
+// array of tag ids, a tag string table and a string blob. Tag ids in the file index its own table;
+// entries handed out carry process-wide TagDictionary ids. The file is memory-mapped on open and
+// looked up by binary search, so reopening a folder costs no parsing. refresh() compares size and
+// mtime (of the file and its caption) against the index and only re-probes what changed; changes
+// collect in memory until save() rewrites the file. Thread-safe. Works without open() as an
+// in-memory cache.
+class DatasetIndex
+{
+public:
+    DatasetIndex();
+    ~DatasetIndex();
+
+    bool open(const QString &datasetDirectory);
+    void close(); // Saves pending changes first
+    bool save(const QStringList &keepFilePaths = QStringList()); // Non-empty: drop entries not in the list
+    bool isDirty() const;
+
+    DatasetIndexEntry refresh(const QString &filePath); // Up-to-date entry, re-probing only on mismatch
+
+    static DatasetIndexEntry::MediaType mediaTypeForSuffix(const QString &suffix);
+
+private:
+    bool mapIndexFile();
+    void unmapIndexFile();
+    QByteArray relativeKey(const QString &filePath) const;
+    bool findMapped(const QByteArray &key, DatasetIndexEntry *entry) const; // m_mutex must be held
+    DatasetIndexEntry entryAt(quint32 recordIndex) const; // m_mutex must be held
+    static QStringList parseCaptionTags(const QByteArray &content);
+
+    mutable QMutex m_mutex;
+    QString m_directory;
+    QFile m_indexFile;
+    uchar *m_mapped;
+    qint64 m_mappedSize;
+    quint32 m_entryCount;
+    qint64 m_tagIdsOffset; // Section offsets into m_mapped
+    qint64 m_tagTableOffset;
+    qint64 m_stringsOffset;
+
+    QHash<QByteArray, DatasetIndexEntry> m_changed; // Refreshed since the last save, by relative path
+    QVector<quint32> m_fileTagIds; // The mapped file's tag table translated to TagDictionary ids
+    bool m_dirty;
+};
+
+#endif // DATASETINDEX_H
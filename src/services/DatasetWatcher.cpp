@@ -0,0 +1,303 @@
+#include "DatasetWatcher.h"
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QThreadPool>
+#include <QPointer>
+#include <QCoreApplication>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+const int CoalesceMs = 200;     // Quiet period after the last event before re-listing
+const qint64 MaxCoalesceMs = 1000; // A steady stream of writes still gets applied about once a second
+
+bool isCaptionName(const QString &fileName)
+{
+    return fileName.endsWith(".txt", Qt::CaseInsensitive) || fileName.endsWith(".caption", Qt::CaseInsensitive);
+}
+
+bool isUnder(const QString &path, const QString &directory)
+{
+    return path == directory || path.startsWith(directory + '/');
+}
+} // namespace
+
+DatasetWatcher::DatasetWatcher(QObject *parent)
+    : QObject(parent)
+    , m_watcher(new QFileSystemWatcher(this))
+    , m_coalesceTimer(new QTimer(this))
+    , m_recursive(false)
+    , m_rescanRunning(false)
+    , m_initialPass(false)
+    , m_generation(0)
+{
+    m_coalesceTimer->setSingleShot(true);
+    m_coalesceTimer->setInterval(CoalesceMs);
+    connect(m_coalesceTimer, &QTimer::timeout, this, &DatasetWatcher::rescanDirtyDirectories);
+    connect(m_watcher, &QFileSystemWatcher::directoryChanged, this, &DatasetWatcher::onDirectoryChanged);
+    connect(m_watcher, &QFileSystemWatcher::fileChanged, this, &DatasetWatcher::onFileChanged);
+}
+
+DatasetWatcher::~DatasetWatcher()
+{
+    stop();
+}
+
+void DatasetWatcher::stop()
+{
+    ++m_generation; // Drops the result of a pass still running
+    m_coalesceTimer->stop();
+    if (!m_watcher->directories().isEmpty()) m_watcher->removePaths(m_watcher->directories());
+    if (!m_watcher->files().isEmpty()) m_watcher->removePaths(m_watcher->files());
+    m_dirtyDirectories.clear();
+    m_snapshots.clear();
+    m_focusFiles.clear();
+    m_rootDirectory.clear();
+    m_rescanRunning = false;
+    m_initialPass = false;
+}
+
+void DatasetWatcher::watch(const QString &directory, const QStringList &suffixes, bool recursive, const QStringList &knownFilePaths)
+{
+    stop();
+    m_rootDirectory = QDir(directory).absolutePath();
+    m_recursive = recursive;
+    m_suffixes.clear();
+    for (const QString &suffix : suffixes) {
+        m_suffixes.insert(suffix.toLower());
+    }
+
+    // Seed the snapshots with what the caller shows, so the first pass reports exactly the difference
+    m_snapshots.insert(m_rootDirectory, DirectorySnapshot());
+    for (const QString &filePath : knownFilePaths) {
+        QFileInfo fileInfo(filePath);
+        m_snapshots[fileInfo.absolutePath()].insert(fileInfo.fileName(), FileStamp());
+    }
+    const QStringList directories = m_snapshots.keys();
+    const QStringList failed = m_watcher->addPaths(directories); // Before listing, so nothing written meanwhile is missed
+    if (!failed.isEmpty()) {
+        qWarning() << "DatasetWatcher: Could not watch" << failed.size() << "directories (inotify watch limit?)";
+    }
+    for (const QString &dir : directories) {
+        m_dirtyDirectories.insert(dir);
+    }
+    m_initialPass = true;
+    rescanDirtyDirectories();
+}
+
+void DatasetWatcher::setFocusFile(const QString &mediaPath)
+{
+    if (!m_focusFiles.isEmpty()) {
+        m_watcher->removePaths(m_focusFiles);
+        m_focusFiles.clear();
+    }
+    if (mediaPath.isEmpty() || m_rootDirectory.isEmpty()) {
+        return;
+    }
+    QFileInfo mediaInfo(mediaPath);
+    const QString baseName = mediaInfo.absolutePath() + "/" + mediaInfo.completeBaseName();
+    for (const QString &path : {mediaInfo.absoluteFilePath(), baseName + ".txt", baseName + ".caption"}) {
+        if (QFile::exists(path)) {
+            m_focusFiles.append(path); // A caption created later shows up through the directory watch
+        }
+    }
+    if (!m_focusFiles.isEmpty()) {
+        m_watcher->addPaths(m_focusFiles);
+    }
+}
+
+void DatasetWatcher::onFileChanged(const QString &filePath)
+{
+    onDirectoryChanged(QFileInfo(filePath).absolutePath());
+    if (QFile::exists(filePath) && !m_watcher->files().contains(filePath)) {
+        m_watcher->addPath(filePath); // Replaced by rename-over-write: inotify dropped the old watch
+    }
+}
+
+void DatasetWatcher::onDirectoryChanged(const QString &directory)
+{
+    if (m_rootDirectory.isEmpty()) {
+        return;
+    }
+    if (!m_coalesceTimer->isActive()) {
+        m_firstPendingEvent.start();
+    }
+    m_dirtyDirectories.insert(QDir(directory).absolutePath());
+    if (!m_coalesceTimer->isActive() || m_firstPendingEvent.elapsed() < MaxCoalesceMs) {
+        m_coalesceTimer->start(); // Restarts the quiet period
+    }
+}
+
+void DatasetWatcher::rescanDirtyDirectories()
+{
+    if (m_rescanRunning || m_dirtyDirectories.isEmpty()) {
+        return; // A running pass re-arms the timer when it is delivered
+    }
+    m_rescanRunning = true;
+    const QStringList directories = m_dirtyDirectories.values();
+    m_dirtyDirectories.clear();
+
+    const QHash<QString, DirectorySnapshot> oldSnapshots = m_snapshots; // Implicitly shared, no copy until we write
+    const QSet<QString> suffixes = m_suffixes;
+    const bool recursive = m_recursive;
+    const bool initialPass = m_initialPass;
+    const quint64 generation = m_generation;
+    QPointer<DatasetWatcher> self(this);
+    QThreadPool::globalInstance()->start([=]() {
+        const ScanResult result = scan(directories, oldSnapshots, suffixes, recursive, initialPass);
+        // Posted through the application object: the watcher may be gone by the time this runs
+        QMetaObject::invokeMethod(QCoreApplication::instance(), [self, generation, result]() {
+            if (self) self->deliverResult(generation, result);
+        }, Qt::QueuedConnection);
+    });
+}
+
+DatasetWatcher::ScanResult DatasetWatcher::scan(const QStringList &directories, const QHash<QString, DirectorySnapshot> &oldSnapshots,
+                                                const QSet<QString> &suffixes, bool recursive, bool initialPass)
+{
+    ScanResult result;
+    QHash<QString, FileStamp> addedStamps;
+    QHash<QString, FileStamp> removedStamps;
+    auto isMedia = [&suffixes](const QString &fileName) { return suffixes.contains(QFileInfo(fileName).suffix().toLower()); };
+
+    QStringList queue = directories;
+    QSet<QString> visited;
+    while (!queue.isEmpty()) {
+        const QString directory = queue.takeFirst();
+        if (visited.contains(directory)) {
+            continue;
+        }
+        visited.insert(directory);
+
+        QDir dir(directory);
+        if (!dir.exists()) {
+            // Everything below it went too; nested directories may not have fired yet
+            for (auto it = oldSnapshots.constBegin(); it != oldSnapshots.constEnd(); ++it) {
+                if (!isUnder(it.key(), directory)) continue;
+                result.vanishedDirectories.append(it.key());
+                for (auto file = it.value().constBegin(); file != it.value().constEnd(); ++file) {
+                    if (isMedia(file.key())) {
+                        const QString filePath = it.key() + "/" + file.key();
+                        result.removed.append(filePath);
+                        removedStamps.insert(filePath, file.value());
+                    }
+                }
+            }
+            continue;
+        }
+
+        DirectorySnapshot snapshot;
+        const QFileInfoList entries = dir.entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+        for (const QFileInfo &info : entries) {
+            if (info.isDir()) {
+                // Directories we already know fire on their own; new ones (and their contents) are walked now
+                if (recursive && !oldSnapshots.contains(info.absoluteFilePath()) && !result.snapshots.contains(info.absoluteFilePath())) {
+                    queue.append(info.absoluteFilePath());
+                }
+            } else if (isMedia(info.fileName()) || isCaptionName(info.fileName())) {
+                snapshot.insert(info.fileName(), {info.size(), info.lastModified().toMSecsSinceEpoch()});
+            }
+        }
+
+        const DirectorySnapshot previous = oldSnapshots.value(directory);
+        QSet<QString> changedCaptionBases;
+        for (auto it = snapshot.constBegin(); it != snapshot.constEnd(); ++it) {
+            const auto old = previous.constFind(it.key());
+            const bool existed = old != previous.constEnd();
+            const bool stampChanged = existed && old->size >= 0 && (old->size != it->size || old->modifiedMs != it->modifiedMs);
+            if (isCaptionName(it.key())) {
+                if (!initialPass && (!existed || stampChanged)) changedCaptionBases.insert(QFileInfo(it.key()).completeBaseName());
+            } else if (!existed) {
+                result.added.append(directory + "/" + it.key());
+                addedStamps.insert(result.added.last(), it.value());
+            } else if (stampChanged) {
+                result.modified.append(directory + "/" + it.key());
+            }
+        }
+        for (auto it = previous.constBegin(); it != previous.constEnd(); ++it) {
+            if (snapshot.contains(it.key())) continue;
+            if (isCaptionName(it.key())) {
+                changedCaptionBases.insert(QFileInfo(it.key()).completeBaseName());
+            } else {
+                result.removed.append(directory + "/" + it.key());
+                removedStamps.insert(result.removed.last(), it.value());
+            }
+        }
+        if (!changedCaptionBases.isEmpty()) {
+            for (auto it = snapshot.constBegin(); it != snapshot.constEnd(); ++it) {
+                if (!isCaptionName(it.key()) && changedCaptionBases.contains(QFileInfo(it.key()).completeBaseName())) {
+                    result.captionsChanged.append(directory + "/" + it.key());
+                }
+            }
+        }
+        result.snapshots.insert(directory, snapshot);
+    }
+
+    // A rename keeps size and mtime; pair up what vanished with what appeared
+    if (!result.removed.isEmpty() && !result.added.isEmpty()) {
+        QHash<QPair<qint64, qint64>, QString> removedByStamp;
+        for (auto it = removedStamps.constBegin(); it != removedStamps.constEnd(); ++it) {
+            if (it->size >= 0) removedByStamp.insert({it->size, it->modifiedMs}, it.key());
+        }
+        QSet<QString> renamedFrom;
+        QStringList stillAdded;
+        for (const QString &filePath : std::as_const(result.added)) {
+            const FileStamp stamp = addedStamps.value(filePath);
+            const QString oldPath = removedByStamp.take({stamp.size, stamp.modifiedMs});
+            if (oldPath.isEmpty()) {
+                stillAdded.append(filePath);
+            } else {
+                result.renamed.append({oldPath, filePath});
+                renamedFrom.insert(oldPath);
+            }
+        }
+        result.added = stillAdded;
+        result.removed.erase(std::remove_if(result.removed.begin(), result.removed.end(),
+                                            [&renamedFrom](const QString &path) { return renamedFrom.contains(path); }),
+                             result.removed.end());
+    }
+    return result;
+}
+
+void DatasetWatcher::deliverResult(quint64 generation, const ScanResult &result)
+{
+    if (generation != m_generation) {
+        return;
+    }
+    m_rescanRunning = false;
+    m_initialPass = false;
+
+    QStringList newDirectories;
+    for (const QString &directory : result.vanishedDirectories) {
+        m_snapshots.remove(directory);
+    }
+    if (!result.vanishedDirectories.isEmpty()) {
+        m_watcher->removePaths(result.vanishedDirectories); // Usually already dropped by the watcher itself
+    }
+    for (auto it = result.snapshots.constBegin(); it != result.snapshots.constEnd(); ++it) {
+        if (!m_snapshots.contains(it.key())) newDirectories.append(it.key());
+        m_snapshots.insert(it.key(), it.value());
+    }
+    newDirectories.removeAll(m_rootDirectory);
+    if (!newDirectories.isEmpty()) {
+        m_watcher->addPaths(newDirectories);
+    }
+
+    if (!result.removed.isEmpty() || !result.added.isEmpty() || !result.renamed.isEmpty() || !result.modified.isEmpty()) {
+        qDebug() << "DatasetWatcher:" << result.added.size() << "added," << result.removed.size() << "removed,"
+                 << result.renamed.size() << "renamed," << result.modified.size() << "modified";
+    }
+    if (!result.removed.isEmpty()) emit filesRemoved(result.removed);
+    if (!result.renamed.isEmpty()) emit filesRenamed(result.renamed);
+    if (!result.added.isEmpty()) emit filesAdded(result.added);
+    if (!result.modified.isEmpty()) emit filesModified(result.modified);
+    if (!result.captionsChanged.isEmpty()) emit captionsChanged(result.captionsChanged);
+
+    if (!m_dirtyDirectories.isEmpty() && !m_coalesceTimer->isActive()) {
+        m_firstPendingEvent.start();
+        m_coalesceTimer->start(); // Events that arrived during the pass
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef DATASETWATCHER_H
+#define DATASETWATCHER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QSet>
+#include <QPair>
+#include <QList>
+#include <QElapsedTimer>
+
+QT_BEGIN_NAMESPACE
+class QFileSystemWatcher;
+class QTimer;
+QT_END_NAMESPACE
+
+// Reports changes made to a dataset folder from outside the app (a script writing images, another
+// tool editing captions) without re-listing the whole folder. Directories are watched with
+// QFileSystemWatcher (inotify on Linux); change notifications are coalesced and only the directories
+// that fired are re-listed on a pool thread and diffed against the previous snapshot.
+// A media file that disappears and another that appears with the same size and mtime in the same
+// pass is reported as a rename. Signals are emitted on the thread the watcher lives in.
+class DatasetWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DatasetWatcher(QObject *parent = nullptr);
+    ~DatasetWatcher();
+
+    // knownFilePaths is what the caller already shows; differences to it are reported by the first pass
+    void watch(const QString &directory, const QStringList &suffixes, bool recursive, const QStringList &knownFilePaths);
+    void stop();
+
+    // Directory watches miss files rewritten in place, so the displayed file and its caption are watched individually
+    void setFocusFile(const QString &mediaPath);
+
+signals:
+    void filesAdded(const QStringList &filePaths);
+    void filesRemoved(const QStringList &filePaths);
+    void filesRenamed(const QList<QPair<QString, QString>> &renames); // (old path, new path)
+    void filesModified(const QStringList &filePaths);   // Media content changed in place
+    void captionsChanged(const QStringList &mediaPaths); // .txt/.caption of these media written, added or removed
+
+private slots:
+    void onDirectoryChanged(const QString &directory);
+    void onFileChanged(const QString &filePath);
+    void rescanDirtyDirectories();
+
+private:
+    struct FileStamp {
+        qint64 size = -1; // -1: known from the caller's list, not stat'ed yet
+        qint64 modifiedMs = 0;
+    };
+    using DirectorySnapshot = QHash<QString, FileStamp>; // File name -> stamp, media and caption files
+
+    struct ScanResult {
+        QHash<QString, DirectorySnapshot> snapshots; // Re-listed directories (and new subdirectories)
+        QStringList vanishedDirectories;
+        QStringList added;
+        QStringList removed;
+        QList<QPair<QString, QString>> renamed;
+        QStringList modified;
+        QStringList captionsChanged;
+    };
+
+    // Runs on a pool thread against a copy of the snapshots
+    static ScanResult scan(const QStringList &directories, const QHash<QString, DirectorySnapshot> &oldSnapshots,
+                           const QSet<QString> &suffixes, bool recursive, bool initialPass);
+    void deliverResult(quint64 generation, const ScanResult &result);
+
+    QFileSystemWatcher *m_watcher;
+    QTimer *m_coalesceTimer;
+    QElapsedTimer m_firstPendingEvent; // Bursts are coalesced, but never delayed past MaxCoalesceMs
+    QSet<QString> m_dirtyDirectories;
+    QHash<QString, DirectorySnapshot> m_snapshots; // By absolute directory path
+    QStringList m_focusFiles;
+    QSet<QString> m_suffixes;
+    QString m_rootDirectory;
+    bool m_recursive;
+    bool m_rescanRunning;
+    bool m_initialPass; // Captions found by the first pass are not reported as changed
+    quint64 m_generation;
+};
+
+#endif // DATASETWATCHER_H
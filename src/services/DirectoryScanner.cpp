@@ -0,0 +1,110 @@
+#include "DirectoryScanner.h"
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <QPointer>
+#include <QCoreApplication>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+const int FirstBatchSize = 256;      // Enough for the first screen
+const int BatchSize = 4096;
+const qint64 BatchIntervalMs = 100;  // Flush smaller batches on slow shares rather than waiting for a full one
+}
+
+DirectoryScanner::DirectoryScanner(QObject *parent)
+    : QObject(parent)
+    , m_generation(0)
+    , m_running(false)
+{
+}
+
+DirectoryScanner::~DirectoryScanner()
+{
+    cancel();
+}
+
+void DirectoryScanner::cancel()
+{
+    if (m_state) {
+        m_state->cancelled = true;
+        m_state.reset();
+    }
+    ++m_generation;
+    m_running = false;
+}
+
+void DirectoryScanner::start(const QString &directory, const QStringList &suffixes, bool recursive)
+{
+    cancel();
+    m_state = std::make_shared<ScanState>();
+    m_running = true;
+
+    const std::shared_ptr<ScanState> state = m_state;
+    const quint64 generation = m_generation;
+    QPointer<DirectoryScanner> self(this);
+    QStringList nameFilters;
+    for (const QString &suffix : suffixes) {
+        nameFilters.append("*." + suffix);
+    }
+
+    QThreadPool::globalInstance()->start([=]() {
+        QElapsedTimer timer;
+        timer.start();
+        QDirIterator it(directory, nameFilters, QDir::Files | QDir::NoDotAndDotDot,
+                        recursive ? QDirIterator::Subdirectories : QDirIterator::NoIteratorFlags);
+        QStringList all;
+        QStringList batch;
+        qint64 lastFlush = 0;
+        auto flush = [&]() {
+            std::sort(batch.begin(), batch.end());
+            // Posted through the application object: the scanner may be gone by the time this runs
+            QMetaObject::invokeMethod(QCoreApplication::instance(), [self, generation, batch]() {
+                if (self) self->deliverBatch(generation, batch);
+            }, Qt::QueuedConnection);
+            batch.clear();
+            lastFlush = timer.elapsed();
+        };
+
+        while (it.hasNext()) {
+            if (state->cancelled) {
+                return;
+            }
+            const QString filePath = it.next();
+            all.append(filePath);
+            batch.append(filePath);
+            const int wanted = all.size() <= FirstBatchSize ? FirstBatchSize : BatchSize;
+            if (batch.size() >= wanted || (timer.elapsed() - lastFlush >= BatchIntervalMs && !batch.isEmpty())) {
+                flush();
+            }
+        }
+        if (!batch.isEmpty()) {
+            flush();
+        }
+
+        std::sort(all.begin(), all.end());
+        if (state->cancelled) {
+            return;
+        }
+        qDebug() << "DirectoryScanner: Found" << all.size() << "files in" << directory << "in" << timer.elapsed() << "ms";
+        QMetaObject::invokeMethod(QCoreApplication::instance(), [self, generation, all]() {
+            if (self) self->deliverFinished(generation, all);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void DirectoryScanner::deliverBatch(quint64 generation, const QStringList &filePaths)
+{
+    if (generation == m_generation) {
+        emit batchFound(filePaths);
+    }
+}
+
+void DirectoryScanner::deliverFinished(quint64 generation, const QStringList &sortedFilePaths)
+{
+    if (generation == m_generation) {
+        m_running = false;
+        emit finished(sortedFilePaths);
+    }
+}
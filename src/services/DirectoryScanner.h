@@ -0,0 +1,43 @@
+#ifndef DIRECTORYSCANNER_H
+#define DIRECTORYSCANNER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <atomic>
+#include <memory>
+
+// Lists the media files of a dataset folder on a pool thread and streams them back in batches,
+// so the first screen of a huge folder or a slow network share shows up before the walk is done.
+// Each batch is sorted on its own; finished() delivers the complete, sorted list.
+// Starting a new scan (or cancel()) abandons the previous one; its late signals are never emitted.
+class DirectoryScanner : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DirectoryScanner(QObject *parent = nullptr);
+    ~DirectoryScanner();
+
+    void start(const QString &directory, const QStringList &suffixes, bool recursive);
+    void cancel();
+    bool isRunning() const { return m_running; }
+
+signals:
+    void batchFound(const QStringList &filePaths);
+    void finished(const QStringList &sortedFilePaths);
+
+private:
+    struct ScanState {
+        std::atomic<bool> cancelled{false};
+    };
+
+    void deliverBatch(quint64 generation, const QStringList &filePaths);
+    void deliverFinished(quint64 generation, const QStringList &sortedFilePaths);
+
+    std::shared_ptr<ScanState> m_state; // Shared with the running scan so cancellation outlives us
+    quint64 m_generation;
+    bool m_running;
+};
+
+#endif // DIRECTORYSCANNER_H
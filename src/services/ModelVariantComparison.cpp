@@ -0,0 +1,143 @@
+#include "ModelVariantComparison.h"
+#include "WdVIT_TaggerEngine.h"
+#include "models/TagDictionary.h"
+#include <QElapsedTimer>
+#include <QHash>
+#include <QImageReader>
+#include <QSet>
+#include <QDebug>
+#include <algorithm>
+#include <vector>
+
+ModelVariantComparison::ModelVariantComparison(const QString &referenceModelPath, const QString &candidateModelPath,
+                                               const QString &tagsCsvPath, const QStringList &imagePaths,
+                                               const QVariantMap &settings, QObject *parent)
+    : QObject(parent)
+    , m_referenceModelPath(referenceModelPath)
+    , m_candidateModelPath(candidateModelPath)
+    , m_tagsCsvPath(tagsCsvPath)
+    , m_imagePaths(imagePaths)
+    , m_settings(settings)
+    , m_cancelled(false)
+{
+}
+
+void ModelVariantComparison::cancel()
+{
+    m_cancelled = true;
+}
+
+ModelComparisonReport ModelVariantComparison::run()
+{
+    ModelComparisonReport report;
+
+    // Both variants are compared on the CPU, which is where the quantized model is meant to run
+    WdVIT_TaggerEngine referenceEngine;
+    WdVIT_TaggerEngine candidateEngine;
+    if (!referenceEngine.loadModel(m_referenceModelPath, m_tagsCsvPath, true, false, false, m_settings)) {
+        report.errorMessage = tr("Could not load reference model %1").arg(m_referenceModelPath);
+        return report;
+    }
+    if (!candidateEngine.loadModel(m_candidateModelPath, m_tagsCsvPath, true, false, false, m_settings)) {
+        report.errorMessage = tr("Could not load candidate model %1").arg(m_candidateModelPath);
+        return report;
+    }
+    const QSize inputSize = referenceEngine.modelInputSize();
+    if (candidateEngine.modelInputSize() != inputSize) {
+        report.errorMessage = tr("The two models expect different input sizes.");
+        return report;
+    }
+
+    const int batchSize = qMax(1, m_settings.value("batch_size", 8).toInt());
+    const size_t imageElementCount = static_cast<size_t>(inputSize.height()) * inputSize.width() * 3;
+    const int total = m_imagePaths.size();
+    std::vector<float> batchValues;
+    QHash<quint32, TagAgreement> agreements; // By TagDictionary id; the text is filled in at the end
+    bool warmedUp = false;
+    int processed = 0;
+
+    for (int start = 0; start < total && !m_cancelled; start += batchSize) {
+        const int end = qMin(total, start + batchSize);
+        batchValues.resize(imageElementCount * (end - start));
+        int packed = 0;
+        for (int i = start; i < end; ++i) {
+            QImageReader reader(m_imagePaths.at(i));
+            reader.setAutoTransform(true);
+            QImage image = reader.read();
+            if (image.isNull()) {
+                qWarning() << "ModelVariantComparison: Skipping unreadable image" << m_imagePaths.at(i) << reader.errorString();
+                continue;
+            }
+            if (referenceEngine.preprocessImage(image, inputSize.height(), inputSize.width(), batchValues.data() + imageElementCount * packed)) {
+                ++packed;
+            }
+        }
+        processed = end;
+        if (packed == 0) {
+            emit progress(processed, total);
+            continue;
+        }
+
+        if (!warmedUp) { // First runs pay for allocations and lazy initialization, keep them out of the timings
+            referenceEngine.generateTagsPreprocessed(batchValues.data(), packed, m_settings);
+            candidateEngine.generateTagsPreprocessed(batchValues.data(), packed, m_settings);
+            warmedUp = true;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        const QVector<TaggingResult> referenceTags = referenceEngine.generateTagsPreprocessed(batchValues.data(), packed, m_settings);
+        report.referenceSeconds += timer.nsecsElapsed() / 1e9;
+        timer.restart();
+        const QVector<TaggingResult> candidateTags = candidateEngine.generateTagsPreprocessed(batchValues.data(), packed, m_settings);
+        report.candidateSeconds += timer.nsecsElapsed() / 1e9;
+
+        if (referenceTags.size() != packed || candidateTags.size() != packed) {
+            report.errorMessage = tr("Inference failed while comparing models.");
+            return report;
+        }
+
+        for (int i = 0; i < packed; ++i) {
+            const QSet<quint32> referenceSet(referenceTags.at(i).tagIds.begin(), referenceTags.at(i).tagIds.end());
+            const QSet<quint32> candidateSet(candidateTags.at(i).tagIds.begin(), candidateTags.at(i).tagIds.end());
+            for (quint32 tag : referenceSet) {
+                TagAgreement &agreement = agreements[tag];
+                ++agreement.referenceCount;
+                if (candidateSet.contains(tag)) {
+                    ++agreement.bothCount;
+                    ++report.truePositives;
+                } else {
+                    ++report.falseNegatives;
+                }
+            }
+            for (quint32 tag : candidateSet) {
+                TagAgreement &agreement = agreements[tag];
+                ++agreement.candidateCount;
+                if (!referenceSet.contains(tag)) {
+                    ++report.falsePositives;
+                }
+            }
+        }
+        report.imageCount += packed;
+        emit progress(processed, total);
+    }
+
+    const TagDictionary &dictionary = TagDictionary::instance();
+    for (auto it = agreements.begin(); it != agreements.end(); ++it) {
+        it->tag = dictionary.text(it.key());
+    }
+    report.tags = agreements.values().toVector();
+    std::sort(report.tags.begin(), report.tags.end(), [](const TagAgreement &a, const TagAgreement &b) {
+        if (a.disagreements() != b.disagreements()) return a.disagreements() > b.disagreements();
+        return a.referenceCount > b.referenceCount;
+    });
+    report.cancelled = m_cancelled;
+    report.success = report.imageCount > 0;
+    if (!report.success && report.errorMessage.isEmpty()) {
+        report.errorMessage = tr("No images could be compared.");
+    }
+    qDebug() << "ModelVariantComparison: Compared" << report.imageCount << "images. Precision" << report.precision()
+             << "Recall" << report.recall() << "Reference" << report.referenceImagesPerSecond() << "img/s"
+             << "Candidate" << report.candidateImagesPerSecond() << "img/s";
+    return report;
+}
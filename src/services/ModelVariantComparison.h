@@ -0,0 +1,67 @@
+#ifndef MODELVARIANTCOMPARISON_H
+#define MODELVARIANTCOMPARISON_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVariantMap>
+#include <QVector>
+#include <atomic>
+
+// How often one tag was produced by each model over the sample
+struct TagAgreement {
+    QString tag;
+    int referenceCount = 0; // Images where the reference (fp32) model emitted the tag
+    int candidateCount = 0; // Images where the candidate (e.g. int8) model emitted it
+    int bothCount = 0;      // Images where both did
+
+    double precision() const { return candidateCount > 0 ? double(bothCount) / candidateCount : 1.0; }
+    double recall() const { return referenceCount > 0 ? double(bothCount) / referenceCount : 1.0; }
+    int disagreements() const { return referenceCount + candidateCount - 2 * bothCount; }
+};
+
+struct ModelComparisonReport {
+    bool success = false;
+    bool cancelled = false;
+    QString errorMessage;
+    int imageCount = 0;
+    double referenceSeconds = 0.0; // Inference time only, after one warm-up batch
+    double candidateSeconds = 0.0;
+    int truePositives = 0;  // Tags both models emitted (reference output taken as ground truth)
+    int falsePositives = 0; // Emitted only by the candidate
+    int falseNegatives = 0; // Emitted only by the reference
+    QVector<TagAgreement> tags; // Most disagreements first
+
+    double precision() const { return truePositives + falsePositives > 0 ? double(truePositives) / (truePositives + falsePositives) : 1.0; }
+    double recall() const { return truePositives + falseNegatives > 0 ? double(truePositives) / (truePositives + falseNegatives) : 1.0; }
+    double referenceImagesPerSecond() const { return referenceSeconds > 0.0 ? imageCount / referenceSeconds : 0.0; }
+    double candidateImagesPerSecond() const { return candidateSeconds > 0.0 ? imageCount / candidateSeconds : 0.0; }
+};
+
+// Runs two variants of the tagger over the same images with the same thresholds and measures
+// how far the candidate's tags drift from the reference's, and how much faster it is.
+class ModelVariantComparison : public QObject
+{
+    Q_OBJECT
+
+public:
+    ModelVariantComparison(const QString &referenceModelPath, const QString &candidateModelPath,
+                           const QString &tagsCsvPath, const QStringList &imagePaths,
+                           const QVariantMap &settings, QObject *parent = nullptr);
+
+    ModelComparisonReport run(); // Blocking, call from a worker thread
+    void cancel();
+
+signals:
+    void progress(int processed, int total); // Emitted from the worker thread
+
+private:
+    QString m_referenceModelPath;
+    QString m_candidateModelPath;
+    QString m_tagsCsvPath;
+    QStringList m_imagePaths;
+    QVariantMap m_settings;
+    std::atomic<bool> m_cancelled;
+};
+
+#endif // MODELVARIANTCOMPARISON_H
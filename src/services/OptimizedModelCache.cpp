@@ -0,0 +1,106 @@
+#include "OptimizedModelCache.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QDebug>
+
+static QString shortHash(const QByteArray &data)
+{
+    return QString::fromLatin1(QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex().left(16));
+}
+
+QString OptimizedModelCache::cacheDirectory()
+{
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("optimized_models");
+}
+
+QString OptimizedModelCache::modelContentHash(const QString &modelPath)
+{
+    // Hashing a few hundred MB on every launch would eat most of what the cache saves, so the
+    // digest is remembered per file and only recomputed when its size or mtime changes.
+    QFileInfo modelInfo(modelPath);
+    const QString stamp = QString("%1:%2").arg(modelInfo.size()).arg(modelInfo.lastModified().toMSecsSinceEpoch());
+    QSettings settings("KetenganDiffusion", "HaigakuManager");
+    const QString settingsKey = "optimized_model_cache/" + shortHash(modelInfo.absoluteFilePath().toUtf8());
+    const QStringList remembered = settings.value(settingsKey).toString().split('|');
+    if (remembered.size() == 2 && remembered.at(0) == stamp) {
+        return remembered.at(1);
+    }
+
+    QFile modelFile(modelPath);
+    if (!modelFile.open(QIODevice::ReadOnly)) {
+        qWarning() << "OptimizedModelCache: Cannot read model for hashing:" << modelPath;
+        return QString();
+    }
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    if (!hash.addData(&modelFile)) {
+        qWarning() << "OptimizedModelCache: Failed hashing model:" << modelPath;
+        return QString();
+    }
+    const QString digest = QString::fromLatin1(hash.result().toHex());
+    settings.setValue(settingsKey, stamp + "|" + digest);
+    return digest;
+}
+
+QString OptimizedModelCache::cachePathFor(const QString &modelPath, const QString &optionsKey)
+{
+    const QString contentHash = modelContentHash(modelPath);
+    if (contentHash.isEmpty()) {
+        return QString();
+    }
+    QDir cacheDir(cacheDirectory());
+    if (!cacheDir.exists() && !cacheDir.mkpath(".")) {
+        qWarning() << "OptimizedModelCache: Cannot create cache directory:" << cacheDir.path();
+        return QString();
+    }
+    // <model path hash>-<content hash>-<options hash>.onnx: the first part groups all entries of one
+    // model file, the second tells which version of it an entry was optimized from
+    const QString modelPrefix = shortHash(QFileInfo(modelPath).absoluteFilePath().toUtf8());
+    return cacheDir.filePath(modelPrefix + "-" + contentHash.left(16) + "-" + shortHash(optionsKey.toUtf8()) + ".onnx");
+}
+
+QString OptimizedModelCache::temporaryPathFor(const QString &cachePath)
+{
+    return cachePath + ".tmp";
+}
+
+bool OptimizedModelCache::commit(const QString &temporaryPath, const QString &cachePath)
+{
+    if (!QFile::exists(temporaryPath)) {
+        qWarning() << "OptimizedModelCache: ORT did not write an optimized model to" << temporaryPath;
+        return false;
+    }
+    QFile::remove(cachePath);
+    if (!QFile::rename(temporaryPath, cachePath)) {
+        qWarning() << "OptimizedModelCache: Could not move" << temporaryPath << "to" << cachePath;
+        QFile::remove(temporaryPath);
+        return false;
+    }
+
+    // Entries optimized from older versions of this model file are stale now; those for other
+    // options (device, optimization level) stay, so switching back doesn't re-optimize
+    QFileInfo cacheInfo(cachePath);
+    const QString modelPrefix = cacheInfo.fileName().section('-', 0, 0);
+    const QString contentPrefix = modelPrefix + "-" + cacheInfo.fileName().section('-', 1, 1) + "-";
+    QDir cacheDir = cacheInfo.absoluteDir();
+    const QStringList siblings = cacheDir.entryList({modelPrefix + "-*.onnx"}, QDir::Files);
+    for (const QString &sibling : siblings) {
+        if (!sibling.startsWith(contentPrefix)) {
+            qDebug() << "OptimizedModelCache: Removing stale entry" << sibling;
+            cacheDir.remove(sibling);
+        }
+    }
+    qDebug() << "OptimizedModelCache: Stored optimized model" << cachePath;
+    return true;
+}
+
+void OptimizedModelCache::invalidate(const QString &cachePath)
+{
+    qWarning() << "OptimizedModelCache: Dropping unusable entry" << cachePath;
+    QFile::remove(cachePath);
+    QFile::remove(temporaryPathFor(cachePath));
+}
@@ -0,0 +1,26 @@
+#ifndef OPTIMIZEDMODELCACHE_H
+#define OPTIMIZEDMODELCACHE_H
+
+#include <QString>
+
+// On-disk cache of ONNX graphs that ORT has already optimized, so later loads skip the
+// parse + optimize pass. Entries live in the user cache directory and are keyed by the
+// model's content hash plus whatever options change the optimized graph.
+class OptimizedModelCache
+{
+public:
+    // Where the optimized graph for this model/options pair lives (the file may not exist yet)
+    static QString cachePathFor(const QString &modelPath, const QString &optionsKey);
+    // ORT writes here first; commit() moves it into place once the session was created
+    static QString temporaryPathFor(const QString &cachePath);
+    // Publishes a freshly written entry and drops entries built from older contents of the same model file
+    static bool commit(const QString &temporaryPath, const QString &cachePath);
+    // Removes an entry that failed to load (e.g. written by a different ORT build)
+    static void invalidate(const QString &cachePath);
+
+private:
+    static QString cacheDirectory();
+    static QString modelContentHash(const QString &modelPath);
+};
+
+#endif // OPTIMIZEDMODELCACHE_H
@@ -0,0 +1,162 @@
+#include "PreviewLoader.h"
+#include "utils/ScaledImageReader.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QBuffer>
+#include <QDebug>
+
+PreviewLoader::PreviewLoader(QObject *parent)
+    : QObject(parent)
+    , m_prefetchAhead(3)
+    , m_prefetchBehind(1)
+    , m_generation(0)
+    , m_currentIndex(-1)
+    , m_windowStart(0)
+    , m_windowEnd(-1)
+{
+    m_threadPool.setMaxThreadCount(2); // Current image plus one prefetch; more only fights the thumbnail decoders for I/O
+}
+
+PreviewLoader::~PreviewLoader()
+{
+    m_windowEnd = -1; // Anything still queued skips itself
+    m_threadPool.clear();
+    m_threadPool.waitForDone();
+}
+
+void PreviewLoader::setFiles(const QStringList &filePaths)
+{
+    m_filePaths = filePaths;
+    m_cache.clear();
+    m_inFlight.clear();
+    ++m_generation;
+    m_currentIndex = -1;
+    m_windowStart = 0;
+    m_windowEnd = -1;
+    m_threadPool.clear();
+}
+
+void PreviewLoader::appendFiles(const QStringList &filePaths)
+{
+    m_filePaths.append(filePaths);
+}
+
+void PreviewLoader::setPrefetchDepth(int ahead, int behind)
+{
+    m_prefetchAhead = qMax(0, ahead);
+    m_prefetchBehind = qMax(0, behind);
+}
+
+bool PreviewLoader::isPreviewable(const QString &filePath)
+{
+    static const QStringList imageExtensions = {"jpg", "jpeg", "png", "bmp", "gif", "webp", "tiff"};
+    return imageExtensions.contains(QFileInfo(filePath).suffix().toLower());
+}
+
+bool PreviewLoader::isInWindow(int index) const
+{
+    return index >= m_windowStart.load() && index <= m_windowEnd.load();
+}
+
+void PreviewLoader::request(int index, const QSize &viewportSize, int direction)
+{
+    if (index < 0 || index >= m_filePaths.size()) {
+        return;
+    }
+    if (viewportSize != m_viewportSize) {
+        m_viewportSize = viewportSize;
+        m_cache.clear(); // Decoded for a different size
+    }
+
+    // Look further ahead in the direction of travel; without one, prefetch the full depth both ways
+    const int travel = direction < 0 ? -1 : 1;
+    const int ahead = m_prefetchAhead;
+    const int behind = direction == 0 ? m_prefetchAhead : m_prefetchBehind;
+    const int lowerExtent = travel > 0 ? behind : ahead;
+    const int upperExtent = travel > 0 ? ahead : behind;
+    m_currentIndex = index;
+    m_windowStart = qMax(0, index - lowerExtent);
+    m_windowEnd = qMin(int(m_filePaths.size()) - 1, index + upperExtent);
+    evictOutsideWindow();
+
+    auto cached = m_cache.constFind(index);
+    if (cached != m_cache.constEnd()) {
+        emit previewReady(index, cached.value());
+    } else {
+        schedule(index, 10);
+    }
+
+    // Nearest first; QThreadPool runs higher priorities first among what is still queued
+    for (int distance = 1; distance <= qMax(ahead, behind); ++distance) {
+        if (distance <= ahead) schedule(index + travel * distance, qMax(1, 5 - distance));
+        if (distance <= behind) schedule(index - travel * distance, 0);
+    }
+}
+
+void PreviewLoader::schedule(int index, int priority)
+{
+    if (!isInWindow(index) || m_cache.contains(index) || m_inFlight.contains(index)
+        || !isPreviewable(m_filePaths.at(index))) {
+        return;
+    }
+    m_inFlight.insert(index);
+    const QString filePath = m_filePaths.at(index);
+    const QSize viewportSize = m_viewportSize;
+    const quint64 generation = m_generation;
+    m_threadPool.start([this, index, filePath, viewportSize, generation]() {
+        const bool skipped = !isInWindow(index); // The user has moved on since this was queued
+        const PreviewImage preview = skipped ? PreviewImage() : decode(filePath, viewportSize);
+        QMetaObject::invokeMethod(this, [this, index, preview, skipped, generation]() {
+            if (generation == m_generation) {
+                handleDecoded(index, preview, skipped);
+            }
+        }, Qt::QueuedConnection);
+    }, priority);
+}
+
+PreviewImage PreviewLoader::decode(const QString &filePath, const QSize &viewportSize)
+{
+    PreviewImage preview;
+    preview.filePath = filePath;
+    preview.boundingSize = viewportSize;
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        preview.error = file.errorString();
+        return preview;
+    }
+    QByteArray data = file.readAll(); // The only read of this file; header, pixels and size come from here
+    file.close();
+    preview.fileSize = data.size();
+
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::ReadOnly);
+    preview.image = ScaledImageReader::read(&buffer, viewportSize, &preview.error, &preview.sourceSize);
+    return preview;
+}
+
+void PreviewLoader::handleDecoded(int index, const PreviewImage &preview, bool skipped)
+{
+    m_inFlight.remove(index);
+    if (skipped || !isInWindow(index) || preview.boundingSize != m_viewportSize) {
+        if (index == m_currentIndex.load()) {
+            schedule(index, 10); // Requested again while this decode ran, when schedule() had to refuse it
+        }
+        return;
+    }
+    m_cache.insert(index, preview);
+    if (index == m_currentIndex.load()) {
+        emit previewReady(index, preview);
+    }
+}
+
+void PreviewLoader::evictOutsideWindow()
+{
+    for (auto it = m_cache.begin(); it != m_cache.end();) {
+        if (isInWindow(it.key())) {
+            ++it;
+        } else {
+            it = m_cache.erase(it);
+        }
+    }
+}
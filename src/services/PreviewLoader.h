@@ -0,0 +1,72 @@
+#ifndef PREVIEWLOADER_H
+#define PREVIEWLOADER_H
+
+#include <QObject>
+#include <QImage>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QSet>
+#include <QThreadPool>
+#include <atomic>
+
+// One decoded main-view image plus the metadata read alongside it
+struct PreviewImage {
+    QString filePath;
+    QImage image;        // Fitted to the viewport size it was requested for, null on error
+    QSize boundingSize;  // Viewport size it was decoded for
+    QSize sourceSize;    // Full resolution, EXIF rotation applied
+    qint64 fileSize = 0;
+    QString error;
+};
+
+// Decodes main-view images off the GUI thread into a small cache keyed by file index, and
+// prefetches the neighbours in the direction of navigation so holding an arrow key finds the
+// next image already decoded. Each file is read once into memory; the dimensions, byte size and
+// fitted image all come from that buffer. Requests that fall outside the window around the current
+// index by the time a pool thread picks them up are skipped, so rapid skipping doesn't queue decodes.
+class PreviewLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PreviewLoader(QObject *parent = nullptr);
+    ~PreviewLoader();
+
+    void setFiles(const QStringList &filePaths); // Drops the cache
+    void appendFiles(const QStringList &filePaths); // Existing indices stay valid, cache kept
+    void setPrefetchDepth(int ahead, int behind);
+
+    // Makes index the current image. Emits previewReady right away on a cache hit, otherwise
+    // once decoded. direction is the navigation direction (-1, 0, 1) used for prefetching.
+    void request(int index, const QSize &viewportSize, int direction);
+
+    static bool isPreviewable(const QString &filePath);
+
+signals:
+    void previewReady(int index, const PreviewImage &preview); // Only for the current index
+
+private:
+    void handleDecoded(int index, const PreviewImage &preview, bool skipped);
+    void schedule(int index, int priority);
+    bool isInWindow(int index) const; // Against the atomics, safe from pool threads
+    void evictOutsideWindow();
+    static PreviewImage decode(const QString &filePath, const QSize &viewportSize);
+
+    QStringList m_filePaths;
+    QHash<int, PreviewImage> m_cache; // Ring around the current index, at most ahead + behind + 1 entries
+    QSet<int> m_inFlight;
+    QSize m_viewportSize;
+    int m_prefetchAhead;
+    int m_prefetchBehind;
+    quint64 m_generation; // Bumped by setFiles so late results from the previous folder are dropped
+
+    std::atomic<int> m_currentIndex;
+    std::atomic<int> m_windowStart;
+    std::atomic<int> m_windowEnd;
+
+    QThreadPool m_threadPool;
+};
+
+#endif // PREVIEWLOADER_H
@@ -0,0 +1,176 @@
+#include "StatisticsEngine.h"
+#include "DatasetIndex.h"
+#include "models/TagDictionary.h"
+#include <QtConcurrent/QtConcurrent>
+#include <QDebug>
+
+namespace {
+const int ChunkSize = 256; // Small enough for smooth progress and quick cancellation, large enough to keep merges rare
+}
+
+// Implementation of DatasetStatistics::toString()
+QString DatasetStatistics::toString() const {
+    QString result;
+    result += QString("Total Media Size: %1 MB\n").arg(totalMediaSize / (1024.0 * 1024.0), 0, 'f', 2);
+    result += QString("Captioned Media Count: %1\n").arg(captionedMediaCount);
+    result += QString("Image Count: %1\n").arg(imageCount);
+    result += QString("Video Count: %1\n").arg(videoCount);
+    result += QString("Unpaired Caption Files: %1\n").arg(unpairedCaptionCount);
+    result += QString("Max Pixels (W*H): %1\n").arg(maxPixels);
+    result += QString("Average Pixels (W*H): %1\n").arg(averagePixels, 0, 'f', 0);
+    if (minCaptionLengthWords != -1) {
+        result += QString("Min Caption Length (words): %1\n").arg(minCaptionLengthWords);
+    } else {
+        result += QString("Min Caption Length (words): N/A\n");
+    }
+    result += QString("Max Caption Length (words): %1\n").arg(maxCaptionLengthWords);
+    result += QString("Average Caption Length (words): %1\n").arg(averageCaptionLengthWords, 0, 'f', 2);
+    result += QString("Total Files Processed: %1\n").arg(totalFilesProcessed);
+    return result;
+}
+
+StatisticsEngine::StatisticsEngine(QObject *parent)
+    : QObject(parent)
+    , m_index(nullptr)
+    , m_totalFiles(0)
+{
+    connect(&m_watcher, &QFutureWatcher<Accumulator>::progressValueChanged, this, [this](int chunksDone) {
+        emit progress(qMin(m_totalFiles, chunksDone * ChunkSize), m_totalFiles);
+    });
+    connect(&m_watcher, &QFutureWatcher<Accumulator>::finished, this, &StatisticsEngine::onFinished);
+}
+
+StatisticsEngine::~StatisticsEngine()
+{
+    cancel();
+    m_watcher.waitForFinished();
+}
+
+void StatisticsEngine::start(const QStringList &mediaFiles, DatasetIndex *datasetIndex)
+{
+    cancel();
+    m_watcher.waitForFinished();
+    if (!datasetIndex) {
+        if (!m_localIndex) m_localIndex = std::make_unique<DatasetIndex>();
+        datasetIndex = m_localIndex.get();
+    }
+    m_index = datasetIndex;
+    m_totalFiles = mediaFiles.size();
+
+    QList<QStringList> chunks;
+    chunks.reserve(mediaFiles.size() / ChunkSize + 1);
+    for (int i = 0; i < mediaFiles.size(); i += ChunkSize) {
+        chunks.append(mediaFiles.mid(i, ChunkSize));
+    }
+    DatasetIndex *index = m_index;
+    m_watcher.setFuture(QtConcurrent::mappedReduced<Accumulator>(
+        chunks,
+        [index](const QStringList &chunk) { return accumulateChunk(index, chunk); },
+        &StatisticsEngine::merge,
+        QtConcurrent::UnorderedReduce));
+}
+
+void StatisticsEngine::cancel()
+{
+    if (m_watcher.isRunning()) {
+        m_watcher.cancel(); // Chunks already started finish; the rest are skipped
+    }
+}
+
+StatisticsEngine::Accumulator StatisticsEngine::accumulateChunk(DatasetIndex *index, const QStringList &filePaths)
+{
+    Accumulator acc;
+    const TagDictionary &dictionary = TagDictionary::instance();
+    for (const QString &filePath : filePaths) {
+        // Only files whose size/mtime (or caption mtime) changed since the last run are actually read
+        const DatasetIndexEntry entry = index->refresh(filePath);
+        ++acc.files;
+        if (entry.fileSize < 0) {
+            continue; // Deleted since the listing
+        }
+        acc.totalMediaSize += entry.fileSize;
+
+        if (entry.mediaType == DatasetIndexEntry::ImageMedia) {
+            acc.imageCount++;
+            if (entry.dimensions.isValid()) {
+                const long long pixels = static_cast<long long>(entry.dimensions.width()) * entry.dimensions.height();
+                acc.totalPixelSum += pixels;
+                acc.mediaWithPixelsCount++;
+                acc.maxPixels = qMax(acc.maxPixels, pixels);
+            }
+        } else if (entry.mediaType == DatasetIndexEntry::VideoMedia) {
+            acc.videoCount++; // Video resolution would need a decoder, not part of the statistics
+        }
+
+        if (entry.captionKind != DatasetIndexEntry::NoCaption) {
+            acc.captionedMediaCount++;
+            const int wordCount = entry.tagIds.size(); // Each comma-separated item is a "word" or "tag" for this purpose
+            for (quint32 tagId : entry.tagIds) {
+                acc.tagIdFrequencies[dictionary.foldedId(tagId)]++; // "Long_Hair" and "long hair" count as one tag
+            }
+            if (wordCount > 0) {
+                acc.totalCaptionWords += wordCount;
+                acc.captionsWithWordsCount++;
+                acc.maxCaptionLengthWords = qMax(acc.maxCaptionLengthWords, wordCount);
+                if (acc.minCaptionLengthWords == -1 || wordCount < acc.minCaptionLengthWords) {
+                    acc.minCaptionLengthWords = wordCount;
+                }
+            }
+        }
+    }
+    return acc;
+}
+
+void StatisticsEngine::merge(Accumulator &total, const Accumulator &chunk)
+{
+    total.files += chunk.files;
+    total.totalMediaSize += chunk.totalMediaSize;
+    total.imageCount += chunk.imageCount;
+    total.videoCount += chunk.videoCount;
+    total.captionedMediaCount += chunk.captionedMediaCount;
+    total.maxPixels = qMax(total.maxPixels, chunk.maxPixels);
+    total.totalPixelSum += chunk.totalPixelSum;
+    total.mediaWithPixelsCount += chunk.mediaWithPixelsCount;
+    total.totalCaptionWords += chunk.totalCaptionWords;
+    total.captionsWithWordsCount += chunk.captionsWithWordsCount;
+    total.maxCaptionLengthWords = qMax(total.maxCaptionLengthWords, chunk.maxCaptionLengthWords);
+    if (chunk.minCaptionLengthWords != -1 && (total.minCaptionLengthWords == -1 || chunk.minCaptionLengthWords < total.minCaptionLengthWords)) {
+        total.minCaptionLengthWords = chunk.minCaptionLengthWords;
+    }
+    for (auto it = chunk.tagIdFrequencies.constBegin(); it != chunk.tagIdFrequencies.constEnd(); ++it) {
+        total.tagIdFrequencies[it.key()] += it.value();
+    }
+}
+
+void StatisticsEngine::onFinished()
+{
+    if (m_watcher.isCanceled()) {
+        qDebug() << "StatisticsEngine: Cancelled";
+        emit cancelled();
+        return;
+    }
+    const Accumulator acc = m_watcher.future().resultCount() > 0 ? m_watcher.result() : Accumulator();
+
+    DatasetStatistics stats;
+    stats.totalFilesProcessed = m_totalFiles;
+    stats.totalMediaSize = acc.totalMediaSize;
+    stats.imageCount = acc.imageCount;
+    stats.videoCount = acc.videoCount;
+    stats.captionedMediaCount = acc.captionedMediaCount;
+    stats.unpairedCaptionCount = m_totalFiles - acc.captionedMediaCount; // Media without a .txt or .caption next to it
+    stats.maxPixels = acc.maxPixels;
+    stats.maxCaptionLengthWords = acc.maxCaptionLengthWords;
+    stats.minCaptionLengthWords = acc.minCaptionLengthWords;
+    if (acc.mediaWithPixelsCount > 0) {
+        stats.averagePixels = static_cast<double>(acc.totalPixelSum) / acc.mediaWithPixelsCount;
+    }
+    if (acc.captionsWithWordsCount > 0) {
+        stats.averageCaptionLengthWords = static_cast<double>(acc.totalCaptionWords) / acc.captionsWithWordsCount;
+    }
+    const TagDictionary &dictionary = TagDictionary::instance();
+    for (auto it = acc.tagIdFrequencies.constBegin(); it != acc.tagIdFrequencies.constEnd(); ++it) {
+        stats.tagFrequencies.insert(dictionary.text(it.key()), it.value()); // Folded ids are distinct strings already
+    }
+    emit progress(m_totalFiles, m_totalFiles);
+    emit finished(stats);
+}
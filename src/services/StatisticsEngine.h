@@ -0,0 +1,80 @@
+#ifndef STATISTICSENGINE_H
+#define STATISTICSENGINE_H
+
+#include <QObject>
+#include <QStringList>
+#include <QMap>
+#include <QHash>
+#include <QFutureWatcher>
+#include <memory>
+
+class DatasetIndex;
+
+// Struct to hold calculated statistics
+struct DatasetStatistics {
+    long long totalMediaSize = 0;
+    int captionedMediaCount = 0;
+    int imageCount = 0;
+    int videoCount = 0;
+    long long maxPixels = 0; // width * height
+    double averagePixels = 0.0;
+    int unpairedCaptionCount = 0;
+    int maxCaptionLengthWords = 0;
+    int minCaptionLengthWords = -1; // -1 indicates not set or no non-empty captions
+    double averageCaptionLengthWords = 0.0;
+    int totalFilesProcessed = 0; 
+    QMap<QString, int> tagFrequencies; // Added to hold tag counts
+
+    QString toString() const; 
+};
+
+// Computes DatasetStatistics as a map-reduce over QThreadPool::globalInstance(): files are split
+// into chunks, each chunk is summed into its own accumulator (tag counts keyed by interned tag id),
+// and the accumulators are merged as chunks complete. Entries come from the DatasetIndex, so only
+// files changed since the last run are actually probed. Signals arrive on the engine's thread.
+class StatisticsEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit StatisticsEngine(QObject *parent = nullptr);
+    ~StatisticsEngine(); // Cancels and waits
+
+    // datasetIndex must outlive the run; null uses an in-memory index owned by the engine
+    void start(const QStringList &mediaFiles, DatasetIndex *datasetIndex);
+    void cancel();
+    bool isRunning() const { return m_watcher.isRunning(); }
+
+signals:
+    void progress(int processed, int total);
+    void finished(const DatasetStatistics &stats);
+    void cancelled();
+
+private:
+    struct Accumulator {
+        int files = 0;
+        long long totalMediaSize = 0;
+        int imageCount = 0;
+        int videoCount = 0;
+        int captionedMediaCount = 0;
+        long long maxPixels = 0;
+        long long totalPixelSum = 0;
+        int mediaWithPixelsCount = 0;
+        long long totalCaptionWords = 0;
+        int captionsWithWordsCount = 0;
+        int maxCaptionLengthWords = 0;
+        int minCaptionLengthWords = -1;
+        QHash<quint32, int> tagIdFrequencies; // By folded TagDictionary id; names resolved once per tag at the end
+    };
+
+    static Accumulator accumulateChunk(DatasetIndex *index, const QStringList &filePaths);
+    static void merge(Accumulator &total, const Accumulator &chunk);
+    void onFinished();
+
+    QFutureWatcher<Accumulator> m_watcher;
+    DatasetIndex *m_index;
+    std::unique_ptr<DatasetIndex> m_localIndex;
+    int m_totalFiles;
+};
+
+#endif // STATISTICSENGINE_H
@@ -0,0 +1,244 @@
+#include "TagScoreCache.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QDebug>
+#include <QPair>
+#include <QSet>
+#include <QStringList>
+#include <utility>
+
+namespace {
+const char IndexMagic[4] = {'H', 'G', 'T', 'S'};
+const quint32 IndexVersion = 4; // 2: shared PackIndexStore record layout, 3: float32 scores instead of 8-bit, 4: path hashes
+const qint64 MaxCacheBytes = qint64(256) << 20; // All models together; the least recently opened go first
+
+QString rootDirectory()
+{
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("tag_scores");
+}
+static_assert(sizeof(TagScoreCache::ScoredTag) == 8, "Score rows are written as-is");
+} // namespace
+
+TagScoreCache::TagScoreCache()
+    : m_store(IndexMagic, IndexVersion)
+{
+}
+
+TagScoreCache::~TagScoreCache()
+{
+    close();
+}
+
+std::shared_ptr<TagScoreCache> TagScoreCache::forModel(const QString &modelId)
+{
+    static QMutex registryMutex;
+    static QHash<QString, std::weak_ptr<TagScoreCache>> registry;
+    QMutexLocker locker(&registryMutex);
+    std::shared_ptr<TagScoreCache> cache = registry.value(modelId).lock();
+    if (!cache) {
+        cache = std::make_shared<TagScoreCache>();
+        cache->open(modelId); // Runs without the cache if it cannot be opened
+        registry.insert(modelId, cache);
+
+        QStringList openDirectories; // Never pruned from under a live cache
+        for (auto it = registry.constBegin(); it != registry.constEnd(); ++it) {
+            if (!it.value().expired()) {
+                openDirectories.append(QDir(rootDirectory()).absoluteFilePath(it.key()));
+            }
+        }
+        PackIndexStore::prune(rootDirectory(), MaxCacheBytes, openDirectories);
+    }
+    return cache;
+}
+
+quint64 TagScoreCache::fileKeyFor(const QString &filePath)
+{
+    QFileInfo fileInfo(filePath);
+    if (!fileInfo.exists()) {
+        return 0;
+    }
+    const QByteArray keyData = fileInfo.absoluteFilePath().toUtf8() + '|'
+        + QByteArray::number(fileInfo.lastModified().toMSecsSinceEpoch()) + '|'
+        + QByteArray::number(fileInfo.size());
+    return PackIndexStore::fnv1a64(keyData);
+}
+
+quint32 TagScoreCache::pathHashFor(const QString &filePath)
+{
+    return quint32(PackIndexStore::fnv1a64(QFileInfo(filePath).absoluteFilePath().toUtf8()));
+}
+
+quint64 TagScoreCache::contentKey(const QByteArray &fileData)
+{
+    if (fileData.isEmpty()) {
+        return 0;
+    }
+    const quint64 key = PackIndexStore::fnv1a64(fileData);
+    return key ^ quint64(fileData.size()); // 0 stays reserved for "no key"
+}
+
+TagScoreCache::Scores TagScoreCache::fromModelOutput(const float *scores, size_t scoreCount)
+{
+    Scores kept;
+    for (size_t i = 0; i < scoreCount; ++i) {
+        if (scores[i] < MinStoredScore) {
+            continue; // Most of the ~10k tags score near zero, only the plausible ones are kept
+        }
+        kept.push_back({quint32(i), scores[i]});
+    }
+    return kept;
+}
+
+bool TagScoreCache::open(const QString &modelId)
+{
+    QMutexLocker locker(&m_mutex);
+    m_store.close();
+    m_byFileKey.clear();
+    m_byContentKey.clear();
+
+    if (modelId.isEmpty()) {
+        return false;
+    }
+    m_cacheDirectory = QDir(rootDirectory()).absoluteFilePath(modelId);
+    if (!QDir().mkpath(m_cacheDirectory)) {
+        qWarning() << "TagScoreCache: Cannot create" << m_cacheDirectory;
+        return false;
+    }
+    // Only the newest file key of each path stays live (older ones are of an earlier version of the
+    // file), and only the content keys whose row such a file key still uses
+    QHash<quint32, PackIndexStore::Record> newestByPath;
+    QHash<quint64, PackIndexStore::Record> newestByContent;
+    const QDir cacheDir(m_cacheDirectory);
+    const bool opened = m_store.open(cacheDir.filePath("scores.pack"), cacheDir.filePath("scores.idx"),
+                                     [&](const PackIndexStore::Record &record) {
+                                         if (record.key != 0) {
+                                             newestByPath.insert(record.tag, record); // Later records win
+                                         }
+                                         if (record.secondaryKey != 0) {
+                                             newestByContent.insert(record.secondaryKey, record);
+                                         }
+                                     });
+    if (!opened) {
+        qWarning() << "TagScoreCache: Cannot open cache files in" << m_cacheDirectory;
+        return false;
+    }
+
+    // Each live key gets a record of its own; rows shared by several keys are still stored once
+    QVector<PackIndexStore::Record> liveRecords;
+    QSet<QPair<quint64, quint32>> liveRows;
+    for (PackIndexStore::Record record : std::as_const(newestByPath)) {
+        record.secondaryKey = 0;
+        liveRecords.append(record);
+        liveRows.insert(qMakePair(record.offset, record.length));
+    }
+    for (PackIndexStore::Record record : std::as_const(newestByContent)) {
+        if (liveRows.contains(qMakePair(record.offset, record.length))) {
+            record.key = 0;
+            record.tag = 0;
+            liveRecords.append(record);
+        }
+    }
+    if (m_store.compactIfSparse(&liveRecords)) {
+        qDebug() << "TagScoreCache: Compacted" << m_cacheDirectory;
+    }
+    for (const PackIndexStore::Record &record : liveRecords) {
+        if (record.key != 0) {
+            m_byFileKey.insert(record.key, record);
+        } else {
+            m_byContentKey.insert(record.secondaryKey, record);
+        }
+    }
+    PackIndexStore::markOpened(m_cacheDirectory);
+    qDebug() << "TagScoreCache: Opened" << m_cacheDirectory << "with" << m_byContentKey.size() << "images";
+    return true;
+}
+
+void TagScoreCache::close()
+{
+    QMutexLocker locker(&m_mutex);
+    m_store.close();
+    m_byFileKey.clear();
+    m_byContentKey.clear();
+}
+
+bool TagScoreCache::isOpen() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_store.isOpen();
+}
+
+int TagScoreCache::entryCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_byContentKey.size();
+}
+
+bool TagScoreCache::readScores(const PackIndexStore::Record &record, Scores *scores)
+{
+    scores->resize(record.length / sizeof(ScoredTag)); // Empty when nothing scored above MinStoredScore
+    return m_store.read(record, scores->data());
+}
+
+bool TagScoreCache::lookup(const QString &filePath, Scores *scores)
+{
+    const quint64 fileKey = fileKeyFor(filePath); // stat() outside the lock
+    if (fileKey == 0 || !scores) {
+        return false;
+    }
+    QMutexLocker locker(&m_mutex);
+    auto it = m_byFileKey.constFind(fileKey);
+    return it != m_byFileKey.constEnd() && m_store.isOpen() && readScores(*it, scores);
+}
+
+bool TagScoreCache::lookupContent(const QString &filePath, quint64 contentKey, Scores *scores)
+{
+    if (contentKey == 0 || !scores) {
+        return false;
+    }
+    const quint64 fileKey = fileKeyFor(filePath);
+    QMutexLocker locker(&m_mutex);
+    auto it = m_byContentKey.constFind(contentKey);
+    if (it == m_byContentKey.constEnd() || !m_store.isOpen() || !readScores(*it, scores)) {
+        return false;
+    }
+    if (fileKey != 0 && !m_byFileKey.contains(fileKey)) { // Renamed or copied; alias the existing row
+        PackIndexStore::Record alias = *it;
+        alias.key = fileKey;
+        alias.secondaryKey = 0;
+        alias.tag = pathHashFor(filePath);
+        if (m_store.appendRecord(alias)) {
+            m_byFileKey.insert(fileKey, alias);
+        }
+    }
+    return true;
+}
+
+void TagScoreCache::store(const QString &filePath, quint64 contentKey, const Scores &scores)
+{
+    const quint64 fileKey = fileKeyFor(filePath);
+    if (fileKey == 0 && contentKey == 0) {
+        return;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    if (!m_store.isOpen()) {
+        return;
+    }
+    PackIndexStore::Record record;
+    record.key = fileKey;
+    record.secondaryKey = contentKey;
+    record.tag = pathHashFor(filePath);
+    const qint64 byteCount = qint64(scores.size() * sizeof(ScoredTag));
+    if (!m_store.append(reinterpret_cast<const char *>(scores.data()), byteCount, &record)) {
+        qWarning() << "TagScoreCache: Write failed for" << filePath;
+        return;
+    }
+    if (fileKey != 0) {
+        m_byFileKey.insert(fileKey, record);
+    }
+    if (contentKey != 0) {
+        m_byContentKey.insert(contentKey, record);
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef TAGSCORECACHE_H
+#define TAGSCORECACHE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <memory>
+#include <vector>
+#include "utils/PackIndexStore.h"
+
+// Raw tagger scores kept per image, so thresholds, char_tags_first and rating filtering can be
+// re-applied to a whole dataset without running the model again. One cache per model id, under
+// the user cache directory (tag_scores/<model id>/):
+//   scores.pack - per image, every tag that scored at least MinStoredScore as {tagIndex, score}
+//                 pairs in tag index order; scores are the model's float32 outputs, unrounded, so a
+//                 cached result makes the same threshold decisions as fresh inference
+//   scores.idx  - PackIndexStore records {fileKey, contentKey, offset, byte length, path hash}
+// New rows are appended to both files. Open keeps the newest row per path (plus the content keys
+// those rows carry) and compacts the pack once it is mostly dead rows; the caches of all models
+// together are capped, dropping the least recently opened first.
+// Lookups try the file key (path, mtime, size; no read) first and then the content hash, so a
+// renamed or copied image still hits. All methods are thread-safe.
+// Two instances must never append to the same files; share the one from forModel().
+class TagScoreCache
+{
+public:
+    struct ScoredTag {
+        quint32 tagIndex;
+        float score;
+    };
+    typedef std::vector<ScoredTag> Scores;
+
+    static constexpr float MinStoredScore = 0.05f; // Thresholds below this cannot be served from the cache
+
+    TagScoreCache();
+    ~TagScoreCache();
+
+    // The open cache of a model, shared by everything using that model (e.g. the old and the new
+    // pool during a reload). Lives while anyone holds it; a closed cache if it cannot be opened.
+    static std::shared_ptr<TagScoreCache> forModel(const QString &modelId);
+
+    bool open(const QString &modelId);
+    void close();
+    bool isOpen() const;
+    int entryCount() const;
+
+    static quint64 contentKey(const QByteArray &fileData);
+    static Scores fromModelOutput(const float *scores, size_t scoreCount); // Keeps the tags at or above MinStoredScore
+
+    bool lookup(const QString &filePath, Scores *scores); // File key only, never reads the image
+    // Content hash fallback; a hit also records the file key so the next lookup() finds it
+    bool lookupContent(const QString &filePath, quint64 contentKey, Scores *scores);
+    void store(const QString &filePath, quint64 contentKey, const Scores &scores);
+
+private:
+    static quint64 fileKeyFor(const QString &filePath);
+    static quint32 pathHashFor(const QString &filePath); // Kept in the record tag; same for every version of a file
+    bool readScores(const PackIndexStore::Record &record, Scores *scores); // Caller holds m_mutex
+
+    mutable QMutex m_mutex;
+    QString m_cacheDirectory;
+    PackIndexStore m_store;
+    QHash<quint64, PackIndexStore::Record> m_byFileKey;
+    QHash<quint64, PackIndexStore::Record> m_byContentKey;
+};
+
+#endif // TAGSCORECACHE_H
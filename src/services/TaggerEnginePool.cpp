@@ -0,0 +1,197 @@
+#include "TaggerEnginePool.h"
+#include "WdVIT_TaggerEngine.h"
+#include "utils/ThreadBudget.h"
+#include <QDeadlineTimer>
+#include <QDebug>
+
+TaggerEnginePool::Lease::Lease(Lease &&other) noexcept
+    : m_pool(other.m_pool)
+    , m_engine(other.m_engine)
+{
+    other.m_pool = nullptr;
+    other.m_engine = nullptr;
+}
+
+TaggerEnginePool::Lease &TaggerEnginePool::Lease::operator=(Lease &&other) noexcept
+{
+    if (this != &other) {
+        release();
+        m_pool = other.m_pool;
+        m_engine = other.m_engine;
+        other.m_pool = nullptr;
+        other.m_engine = nullptr;
+    }
+    return *this;
+}
+
+void TaggerEnginePool::Lease::release()
+{
+    if (m_pool && m_engine) {
+        m_pool->returnEngine(m_engine);
+    }
+    m_pool = nullptr;
+    m_engine = nullptr;
+}
+
+TaggerEnginePool::TaggerEnginePool()
+    : m_leasedCount(0)
+    , m_accepting(false)
+    , m_scoreCache(std::make_shared<TagScoreCache>()) // Closed until a model is loaded
+{
+}
+
+TaggerEnginePool::~TaggerEnginePool()
+{
+    shutdown();
+}
+
+bool TaggerEnginePool::load(const QString &modelPath, const QString &tagsCsvPath, bool useCpu, bool useDirectML, bool useCuda,
+                            const QVariantMap &sessionSettings)
+{
+    shutdown();
+
+    const int sessionCount = ThreadBudget::resolveInferenceSessions(sessionSettings.value("inference_sessions", 0).toInt());
+    std::vector<std::unique_ptr<WdVIT_TaggerEngine>> engines;
+    for (int i = 0; i < sessionCount; ++i) {
+        QVariantMap settings = sessionSettings;
+        settings["session_index"] = i;
+        settings["session_count"] = sessionCount;
+        auto engine = std::make_unique<WdVIT_TaggerEngine>();
+        if (!engine->loadModel(modelPath, tagsCsvPath, useCpu, useDirectML, useCuda, settings)) {
+            qWarning() << "TaggerEnginePool: Session" << i + 1 << "of" << sessionCount << "failed to load";
+            if (engines.empty()) {
+                return false;
+            }
+            break; // Serve with the sessions that did load, most likely memory ran out
+        }
+        engines.push_back(std::move(engine));
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_engines = std::move(engines);
+    m_freeEngines.clear();
+    for (const auto &engine : m_engines) {
+        m_freeEngines.push_back(engine.get());
+    }
+    m_modelId = m_engines.front()->modelId();
+    m_modelInputSize = m_engines.front()->modelInputSize();
+    m_accepting = true;
+    m_engineReturned.wakeAll();
+    qDebug() << "TaggerEnginePool: Loaded" << m_engines.size() << "sessions of" << modelPath;
+    m_scoreCache = TagScoreCache::forModel(m_modelId);
+    return true;
+}
+
+void TaggerEnginePool::shutdown()
+{
+    std::vector<std::unique_ptr<WdVIT_TaggerEngine>> engines;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_accepting = false;
+        m_engineReturned.wakeAll(); // Waiters in acquire() give up
+        while (m_leasedCount > 0) {
+            m_engineReturned.wait(&m_mutex);
+        }
+        engines.swap(m_engines);
+        m_freeEngines.clear();
+        m_modelId.clear();
+        m_modelInputSize = QSize();
+    }
+    // Sessions are released outside the lock; nobody can reach them any more.
+    // The score cache stays: it is shared with other pools of the model and closes with the last one.
+}
+
+TaggerEnginePool::Lease TaggerEnginePool::acquire()
+{
+    QMutexLocker locker(&m_mutex);
+    while (m_accepting && m_freeEngines.empty()) {
+        m_engineReturned.wait(&m_mutex);
+    }
+    if (!m_accepting) {
+        return Lease();
+    }
+    WdVIT_TaggerEngine *engine = m_freeEngines.back();
+    m_freeEngines.pop_back();
+    ++m_leasedCount;
+    return Lease(this, engine);
+}
+
+TaggerEnginePool::Lease TaggerEnginePool::tryAcquire(int timeoutMs)
+{
+    QDeadlineTimer deadline(timeoutMs);
+    QMutexLocker locker(&m_mutex);
+    while (m_accepting && m_freeEngines.empty()) {
+        if (!m_engineReturned.wait(&m_mutex, deadline)) {
+            return Lease();
+        }
+    }
+    if (!m_accepting) {
+        return Lease();
+    }
+    WdVIT_TaggerEngine *engine = m_freeEngines.back();
+    m_freeEngines.pop_back();
+    ++m_leasedCount;
+    return Lease(this, engine);
+}
+
+TaggingResult TaggerEnginePool::tagsFromScores(const TagScoreCache::Scores &scores, const QVariantMap &settings)
+{
+    WdVIT_TaggerEngine *engine = nullptr;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_accepting || m_engines.empty()) {
+            return TaggingResult();
+        }
+        engine = m_engines.front().get();
+        ++m_leasedCount; // Counted like a lease so shutdown() waits for it, but the engine stays free
+    }
+    TaggingResult result = engine->tagsFromScores(scores, settings);
+    QMutexLocker locker(&m_mutex);
+    --m_leasedCount;
+    m_engineReturned.wakeAll();
+    return result;
+}
+
+bool TaggerEnginePool::cachedScoresCover(const QVariantMap &settings) const
+{
+    QMutexLocker locker(&m_mutex); // Keeps shutdown() from taking the engine away meanwhile
+    return m_accepting && !m_engines.empty() && m_engines.front()->cachedScoresCover(settings);
+}
+
+void TaggerEnginePool::returnEngine(WdVIT_TaggerEngine *engine)
+{
+    QMutexLocker locker(&m_mutex);
+    m_freeEngines.push_back(engine);
+    --m_leasedCount;
+    m_engineReturned.wakeAll(); // Both acquire() and shutdown() wait on this
+}
+
+bool TaggerEnginePool::isLoaded() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_accepting;
+}
+
+int TaggerEnginePool::size() const
+{
+    QMutexLocker locker(&m_mutex);
+    return static_cast<int>(m_engines.size());
+}
+
+QString TaggerEnginePool::modelId() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_modelId;
+}
+
+QSize TaggerEnginePool::modelInputSize() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_modelInputSize;
+}
+
+std::shared_ptr<TagScoreCache> TaggerEnginePool::scoreCache() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_scoreCache;
+}
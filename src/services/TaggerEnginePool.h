@@ -0,0 +1,88 @@
+#ifndef TAGGERENGINEPOOL_H
+#define TAGGERENGINEPOOL_H
+
+#include <QString>
+#include <QSize>
+#include <QVariantMap>
+#include <QMutex>
+#include <QWaitCondition>
+#include <memory>
+#include "TagScoreCache.h"
+#include "models/TaggingResult.h"
+#include <vector>
+
+class WdVIT_TaggerEngine;
+
+// A set of tagger sessions over one model, each used by one caller at a time.
+// acquire() hands out a Lease on a free engine and blocks while all of them are busy, which is the
+// back-pressure for producers. shutdown() stops handing out leases and waits for the outstanding
+// ones to come back, so an engine is never unloaded or destroyed under a running inference
+// (a thread must not call shutdown() or load() while it holds a lease itself).
+// Sessions share prepacked weights and split the inference thread budget ("inference_sessions").
+// A pool is one loaded model: AutoCaptionManager builds a new pool next to the serving one and
+// swaps the shared_ptr, and whoever still holds the old pool finishes on it. Pools of the same
+// model share one score cache (TagScoreCache::forModel). Thread-safe.
+class TaggerEnginePool
+{
+public:
+    // Exclusive use of one engine until destroyed (or release()d). Move-only.
+    class Lease
+    {
+    public:
+        Lease() : m_pool(nullptr), m_engine(nullptr) {}
+        ~Lease() { release(); }
+        Lease(Lease &&other) noexcept;
+        Lease &operator=(Lease &&other) noexcept;
+        Lease(const Lease &) = delete;
+        Lease &operator=(const Lease &) = delete;
+
+        explicit operator bool() const { return m_engine != nullptr; }
+        WdVIT_TaggerEngine *operator->() const { return m_engine; }
+        WdVIT_TaggerEngine *engine() const { return m_engine; }
+        void release();
+
+    private:
+        friend class TaggerEnginePool;
+        Lease(TaggerEnginePool *pool, WdVIT_TaggerEngine *engine) : m_pool(pool), m_engine(engine) {}
+
+        TaggerEnginePool *m_pool;
+        WdVIT_TaggerEngine *m_engine;
+    };
+
+    TaggerEnginePool();
+    ~TaggerEnginePool(); // Shuts down, waiting for outstanding leases
+
+    // Replaces whatever is loaded (waiting for its leases) with sessionCount sessions, 0 = auto.
+    // Sessions are created one after another so the first one fills the optimized model cache.
+    bool load(const QString &modelPath, const QString &tagsCsvPath, bool useCpu, bool useDirectML, bool useCuda,
+              const QVariantMap &sessionSettings);
+    void shutdown();
+
+    Lease acquire();                // Blocks until an engine is free; an empty lease if nothing is loaded
+    Lease tryAcquire(int timeoutMs); // Empty lease on timeout as well
+    // Tags from cached scores. Only reads the vocabulary, so it doesn't wait for a free session;
+    // an empty result if nothing is loaded.
+    TaggingResult tagsFromScores(const TagScoreCache::Scores &scores, const QVariantMap &settings);
+    bool cachedScoresCover(const QVariantMap &settings) const; // See WdVIT_TaggerEngine; false if nothing is loaded
+
+    bool isLoaded() const;
+    int size() const;
+    QString modelId() const;
+    QSize modelInputSize() const;
+    std::shared_ptr<TagScoreCache> scoreCache() const; // The cache for modelId() once loaded; never null
+
+private:
+    void returnEngine(WdVIT_TaggerEngine *engine);
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_engineReturned;
+    std::vector<std::unique_ptr<WdVIT_TaggerEngine>> m_engines;
+    std::vector<WdVIT_TaggerEngine *> m_freeEngines;
+    int m_leasedCount;
+    bool m_accepting; // False while unloaded or shutting down
+    QString m_modelId;
+    QSize m_modelInputSize;
+    std::shared_ptr<TagScoreCache> m_scoreCache;
+};
+
+#endif // TAGGERENGINEPOOL_H
@@ -0,0 +1,200 @@
+#include "ThumbnailDecodePool.h"
+#include <QThread>
+#include <QMutexLocker>
+#include <QDebug>
+#include <algorithm>
+
+ThumbnailDecodePool::ThumbnailDecodePool(ThumbnailDiskCache *diskCache, const std::atomic<quint64> *currentEpoch,
+                                         int threadCount, QObject *parent)
+    : QObject(parent)
+    , m_diskCache(diskCache)
+    , m_currentEpoch(currentEpoch)
+    , m_threadCount(qMax(1, threadCount))
+    , m_nextQueue(0)
+    , m_queuedCount(0)
+    , m_stopping(false)
+    , m_flushScheduled(false)
+{
+    startThreads();
+}
+
+ThumbnailDecodePool::~ThumbnailDecodePool()
+{
+    stopThreads();
+}
+
+void ThumbnailDecodePool::setThreadCount(int count)
+{
+    count = qMax(1, count);
+    if (count == m_threadCount) {
+        return;
+    }
+    stopThreads();
+    const QList<ThumbnailRequest> pending = takeAll();
+    m_threadCount = count;
+    startThreads();
+    submit(pending);
+    qDebug() << "ThumbnailDecodePool: Now running" << m_threadCount << "decode threads";
+}
+
+void ThumbnailDecodePool::startThreads()
+{
+    m_stopping = false;
+    m_queues.clear();
+    for (int i = 0; i < m_threadCount; ++i) {
+        m_queues.push_back(std::make_unique<WorkerQueue>());
+    }
+    for (int i = 0; i < m_threadCount; ++i) {
+        QThread *thread = QThread::create([this, i]() { runWorker(i); });
+        thread->setObjectName(QString("ThumbnailDecode-%1").arg(i));
+        m_threads.append(thread);
+        thread->start();
+    }
+}
+
+void ThumbnailDecodePool::stopThreads()
+{
+    {
+        QMutexLocker locker(&m_idleMutex);
+        m_stopping = true;
+        m_workAvailable.wakeAll();
+    }
+    for (QThread *thread : m_threads) {
+        thread->wait(); // Finishes the request it is on, never starts another
+        delete thread;
+    }
+    m_threads.clear();
+}
+
+void ThumbnailDecodePool::submit(const QList<ThumbnailRequest> &requests)
+{
+    if (requests.isEmpty() || m_queues.empty()) {
+        return;
+    }
+    // Spread consecutive requests over the deques so every thread's front is near the viewport center
+    for (const ThumbnailRequest &request : requests) {
+        WorkerQueue &queue = *m_queues[m_nextQueue];
+        m_nextQueue = (m_nextQueue + 1) % int(m_queues.size());
+        QMutexLocker locker(&queue.mutex);
+        auto position = std::upper_bound(queue.requests.begin(), queue.requests.end(), request.priority,
+                                         [](int priority, const ThumbnailRequest &queued) { return priority < queued.priority; });
+        queue.requests.insert(position, request);
+    }
+    m_queuedCount.fetch_add(int(requests.size()));
+
+    QMutexLocker locker(&m_idleMutex);
+    m_workAvailable.wakeAll();
+}
+
+QList<int> ThumbnailDecodePool::clear()
+{
+    QList<int> rows;
+    for (const ThumbnailRequest &request : takeAll()) {
+        rows.append(request.row);
+    }
+    return rows;
+}
+
+QList<ThumbnailRequest> ThumbnailDecodePool::takeAll()
+{
+    QList<ThumbnailRequest> requests;
+    for (auto &queue : m_queues) {
+        QMutexLocker locker(&queue->mutex);
+        requests.append(QList<ThumbnailRequest>(queue->requests.begin(), queue->requests.end()));
+        m_queuedCount.fetch_sub(int(queue->requests.size()));
+        queue->requests.clear();
+    }
+    std::stable_sort(requests.begin(), requests.end(),
+                     [](const ThumbnailRequest &a, const ThumbnailRequest &b) { return a.priority < b.priority; });
+    return requests;
+}
+
+void ThumbnailDecodePool::runWorker(int index)
+{
+    // Created on this thread so the worker's video extractor belongs to it too
+    ThumbnailWorker worker(m_diskCache, m_currentEpoch);
+    connect(&worker, &ThumbnailWorker::imageReady, this, &ThumbnailDecodePool::collectResult, Qt::DirectConnection);
+    connect(&worker, &ThumbnailWorker::requestCancelled, this, &ThumbnailDecodePool::requestCancelled);
+
+    ThumbnailRequest request;
+    while (waitForRequest(index, &request)) {
+        worker.processRequest(request);
+    }
+}
+
+void ThumbnailDecodePool::collectResult(const ThumbnailResult &result)
+{
+    QMutexLocker locker(&m_resultsMutex);
+    m_results.append(result);
+    if (!m_flushScheduled) {
+        m_flushScheduled = true; // One queued flush per batch instead of one queued signal per image
+        QMetaObject::invokeMethod(this, &ThumbnailDecodePool::flushResults, Qt::QueuedConnection);
+    }
+}
+
+void ThumbnailDecodePool::flushResults()
+{
+    QList<ThumbnailResult> results;
+    {
+        QMutexLocker locker(&m_resultsMutex);
+        results.swap(m_results);
+        m_flushScheduled = false;
+    }
+    if (!results.isEmpty()) {
+        emit thumbnailsReady(results);
+    }
+}
+
+bool ThumbnailDecodePool::waitForRequest(int index, ThumbnailRequest *request)
+{
+    for (;;) {
+        if (m_stopping) {
+            return false;
+        }
+        if (takeRequest(index, request)) {
+            return true;
+        }
+        QMutexLocker locker(&m_idleMutex);
+        if (!m_stopping && m_queuedCount.load() == 0) {
+            m_workAvailable.wait(&m_idleMutex);
+        }
+    }
+}
+
+bool ThumbnailDecodePool::takeRequest(int index, ThumbnailRequest *request)
+{
+    WorkerQueue &own = *m_queues[index];
+    {
+        QMutexLocker locker(&own.mutex);
+        if (!own.requests.empty()) {
+            *request = std::move(own.requests.front());
+            own.requests.pop_front();
+            m_queuedCount.fetch_sub(1);
+            return true;
+        }
+    }
+
+    // Own deque is empty: steal the most urgent request of the fullest other deque
+    WorkerQueue *victim = nullptr;
+    size_t victimSize = 0;
+    for (size_t i = 0; i < m_queues.size(); ++i) {
+        if (int(i) == index) continue;
+        WorkerQueue &queue = *m_queues[i];
+        QMutexLocker locker(&queue.mutex);
+        if (queue.requests.size() > victimSize) {
+            victim = &queue;
+            victimSize = queue.requests.size();
+        }
+    }
+    if (!victim) {
+        return false;
+    }
+    QMutexLocker locker(&victim->mutex);
+    if (victim->requests.empty()) {
+        return false; // Its owner got there first, the caller retries
+    }
+    *request = std::move(victim->requests.front());
+    victim->requests.pop_front();
+    m_queuedCount.fetch_sub(1);
+    return true;
+}
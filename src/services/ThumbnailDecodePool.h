@@ -0,0 +1,77 @@
+#ifndef THUMBNAILDECODEPOOL_H
+#define THUMBNAILDECODEPOOL_H
+
+#include <QObject>
+#include <QList>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <vector>
+#include "ThumbnailWorker.h"
+
+class QThread;
+class ThumbnailDiskCache;
+
+// Fixed set of decode threads, each with its own priority-ordered deque of requests.
+// A thread serves the front of its own deque and, once that is empty, steals the front of the
+// fullest other deque, so threads pull work directly instead of waiting for the GUI thread to
+// hand out one request per round trip. Each thread runs its own ThumbnailWorker, whose signals
+// are forwarded from the pool (queued to receivers on other threads).
+class ThumbnailDecodePool : public QObject
+{
+    Q_OBJECT
+
+public:
+    ThumbnailDecodePool(ThumbnailDiskCache *diskCache, const std::atomic<quint64> *currentEpoch,
+                        int threadCount, QObject *parent = nullptr);
+    ~ThumbnailDecodePool();
+
+    void setThreadCount(int count); // Restarts the threads, queued requests are kept
+    int threadCount() const { return m_threadCount; }
+
+    void submit(const QList<ThumbnailRequest> &requests); // Ordered within each deque by ThumbnailRequest::priority
+    QList<int> clear();                                   // Drops every queued request, returns their rows
+
+signals:
+    // Results finished since the last delivery, emitted on the pool's (GUI) thread. While the GUI
+    // thread is busy, results keep accumulating and arrive together in one call.
+    void thumbnailsReady(const QList<ThumbnailResult> &results);
+    void requestCancelled(int row);
+
+private slots:
+    void flushResults();
+
+private:
+    struct WorkerQueue {
+        QMutex mutex;
+        std::deque<ThumbnailRequest> requests;
+    };
+
+    void startThreads();
+    void stopThreads();
+    void runWorker(int index);
+    bool waitForRequest(int index, ThumbnailRequest *request); // Returns false when the pool is stopping
+    bool takeRequest(int index, ThumbnailRequest *request);
+    QList<ThumbnailRequest> takeAll();
+    void collectResult(const ThumbnailResult &result); // Called on decode threads
+
+    ThumbnailDiskCache *m_diskCache;
+    const std::atomic<quint64> *m_currentEpoch;
+    int m_threadCount;
+    int m_nextQueue; // Round-robin start for submit()
+
+    std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+    QList<QThread*> m_threads;
+    std::atomic<int> m_queuedCount;
+    std::atomic<bool> m_stopping;
+    QMutex m_idleMutex;
+    QWaitCondition m_workAvailable;
+
+    QMutex m_resultsMutex;
+    QList<ThumbnailResult> m_results;
+    bool m_flushScheduled; // Guarded by m_resultsMutex
+};
+
+#endif // THUMBNAILDECODEPOOL_H
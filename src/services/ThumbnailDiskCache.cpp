@@ -0,0 +1,178 @@
+#include "ThumbnailDiskCache.h"
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QStandardPaths>
+#include <QDebug>
+
+namespace {
+const char IndexMagic[4] = {'H', 'G', 'T', 'I'};
+const quint32 IndexVersion = 4; // 2: shared PackIndexStore record layout, 3: drops thumbnails taken from stale EXIF blocks, 4: path keys
+
+const qint64 MaxCacheBytes = qint64(1) << 30; // All datasets together; the least recently opened go first
+
+enum BlobFormat : quint32 { BlobJpeg = 0, BlobPng = 1 };
+} // namespace
+
+ThumbnailDiskCache::ThumbnailDiskCache()
+    : m_store(IndexMagic, IndexVersion)
+{
+}
+
+ThumbnailDiskCache::~ThumbnailDiskCache()
+{
+    close();
+}
+
+quint64 ThumbnailDiskCache::keyFor(const QString &filePath, const QSize &targetSize)
+{
+    QFileInfo fileInfo(filePath);
+    if (!fileInfo.exists()) {
+        return 0;
+    }
+    const QByteArray keyData = fileInfo.absoluteFilePath().toUtf8() + '|'
+        + QByteArray::number(fileInfo.lastModified().toMSecsSinceEpoch()) + '|'
+        + QByteArray::number(fileInfo.size()) + '|'
+        + QByteArray::number(targetSize.width()) + 'x' + QByteArray::number(targetSize.height());
+    return PackIndexStore::fnv1a64(keyData);
+}
+
+quint64 ThumbnailDiskCache::pathKeyFor(const QString &filePath)
+{
+    return PackIndexStore::fnv1a64(QFileInfo(filePath).absoluteFilePath().toUtf8());
+}
+
+bool ThumbnailDiskCache::open(const QString &datasetDirectory)
+{
+    QMutexLocker locker(&m_mutex);
+    m_store.close();
+    m_entries.clear();
+    m_pathKeys.clear();
+
+    const QByteArray datasetHash = QCryptographicHash::hash(QDir(datasetDirectory).absolutePath().toUtf8(), QCryptographicHash::Sha1).toHex().left(16);
+    const QString rootDirectory = QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath("thumbnails");
+    m_cacheDirectory = QDir(rootDirectory).absoluteFilePath(QString::fromLatin1(datasetHash));
+    if (!QDir().mkpath(m_cacheDirectory)) {
+        qWarning() << "ThumbnailDiskCache: Cannot create" << m_cacheDirectory;
+        return false;
+    }
+    // Only the newest thumbnail of each file stays live; older ones are of an earlier version of
+    // the file (the key covers mtime and size) or of another thumbnail size
+    QHash<quint64, PackIndexStore::Record> newestByPath;
+    const QDir cacheDir(m_cacheDirectory);
+    const bool opened = m_store.open(cacheDir.filePath("thumbs.pack"), cacheDir.filePath("thumbs.idx"),
+                                     [&newestByPath](const PackIndexStore::Record &record) {
+                                         newestByPath.insert(record.secondaryKey, record); // Later records win
+                                     });
+    if (!opened) {
+        qWarning() << "ThumbnailDiskCache: Cannot open cache files in" << m_cacheDirectory;
+        return false;
+    }
+
+    QVector<PackIndexStore::Record> liveRecords = newestByPath.values();
+    if (m_store.compactIfSparse(&liveRecords)) {
+        qDebug() << "ThumbnailDiskCache: Compacted" << m_cacheDirectory;
+    }
+    m_entries.reserve(liveRecords.size());
+    m_pathKeys.reserve(liveRecords.size());
+    for (const PackIndexStore::Record &record : liveRecords) {
+        m_entries.insert(record.key, record);
+        m_pathKeys.insert(record.secondaryKey);
+    }
+    PackIndexStore::markOpened(m_cacheDirectory);
+    PackIndexStore::prune(rootDirectory, MaxCacheBytes, QStringList{m_cacheDirectory});
+    qDebug() << "ThumbnailDiskCache: Opened" << m_cacheDirectory << "with" << m_entries.size() << "entries";
+    return true;
+}
+
+void ThumbnailDiskCache::close()
+{
+    QMutexLocker locker(&m_mutex);
+    m_store.close();
+    m_entries.clear();
+    m_pathKeys.clear();
+}
+
+void ThumbnailDiskCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_entries.clear();
+    m_pathKeys.clear();
+    m_store.clear();
+}
+
+int ThumbnailDiskCache::entryCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_entries.size();
+}
+
+bool ThumbnailDiskCache::hasEntryFor(const QString &filePath) const
+{
+    const quint64 pathKey = pathKeyFor(filePath); // String hash only, the file is not touched
+    QMutexLocker locker(&m_mutex);
+    return m_pathKeys.contains(pathKey);
+}
+
+bool ThumbnailDiskCache::lookup(const QString &filePath, const QSize &targetSize, QImage *image)
+{
+    const quint64 key = keyFor(filePath, targetSize); // stat() outside the lock
+    if (key == 0 || !image) {
+        return false;
+    }
+
+    QByteArray blob;
+    quint32 format = BlobJpeg;
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_entries.constFind(key);
+        if (it == m_entries.constEnd() || !m_store.isOpen()) {
+            return false;
+        }
+        blob.resize(qsizetype(it->length));
+        if (!m_store.read(*it, blob.data())) {
+            return false;
+        }
+        format = it->tag;
+    }
+
+    QBuffer buffer(&blob);
+    QImageReader reader(&buffer, format == BlobPng ? "png" : "jpg");
+    *image = reader.read();
+    return !image->isNull();
+}
+
+void ThumbnailDiskCache::store(const QString &filePath, const QSize &targetSize, const QImage &image)
+{
+    const quint64 key = keyFor(filePath, targetSize);
+    if (key == 0 || image.isNull()) {
+        return;
+    }
+
+    // Encode outside the lock; thumbnails are tiny so this is cheap next to the decode that produced them
+    QByteArray blob;
+    QBuffer buffer(&blob);
+    buffer.open(QIODevice::WriteOnly);
+    const quint32 format = image.hasAlphaChannel() ? BlobPng : BlobJpeg;
+    if (!image.save(&buffer, format == BlobPng ? "PNG" : "JPG", format == BlobPng ? -1 : 85)) {
+        return;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    if (!m_store.isOpen()) {
+        return;
+    }
+    PackIndexStore::Record record;
+    record.key = key;
+    record.secondaryKey = pathKeyFor(filePath);
+    record.tag = format;
+    if (!m_store.append(blob.constData(), blob.size(), &record)) {
+        qWarning() << "ThumbnailDiskCache: Write failed for" << filePath;
+        return;
+    }
+    m_entries.insert(key, record);
+    m_pathKeys.insert(record.secondaryKey);
+}
@@ -0,0 +1,50 @@
+#ifndef THUMBNAILDISKCACHE_H
+#define THUMBNAILDISKCACHE_H
+
+#include <QString>
+#include <QSize>
+#include <QImage>
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+#include "utils/PackIndexStore.h"
+
+// Persistent thumbnail store, one per dataset folder, under the user cache directory:
+//   thumbs.pack  - encoded thumbnails (JPEG, or PNG when the image has alpha) appended back to back
+//   thumbs.idx   - PackIndexStore records {key, path key, offset, length, format}
+// The index is read on open to rebuild the lookup table; new entries are appended to both files.
+// Keys hash the absolute path, mtime, file size and target size, so edited files simply miss.
+// Open keeps only the newest entry per file and compacts the pack once it is mostly dead entries;
+// the folders of all datasets together are capped, dropping the least recently opened first.
+// All methods are thread-safe (the loader probes with hasEntryFor() on the GUI thread, decode threads
+// look up and store from theirs).
+class ThumbnailDiskCache
+{
+public:
+    ThumbnailDiskCache();
+    ~ThumbnailDiskCache();
+
+    bool open(const QString &datasetDirectory);
+    void close();
+    void clear(); // Drops every entry for the open dataset
+
+    // In-memory probe by path, no stat() or read: true if some thumbnail of the file is cached, which
+    // may be for an older version or another size. Only for ordering work, lookup() decides.
+    bool hasEntryFor(const QString &filePath) const;
+    bool lookup(const QString &filePath, const QSize &targetSize, QImage *image);
+    void store(const QString &filePath, const QSize &targetSize, const QImage &image);
+
+    int entryCount() const;
+
+private:
+    static quint64 keyFor(const QString &filePath, const QSize &targetSize);
+    static quint64 pathKeyFor(const QString &filePath); // Same for every version and size of a file
+
+    mutable QMutex m_mutex;
+    QString m_cacheDirectory;
+    PackIndexStore m_store;
+    QHash<quint64, PackIndexStore::Record> m_entries;
+    QSet<quint64> m_pathKeys; // Path keys of m_entries
+};
+
+#endif // THUMBNAILDISKCACHE_H
@@ -1,185 +1,178 @@
 #include "ThumbnailLoader.h"
 #include "ThumbnailWorker.h" 
+#include "ThumbnailDecodePool.h"
+#include "utils/ThreadBudget.h"
 #include <QDebug>
-#include <QMutexLocker>
-#include <QCoreApplication> 
-#include <QPainter> // Added for QPainter operations
+#include <QSettings>
+#include <algorithm>
+
+namespace {
+// Cache hits are a few KB read and a tiny decode, so they go ahead of every full decode
+const int CacheHitPriorityBoost = 1 << 24;
+}
 
 ThumbnailLoader::ThumbnailLoader(QObject *parent) 
-    : QObject(parent), m_maxWorkers(QThread::idealThreadCount() / 2)
+    : QObject(parent), m_decodePool(nullptr), m_epoch(1), m_viewportCenterRow(0), m_scrollDirection(0)
+    , m_maxWorkers(ThreadBudget::thumbnailThreads()) // Shares the budget with the tagger's intra-op pool
 {
-    if (m_maxWorkers < 1) m_maxWorkers = 1;
-    if (m_maxWorkers > 4) m_maxWorkers = 4; // Cap at 4 for I/O bound tasks
     qDebug() << "ThumbnailLoader max workers:" << m_maxWorkers;
-
-    connect(this, &ThumbnailLoader::workerAvailable, this, &ThumbnailLoader::dispatchNextRequest, Qt::QueuedConnection);
     startWorkers();
 }
 
 ThumbnailLoader::~ThumbnailLoader()
 {
-    stopWorkers();
+    stopWorkers(); // Before m_diskCache goes away, the decode threads write to it
 }
 
 void ThumbnailLoader::startWorkers() {
-    for (int i = 0; i < m_maxWorkers; ++i) {
-        QThread* thread = new QThread(this); // Parented to ThumbnailLoader for lifecycle
-        ThumbnailWorker* worker = new ThumbnailWorker(); 
-        worker->moveToThread(thread);
-
-        connect(thread, &QThread::finished, worker, &QObject::deleteLater); 
-        // connect(worker, &ThumbnailWorker::thumbnailReady, this, &ThumbnailLoader::thumbnailReady); // Old signal
-        connect(worker, &ThumbnailWorker::imageReady, this, &ThumbnailLoader::handleImageReady, Qt::QueuedConnection); // New signal/slot
-        connect(worker, &ThumbnailWorker::finished, this, &ThumbnailLoader::onWorkerFinished, Qt::QueuedConnection);
-        
-        m_workerThreads.append(thread);
-        m_availableWorkers.append(worker); // Initially all workers are available
-        thread->start();
-    }
+    m_decodePool = new ThumbnailDecodePool(&m_diskCache, &m_epoch, m_maxWorkers, this);
+    connect(m_decodePool, &ThumbnailDecodePool::thumbnailsReady, this, &ThumbnailLoader::handleResults); // Already batched and on our thread
+    connect(m_decodePool, &ThumbnailDecodePool::requestCancelled, this, &ThumbnailLoader::onRequestCancelled, Qt::QueuedConnection);
 }
 
 void ThumbnailLoader::stopWorkers() {
-    m_queueMutex.lock();
-    m_requestQueue.clear();
-    m_pendingOrProcessingRows.clear();
-    m_queueMutex.unlock();
+    delete m_decodePool; // Joins the decode threads
+    m_decodePool = nullptr;
+    m_pendingRows.clear();
+    m_requeueIfCancelled.clear();
+}
 
-    for (QThread* thread : m_workerThreads) {
-        thread->quit(); // Ask thread's event loop to exit
+void ThumbnailLoader::setMaxWorkers(int count)
+{
+    m_maxWorkers = qMax(1, count);
+    if (m_decodePool) {
+        m_decodePool->setThreadCount(m_maxWorkers);
     }
-    for (QThread* thread : m_workerThreads) {
-        if (!thread->wait(1000)) { // Wait up to 1 sec for clean exit
-            qWarning() << "ThumbnailLoader: Worker thread did not exit cleanly, terminating.";
-            thread->terminate(); // Force terminate if not exiting
-            thread->wait();      // Wait for termination
-        }
+}
+
+void ThumbnailLoader::setDatasetDirectory(const QString &directory)
+{
+    m_diskCache.open(directory);
+
+    QSettings settings("KetenganDiffusion", "HaigakuManager");
+    const int overrideCount = settings.value("thumbnailDecodeThreads", 0).toInt(); // 0 = pick from the storage type
+    setMaxWorkers(ThreadBudget::thumbnailThreadsForStorage(directory, overrideCount));
+    qDebug() << "ThumbnailLoader: Dataset" << directory << (ThreadBudget::isRotationalStorage(directory) ? "is on a rotational disk," : "is on solid-state storage,")
+             << "using" << m_maxWorkers << "decode threads";
+}
+
+void ThumbnailLoader::clearDiskCache()
+{
+    m_diskCache.clear();
+}
+
+void ThumbnailLoader::beginEpoch()
+{
+    m_epoch.fetch_add(1, std::memory_order_relaxed);
+    // Whatever a worker already popped comes back through handleResults or onRequestCancelled
+    for (int row : m_decodePool->clear()) {
+        m_pendingRows.remove(row);
     }
-    // Workers are deleted via thread->finished connection
-    m_workerThreads.clear();
-    m_availableWorkers.clear(); 
-    m_busyWorkers.clear();
+    m_requeueIfCancelled.clear();
 }
 
+void ThumbnailLoader::setViewport(int firstVisibleRow, int lastVisibleRow, int scrollDirection)
+{
+    beginEpoch(); // Everything still wanted is re-requested by the caller with the new epoch
+    m_viewportCenterRow = (firstVisibleRow + lastVisibleRow) / 2;
+    m_scrollDirection = qBound(-1, scrollDirection, 1);
+}
 
-void ThumbnailLoader::requestThumbnail(int row, const QString &filePath, const QSize &targetSize)
+int ThumbnailLoader::priorityFor(int row) const
 {
-    QMutexLocker locker(&m_queueMutex);
-    if (m_pendingOrProcessingRows.contains(row)) {
-        // qDebug() << "Request for row" << row << "already pending or processing.";
-        return; 
+    const int offset = row - m_viewportCenterRow;
+    const int distance = qAbs(offset);
+    if (m_scrollDirection != 0 && offset != 0 && (offset > 0) != (m_scrollDirection > 0)) {
+        return distance * 2; // Behind the direction of travel: the user is moving away from these
     }
-    m_requestQueue.enqueue({row, filePath, targetSize});
-    m_pendingOrProcessingRows.insert(row);
-    // qDebug() << "Queued request for row" << row << filePath << "Queue size:" << m_requestQueue.size();
-    locker.unlock(); // Unlock before emitting, though workerAvailable is queued.
-    
-    emit workerAvailable(); // Signal that there might be work to do
+    return distance;
 }
 
-void ThumbnailLoader::requestThumbnailBatch(const QList<ThumbnailRequest> &requests)
+bool ThumbnailLoader::prepareRequest(ThumbnailRequest &request)
 {
-    QMutexLocker locker(&m_queueMutex);
-    bool workAdded = false;
-    for(const auto& req : requests) {
-        if (!m_pendingOrProcessingRows.contains(req.row)) {
-            m_requestQueue.enqueue(req);
-            m_pendingOrProcessingRows.insert(req.row);
-            workAdded = true;
+    const quint64 epoch = m_epoch.load(std::memory_order_relaxed);
+    request.epoch = epoch;
+    request.priority = priorityFor(request.row);
+    auto pending = m_pendingRows.constFind(request.row);
+    if (pending != m_pendingRows.constEnd()) {
+        if (pending.value() < epoch) {
+            // A worker holds an older request for this row; if it drops it as stale, this one replaces it
+            m_requeueIfCancelled.insert(request.row, request);
         }
+        return false;
     }
-    locker.unlock();
-
-    if(workAdded) {
-        // Emit multiple times if multiple workers might be free, or just once.
-        // One signal is enough if dispatchNextRequest handles multiple available workers.
-        emit workerAvailable(); 
+    m_pendingRows.insert(request.row, epoch);
+    if (m_diskCache.hasEntryFor(request.filePath)) { // No stat() here, this runs for every row scrolled into range
+        request.priority -= CacheHitPriorityBoost;
     }
+    return true;
 }
 
-
-void ThumbnailLoader::onWorkerFinished()
+void ThumbnailLoader::requestThumbnail(int row, const QString &filePath, const QSize &targetSize)
 {
-    ThumbnailWorker* worker = qobject_cast<ThumbnailWorker*>(sender());
-    if (worker) {
-        QMutexLocker locker(&m_queueMutex); // Protect access to worker lists
-        m_busyWorkers.removeAll(worker);
-        m_availableWorkers.append(worker);
-        // The row this worker processed is implicitly removed from m_pendingOrProcessingRows
-        // when its thumbnailReady signal is handled by the model, or should be.
-        // Let's ensure it's removed here too if the model doesn't.
-        // However, we don't know which 'row' this worker just finished without more info.
-        // The `thumbnailReady` signal carries the row, so the model should update `m_pendingOrProcessingRows`.
-        // For now, we assume the model or the `thumbnailReady` connection handles removing from `m_pendingOrProcessingRows`.
+    if (m_pendingRows.contains(row)) {
+        // qDebug() << "Request for row" << row << "already pending or processing.";
+        return; 
+    }
+    ThumbnailRequest request{row, filePath, targetSize};
+    if (prepareRequest(request)) {
+        m_decodePool->submit({request});
     }
-    emit workerAvailable(); // Signal that a worker is free
 }
 
-void ThumbnailLoader::dispatchNextRequest()
+void ThumbnailLoader::requestThumbnailBatch(const QList<ThumbnailRequest> &requests)
 {
-    QMutexLocker locker(&m_queueMutex);
-    if (m_requestQueue.isEmpty() || m_availableWorkers.isEmpty()) {
-        return;
+    // Disk cache hits are read and composited on the decode threads too; the GUI thread only probes memory
+    QList<ThumbnailRequest> toSubmit;
+    for (const auto& req : requests) {
+        ThumbnailRequest request = req;
+        if (prepareRequest(request)) {
+            toSubmit.append(request);
+        }
     }
 
-    ThumbnailWorker* worker = m_availableWorkers.takeFirst();
-    m_busyWorkers.append(worker);
-    ThumbnailRequest request = m_requestQueue.dequeue();
-    
-    // m_pendingOrProcessingRows already contains request.row from when it was enqueued.
-    // It will be removed when the model processes thumbnailReady.
-
-    locker.unlock(); // Unlock before invoking method on another thread
-
-    // qDebug() << "Dispatching request for row" << request.row << "to worker. Queue size:" << m_requestQueue.size();
-    // Use QMetaObject::invokeMethod to call processRequest on the worker's thread
-    QMetaObject::invokeMethod(worker, "processRequest", Qt::QueuedConnection,
-                              Q_ARG(ThumbnailRequest, request));
-    
-    // If there are more requests and more workers, try to dispatch again
-    if (!m_requestQueue.isEmpty() && !m_availableWorkers.isEmpty()) {
-        emit workerAvailable();
-    }
+    // Most urgent first, so the round-robin spread puts them at the front of every thread's deque
+    std::stable_sort(toSubmit.begin(), toSubmit.end(),
+                     [](const ThumbnailRequest &a, const ThumbnailRequest &b) { return a.priority < b.priority; });
+    m_decodePool->submit(toSubmit);
 }
 
+void ThumbnailLoader::onRequestCancelled(int row)
+{
+    m_pendingRows.remove(row);
+    if (m_requeueIfCancelled.contains(row)) {
+        ThumbnailRequest request = m_requeueIfCancelled.take(row); // Still visible, schedule it under the current epoch
+        if (prepareRequest(request)) {
+            m_decodePool->submit({request});
+        }
+    }
+}
 
 void ThumbnailLoader::clearQueue()
 {
-    QMutexLocker locker(&m_queueMutex);
-    m_requestQueue.clear();
-    // m_pendingOrProcessingRows should ideally be cleared by individual task cancellations/completions.
-    // For a full clear, we might need to signal workers to stop and clear their current task if possible.
-    // For now, just clear the queue and our tracking set.
-    m_pendingOrProcessingRows.clear(); 
+    beginEpoch(); // Workers drop whatever they haven't started yet
     qDebug() << "ThumbnailLoader queue and pending requests cleared.";
-    // Note: This doesn't stop tasks already running in worker threads.
-    // True cancellation is more complex.
 }
 
-void ThumbnailLoader::handleImageReady(int row, const QImage &scaledImage, const QString &filePath, const QSize &originalTargetSize)
+void ThumbnailLoader::handleResults(const QList<ThumbnailResult> &results)
 {
-    if (scaledImage.isNull()) {
-        qWarning() << "ThumbnailLoader: Received null scaled image for row" << row << filePath;
-        QImage errorPlaceholder(originalTargetSize, QImage::Format_RGB32);
-        errorPlaceholder.fill(Qt::red);
-        emit thumbnailReady(row, QIcon(QPixmap::fromImage(errorPlaceholder)));
-        return;
+    QList<ThumbnailRequest> resubmit;
+    for (const ThumbnailResult &result : results) {
+        m_pendingRows.remove(result.row);
+        auto deferred = m_requeueIfCancelled.find(result.row);
+        if (deferred == m_requeueIfCancelled.end()) {
+            continue;
+        }
+        ThumbnailRequest request = deferred.value();
+        m_requeueIfCancelled.erase(deferred);
+        // Same file: the older request finished anyway and its result is just as good.
+        // Different file (rows were reordered): the result is useless for this row, decode the new one.
+        if (request.filePath != result.filePath && prepareRequest(request)) {
+            resubmit.append(request);
+        }
+    }
+    emit thumbnailsReady(results);
+    if (!resubmit.isEmpty()) {
+        m_decodePool->submit(resubmit);
     }
-
-    // Create the final canvas using the originalTargetSize
-    QImage finalImage(originalTargetSize, QImage::Format_ARGB32_Premultiplied);
-    finalImage.fill(Qt::transparent); 
-    qDebug() << "ThumbnailLoader::handleImageReady for row" << row << filePath << "Worker QImage isNull:" << scaledImage.isNull() << "Size:" << scaledImage.size() << "Target:" << originalTargetSize;
-
-    QPainter painter(&finalImage);
-    
-    int x = (originalTargetSize.width() - scaledImage.width()) / 2;
-    int y = (originalTargetSize.height() - scaledImage.height()) / 2;
-    
-    painter.drawImage(x, y, scaledImage);
-    painter.end(); 
-    
-    QPixmap finalPixmap = QPixmap::fromImage(finalImage);
-    qDebug() << "ThumbnailLoader::handleImageReady - Final QPixmap for Icon, isNull:" << finalPixmap.isNull() << "Size:" << finalPixmap.size();
-            
-    emit thumbnailReady(row, QIcon(finalPixmap));
 }
@@ -5,13 +5,14 @@
 #include <QString>
 #include <QSize>
 #include <QIcon>
-#include <QQueue>
-#include <QMutex>
-#include <QWaitCondition>
-#include <QThread>
-#include <QSet>
+#include <QHash>
+#include <atomic>
 #include "ThumbnailWorker.h" // Include the worker definition
+#include "ThumbnailDiskCache.h"
 
+class ThumbnailDecodePool;
+
+// Schedules thumbnail requests onto the decode pool. Used from the GUI thread only.
 class ThumbnailLoader : public QObject
 {
     Q_OBJECT
@@ -22,31 +23,41 @@ public:
 
     void requestThumbnail(int row, const QString &filePath, const QSize &targetSize);
     void requestThumbnailBatch(const QList<ThumbnailRequest> &requests); // For viewport-driven loading
+    // Starts a new scheduling epoch for the given visible rows: queued requests are dropped and workers
+    // skip anything stamped with an older epoch. scrollDirection is -1 (up), 0 or 1 (down); rows ahead
+    // of the scroll are served before rows behind it.
+    void setViewport(int firstVisibleRow, int lastVisibleRow, int scrollDirection);
     void clearQueue();
     void setMaxWorkers(int count);
+    int maxWorkers() const { return m_maxWorkers; }
+    // Opens the persistent thumbnail cache for this folder and sizes the decode pool for its storage
+    void setDatasetDirectory(const QString &directory);
+    void clearDiskCache();
 
 signals:
-    void thumbnailReady(int row, const QIcon &icon);
-    void workerAvailable(); 
+    void thumbnailsReady(const QList<ThumbnailResult> &results); // Composited, in completion order
 
 private slots:
-    void onWorkerFinished(); 
-    void dispatchNextRequest(); 
-    void handleImageReady(int row, const QImage &scaledImage, const QString &filePath, const QSize &originalTargetSize); // Updated slot signature
+    void onRequestCancelled(int row);
+    void handleResults(const QList<ThumbnailResult> &results);
 
 private:
     void startWorkers();
     void stopWorkers();
+    void beginEpoch();
+    bool prepareRequest(ThumbnailRequest &request); // Stamps epoch/priority, false if it must not be submitted now
+    int priorityFor(int row) const;                 // Lower is sooner
 
-    QList<QThread*> m_workerThreads;
-    QList<ThumbnailWorker*> m_availableWorkers;
-    QList<ThumbnailWorker*> m_busyWorkers;
+    ThumbnailDecodePool *m_decodePool;
+    QHash<int, quint64> m_pendingRows;               // Queued or decoding, with the epoch they were submitted under
+    QHash<int, ThumbnailRequest> m_requeueIfCancelled; // Still-wanted rows whose pending request has a stale epoch
 
-    QQueue<ThumbnailRequest> m_requestQueue;
-    QMutex m_queueMutex;
-    QSet<int> m_pendingOrProcessingRows; // Rows that are in queue or being processed
+    std::atomic<quint64> m_epoch; // Read by workers to drop stale requests
+    int m_viewportCenterRow;
+    int m_scrollDirection;
 
     int m_maxWorkers;
+    ThumbnailDiskCache m_diskCache;
 };
 
 #endif // THUMBNAILLOADER_H
@@ -1,19 +1,18 @@
 #include "ThumbnailWorker.h"
+#include "ThumbnailDiskCache.h"
+#include "VideoFrameExtractor.h"
+#include "utils/ScaledImageReader.h"
+#include "utils/ExifThumbnailReader.h"
 #include <QImageReader>
 #include <QFileInfo>
 #include <QPainter>
 #include <QDebug>
-#include <QProcess>       
-#include <QTemporaryFile> 
-#include <QCoreApplication> 
-#include <QDir> // Added for QDir::tempPath()
-#include <QMediaPlayer>
-#include <QVideoSink>
-#include <QVideoFrame>
-#include <QEventLoop>
-#include <QTimer> // For timeouts
 
-ThumbnailWorker::ThumbnailWorker(QObject *parent) : QObject(parent)
+ThumbnailWorker::ThumbnailWorker(ThumbnailDiskCache *diskCache, const std::atomic<quint64> *currentEpoch, QObject *parent)
+    : QObject(parent)
+    , m_diskCache(diskCache)
+    , m_currentEpoch(currentEpoch)
+    , m_videoExtractor(nullptr)
 {
 }
 
@@ -25,13 +24,51 @@ ThumbnailWorker::~ThumbnailWorker()
 void ThumbnailWorker::processRequest(const ThumbnailRequest &request)
 {
     // This method is called in the worker thread.
-    QImage scaledImage = generateScaledImage(request.filePath, request.targetSize);
-    emit imageReady(request.row, scaledImage, request.filePath, request.targetSize); // Emit QImage & original targetSize
-    emit finished(); 
+    if (isStale(request)) {
+        emit requestCancelled(request.row); // The user scrolled away while this sat in the decode pool
+        return;
+    }
+    QImage scaledImage;
+    if (m_diskCache && m_diskCache->lookup(request.filePath, request.targetSize, &scaledImage)) {
+        emit imageReady({request.row, request.filePath, composeThumbnail(scaledImage, request.targetSize)});
+        return;
+    }
+    bool isPlaceholder = false;
+    scaledImage = generateScaledImage(request.filePath, request.targetSize, &isPlaceholder);
+    if (m_diskCache && !isPlaceholder) {
+        m_diskCache->store(request.filePath, request.targetSize, scaledImage); // Next time this is a cache hit
+    }
+    emit imageReady({request.row, request.filePath, composeThumbnail(scaledImage, request.targetSize)});
+}
+
+QImage ThumbnailWorker::composeThumbnail(const QImage &scaledImage, const QSize &targetSize)
+{
+    if (scaledImage.isNull()) {
+        qWarning() << "ThumbnailWorker: Null scaled image, using error placeholder";
+        QImage errorPlaceholder(targetSize, QImage::Format_RGB32);
+        errorPlaceholder.fill(Qt::red);
+        return errorPlaceholder;
+    }
+    if (scaledImage.size() == targetSize) {
+        return scaledImage; // Fills the cell already, nothing to pad
+    }
+
+    QImage finalImage(targetSize, QImage::Format_ARGB32_Premultiplied);
+    finalImage.fill(Qt::transparent);
+    QPainter painter(&finalImage);
+    painter.drawImage((targetSize.width() - scaledImage.width()) / 2, (targetSize.height() - scaledImage.height()) / 2, scaledImage);
+    painter.end();
+    return finalImage;
 }
 
-QImage ThumbnailWorker::generateScaledImage(const QString& filePath, const QSize& targetSize) // Returns QImage
+bool ThumbnailWorker::isStale(const ThumbnailRequest &request) const
 {
+    return m_currentEpoch && request.epoch < m_currentEpoch->load(std::memory_order_relaxed);
+}
+
+QImage ThumbnailWorker::generateScaledImage(const QString& filePath, const QSize& targetSize, bool *isPlaceholder) // Returns QImage
+{
+    if (isPlaceholder) *isPlaceholder = true; // Cleared on the paths that produce a real thumbnail
     qDebug() << "ThumbnailWorker::generateScaledImage for:" << filePath;
     QFileInfo fileInfo(filePath);
     QString suffix = fileInfo.suffix().toLower();
@@ -41,17 +78,24 @@ QImage ThumbnailWorker::generateScaledImage(const QString& filePath, const QSize
     
     if (imageExts.contains(suffix)) {
         qDebug() << "Processing as image (Simplified Path):" << filePath;
-        QImageReader reader(filePath);
-        reader.setAutoTransform(true); 
-        QImage image = reader.read(); 
+        // Camera JPEGs usually carry a ~160x120 EXIF thumbnail; when it is big enough it saves the decode entirely
+        if (suffix == "jpg" || suffix == "jpeg") {
+            QImage embedded = ExifThumbnailReader::read(filePath, targetSize);
+            if (!embedded.isNull()) {
+                if (isPlaceholder) *isPlaceholder = false;
+                return embedded.scaled(targetSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+            }
+        }
+        // Reduced-resolution decode: a 6000x4000 JPEG is decoded at 1/8 scale instead of in full
+        QString errorString;
+        QImage finalScaledImage = ScaledImageReader::read(filePath, targetSize, &errorString);
 
-        if (!image.isNull()) {
-            qDebug() << "Image read successfully, original size:" << image.size() << "Target size:" << targetSize << "for" << filePath;
-            QImage finalScaledImage = image.scaled(targetSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        if (!finalScaledImage.isNull()) {
             qDebug() << "Scaled image for delegate, isNull:" << finalScaledImage.isNull() << "Size:" << finalScaledImage.size();
+            if (isPlaceholder) *isPlaceholder = finalScaledImage.isNull();
             return finalScaledImage;
         } else {
-            qWarning() << "ThumbnailWorker: [Simplified Path] Failed to read image" << filePath << "Error:" << reader.errorString() << "Code:" << reader.error();
+            qWarning() << "ThumbnailWorker: [Simplified Path] Failed to read image" << filePath << "Error:" << errorString;
             QImage errorPlaceholder(targetSize, QImage::Format_RGB32);
             errorPlaceholder.fill(Qt::magenta); // Changed placeholder color for this test
             return errorPlaceholder;
@@ -60,66 +104,17 @@ QImage ThumbnailWorker::generateScaledImage(const QString& filePath, const QSize
         qDebug() << "File not in imageExts, checking videoExts:" << filePath;
         QStringList videoExts = {"mp4", "mkv", "webm", "avi", "mov"};
         if (videoExts.contains(suffix)) {
-            qDebug() << "Processing as video with FFmpeg/QProcess:" << filePath;
-            QTemporaryFile tempFile;
-            // Try to create temp file in a standard temp location first
-            tempFile.setFileTemplate(QDir::tempPath() + "/haigaku_thumb_XXXXXX.jpg");
-            if (!tempFile.open()) {
-                // Fallback to application directory if system temp fails (e.g. permissions)
-                tempFile.setFileTemplate(QCoreApplication::applicationDirPath() + "/temp_thumb_XXXXXX.jpg");
-                if (!tempFile.open()) {
-                    qWarning() << "ThumbnailWorker: Could not create temporary file for video frame in temp or app dir.";
-                    QImage errorPlaceholder(targetSize, QImage::Format_RGB32);
-                    errorPlaceholder.fill(Qt::darkRed);
-                    return errorPlaceholder;
-                }
+            qDebug() << "Processing as video in-process:" << filePath;
+            if (!m_videoExtractor) {
+                m_videoExtractor = new VideoFrameExtractor(this); // Created lazily so it lives in the worker thread
             }
-            QString tempFramePath = tempFile.fileName();
-            tempFile.close(); 
-
-            QProcess ffmpegProcess;
-            ffmpegProcess.setWorkingDirectory(QCoreApplication::applicationDirPath()); 
-
-            QStringList arguments;
-            arguments << "-hide_banner" << "-loglevel" << "error"
-                      << "-ss" << "00:00:01.000" // Seek to 1 second
-                      << "-i" << filePath
-                      << "-frames:v" << "1"      // Extract 1 frame
-                      << "-vf" << QString("scale=%1:%2:force_original_aspect_ratio=decrease:flags=bicubic").arg(targetSize.width()).arg(targetSize.height()) // Added bicubic scaling
-                      << "-q:v" << "2"          // Good quality for JPG
-                      << "-y" << tempFramePath;
-
-            QString ffmpegCommand = QCoreApplication::applicationDirPath() + "/ffmpeg.exe";
-            
-            qDebug() << "Attempting to start FFmpeg:" << ffmpegCommand << arguments;
-            ffmpegProcess.start(ffmpegCommand, arguments);
-
-            if (ffmpegProcess.waitForStarted(3000)) {
-                if (ffmpegProcess.waitForFinished(10000)) { // Increased timeout
-                    if (ffmpegProcess.exitStatus() == QProcess::NormalExit && ffmpegProcess.exitCode() == 0) {
-                        QImage frame(tempFramePath);
-                        QFile::remove(tempFramePath);
-                        if (!frame.isNull()) {
-                            // The frame is already scaled by ffmpeg's -vf argument
-                            return frame; 
-                        } else {
-                            qDebug() << "ThumbnailWorker: FFmpeg extracted null frame for" << filePath;
-                        }
-                    } else {
-                        qWarning() << "ThumbnailWorker: FFmpeg failed for" << filePath
-                                   << "Exit code:" << ffmpegProcess.exitCode()
-                                   << "Error:" << ffmpegProcess.readAllStandardError().trimmed() 
-                                   << "Output:" << ffmpegProcess.readAllStandardOutput().trimmed();
-                    }
-                } else {
-                    qWarning() << "ThumbnailWorker: FFmpeg timed out for" << filePath;
-                    ffmpegProcess.kill();
-                    ffmpegProcess.waitForFinished(1000); // wait briefly after kill
-                }
-            } else {
-                qWarning() << "ThumbnailWorker: FFmpeg failed to start for" << filePath << ". Command:" << ffmpegCommand << "Error:" << ffmpegProcess.errorString();
+            QString errorString;
+            QImage frame = m_videoExtractor->extractFrame(filePath, targetSize, &errorString);
+            if (!frame.isNull()) {
+                if (isPlaceholder) *isPlaceholder = false;
+                return frame;
             }
-            QFile::remove(tempFramePath); // Ensure cleanup
+            qWarning() << "ThumbnailWorker: Could not extract video frame for" << filePath << "Error:" << errorString;
 
             QImage videoPlaceholder(targetSize, QImage::Format_RGB32);
             videoPlaceholder.fill(Qt::darkCyan); 
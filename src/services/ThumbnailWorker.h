@@ -5,11 +5,25 @@
 #include <QString>
 #include <QSize>
 #include <QIcon>
+#include <QImage>
+#include <atomic>
+
+class ThumbnailDiskCache;
+class VideoFrameExtractor;
 
 struct ThumbnailRequest {
     int row;
     QString filePath;
     QSize targetSize;
+    quint64 epoch = 0; // Scheduling epoch stamped by ThumbnailLoader
+    int priority = 0;  // Lower is decoded sooner
+};
+
+// Finished thumbnail, already composited onto a targetSize canvas so the GUI thread only wraps it in a QPixmap
+struct ThumbnailResult {
+    int row;
+    QString filePath;
+    QImage image;
 };
 
 class ThumbnailWorker : public QObject
@@ -17,18 +31,28 @@ class ThumbnailWorker : public QObject
     Q_OBJECT
 
 public:
-    explicit ThumbnailWorker(QObject *parent = nullptr);
+    explicit ThumbnailWorker(ThumbnailDiskCache *diskCache = nullptr, const std::atomic<quint64> *currentEpoch = nullptr,
+                             QObject *parent = nullptr);
     ~ThumbnailWorker();
 
 public slots:
     void processRequest(const ThumbnailRequest &request); // Slot to start processing
 
+public:
+    // Centers scaledImage on a transparent targetSize canvas (red placeholder if it is null)
+    static QImage composeThumbnail(const QImage &scaledImage, const QSize &targetSize);
+
 signals:
-    void imageReady(int row, const QImage &scaledImage, const QString &filePath, const QSize &originalTargetSize); // Added originalTargetSize
-    void finished();
+    void imageReady(const ThumbnailResult &result); // Emitted on the worker's thread
+    void requestCancelled(int row); // Request was stale by the time this worker got to it
 
 private:
-    QImage generateScaledImage(const QString& filePath, const QSize& targetSize); // Returns QImage
+    bool isStale(const ThumbnailRequest &request) const;
+    QImage generateScaledImage(const QString& filePath, const QSize& targetSize, bool *isPlaceholder = nullptr); // Returns QImage
+
+    ThumbnailDiskCache *m_diskCache; // Shared with the loader, may be null
+    const std::atomic<quint64> *m_currentEpoch; // Owned by the loader, may be null
+    VideoFrameExtractor *m_videoExtractor; // Reused across video requests on this worker
 };
 
 #endif // THUMBNAILWORKER_H
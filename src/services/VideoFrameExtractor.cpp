@@ -0,0 +1,109 @@
+#include "VideoFrameExtractor.h"
+#include <QMediaPlayer>
+#include <QVideoSink>
+#include <QVideoFrame>
+#include <QEventLoop>
+#include <QTimer>
+#include <QUrl>
+#include <QDebug>
+
+namespace {
+const qint64 PreferredFramePositionMs = 1000; // Skips black lead-in frames and fades
+const qint64 SeekToleranceUs = 500000;         // Frames this far before the target still count as "after the seek"
+}
+
+VideoFrameExtractor::VideoFrameExtractor(QObject *parent)
+    : QObject(parent)
+    , m_player(new QMediaPlayer(this))
+    , m_videoSink(new QVideoSink(this))
+    , m_timeoutMs(5000)
+{
+    m_player->setVideoSink(m_videoSink); // No audio output is attached, so nothing is ever heard
+}
+
+VideoFrameExtractor::~VideoFrameExtractor()
+{
+    m_player->stop();
+}
+
+bool VideoFrameExtractor::waitForLoaded(QString *errorString)
+{
+    auto isSettled = [this]() {
+        const QMediaPlayer::MediaStatus status = m_player->mediaStatus();
+        return status == QMediaPlayer::LoadedMedia || status == QMediaPlayer::InvalidMedia
+               || status == QMediaPlayer::BufferedMedia || status == QMediaPlayer::EndOfMedia;
+    };
+    if (!isSettled() && m_player->error() == QMediaPlayer::NoError) {
+        QEventLoop loop;
+        QTimer timeout;
+        timeout.setSingleShot(true);
+        connect(&timeout, &QTimer::timeout, &loop, &QEventLoop::quit);
+        connect(m_player, &QMediaPlayer::mediaStatusChanged, &loop, [&]() { if (isSettled()) loop.quit(); });
+        connect(m_player, &QMediaPlayer::errorOccurred, &loop, &QEventLoop::quit);
+        timeout.start(m_timeoutMs);
+        loop.exec();
+    }
+
+    if (m_player->error() != QMediaPlayer::NoError || m_player->mediaStatus() == QMediaPlayer::InvalidMedia) {
+        if (errorString) *errorString = m_player->errorString();
+        return false;
+    }
+    if (!isSettled()) {
+        if (errorString) *errorString = tr("Timed out opening media");
+        return false;
+    }
+    return true;
+}
+
+QImage VideoFrameExtractor::extractFrame(const QString &filePath, const QSize &boundingSize, QString *errorString)
+{
+    m_player->setSource(QUrl::fromLocalFile(filePath));
+    if (!waitForLoaded(errorString)) {
+        m_player->setSource(QUrl()); // Release the file handle
+        return QImage();
+    }
+
+    const qint64 duration = m_player->duration();
+    const qint64 targetMs = duration > 0 ? qMin(PreferredFramePositionMs, duration / 10) : 0;
+
+    // Paused + seek makes the backend decode from the preceding keyframe and present exactly one frame
+    QVideoFrame capturedFrame;
+    QVideoFrame fallbackFrame;
+    QEventLoop loop;
+    QTimer timeout;
+    timeout.setSingleShot(true);
+    connect(&timeout, &QTimer::timeout, &loop, &QEventLoop::quit);
+    connect(m_player, &QMediaPlayer::errorOccurred, &loop, &QEventLoop::quit);
+    connect(m_videoSink, &QVideoSink::videoFrameChanged, &loop, [&](const QVideoFrame &frame) {
+        if (!frame.isValid()) return;
+        if (frame.startTime() < 0 || frame.startTime() >= targetMs * 1000 - SeekToleranceUs) {
+            capturedFrame = frame;
+            loop.quit();
+        } else {
+            fallbackFrame = frame; // Pre-seek frame, only used if the seek never lands
+        }
+    });
+    m_player->pause();
+    m_player->setPosition(targetMs);
+    timeout.start(m_timeoutMs);
+    loop.exec();
+
+    const QString playerError = m_player->error() != QMediaPlayer::NoError ? m_player->errorString() : QString();
+    m_player->stop();
+    m_player->setSource(QUrl()); // Release the file handle; the player itself is kept for the next request
+
+    if (!capturedFrame.isValid()) {
+        capturedFrame = fallbackFrame;
+    }
+    if (!capturedFrame.isValid()) {
+        if (errorString) *errorString = !playerError.isEmpty() ? playerError : tr("No video frame decoded");
+        return QImage();
+    }
+
+    QImage image = capturedFrame.toImage();
+    if (image.isNull()) {
+        if (errorString) *errorString = tr("Could not convert video frame");
+        return QImage();
+    }
+    return image.scaled(boundingSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+}
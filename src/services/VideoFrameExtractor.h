@@ -0,0 +1,39 @@
+#ifndef VIDEOFRAMEEXTRACTOR_H
+#define VIDEOFRAMEEXTRACTOR_H
+
+#include <QObject>
+#include <QImage>
+#include <QSize>
+#include <QString>
+
+class QMediaPlayer;
+class QVideoSink;
+
+// Grabs a single representative frame from a video in-process through QMediaPlayer + QVideoSink,
+// without spawning an external process or round-tripping the frame through a temp file.
+// The player and sink are created once and reused for every request, so the multimedia backend
+// is only initialised once per worker. Must be used from a thread with an event loop (it spins
+// a local QEventLoop while waiting for the frame); not thread-safe, one instance per worker thread.
+class VideoFrameExtractor : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit VideoFrameExtractor(QObject *parent = nullptr);
+    ~VideoFrameExtractor();
+
+    // Returns the frame near the 1 s mark (or 10% into shorter clips) fitted into boundingSize,
+    // or a null image on failure/timeout
+    QImage extractFrame(const QString &filePath, const QSize &boundingSize, QString *errorString = nullptr);
+
+    void setTimeout(int milliseconds) { m_timeoutMs = milliseconds; }
+
+private:
+    bool waitForLoaded(QString *errorString);
+
+    QMediaPlayer *m_player;
+    QVideoSink *m_videoSink;
+    int m_timeoutMs;
+};
+
+#endif // VIDEOFRAMEEXTRACTOR_H
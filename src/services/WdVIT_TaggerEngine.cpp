@@ -1,14 +1,37 @@
 #include "WdVIT_TaggerEngine.h"
+#include "utils/SimdImageOps.h"
+#include "utils/ThreadBudget.h"
+#include "utils/SimdScoreOps.h"
+#include "OptimizedModelCache.h"
+#include "models/TagDictionary.h"
 #include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDateTime>
+#include <QCryptographicHash>
 #include <QTextStream>
+#include <QHash>
 #include <QDebug>
 #include <stdexcept> // For std::runtime_error
-#include <QPainter>  // Added for QPainter
+#include <algorithm>
+
+static std::basic_string<ORTCHAR_T> toOrtPath(const QString &path)
+{
+#ifdef _WIN32
+    return path.toStdWString();
+#else
+    return path.toStdString();
+#endif
+}
 
 // Constructor: Initialize ONNX Runtime environment
 WdVIT_TaggerEngine::WdVIT_TaggerEngine()
     : m_ortEnv(ORT_LOGGING_LEVEL_WARNING, "HaigakuTagger") 
     , m_ortSession(nullptr)
+    , m_outputTagCount(0)
+    , m_memoryInfo(Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault))
+    , m_outputTensor(nullptr)
+    , m_boundOutputBatch(0)
     , m_modelLoaded(false)
     , m_vocabularyLoaded(false) // Initialize new flag
     , m_generalThreshold(0.35f) 
@@ -23,7 +46,8 @@ WdVIT_TaggerEngine::~WdVIT_TaggerEngine()
 }
 
 bool WdVIT_TaggerEngine::loadModel(const QString &modelPath, const QString &tagsCsvPath, 
-                                   bool useCpu, bool useDirectML, bool useCuda)
+                                   bool useCpu, bool useDirectML, bool useCuda,
+                                   const QVariantMap &sessionSettings)
 {
     if (m_modelLoaded) { // If full model is loaded, unload it first
         unloadModel(); 
@@ -38,30 +62,62 @@ bool WdVIT_TaggerEngine::loadModel(const QString &modelPath, const QString &tags
     }
 
     try {
-        Ort::SessionOptions session_options;
-        session_options.SetIntraOpNumThreads(1); 
-
-        // TODO: Add execution provider logic (DirectML, CUDA)
-        // For now, defaults to CPU
-        if (useDirectML) {
-            qDebug() << "Attempting to use DirectML.";
-            // OrtSessionOptionsAppendExecutionProvider_DML(session_options, 0); // Example, API might vary
-        } else if (useCuda) {
-            qDebug() << "Attempting to use CUDA.";
-            // OrtCUDAProviderOptions cuda_options{};
-            // session_options.AppendExecutionProvider_CUDA(cuda_options); // Example
-        } else {
-            qDebug() << "Using CPU execution provider.";
+        auto configureSessionOptions = [&](Ort::SessionOptions &session_options) {
+            applySessionOptions(session_options, sessionSettings);
+
+            // TODO: Add execution provider logic (DirectML, CUDA)
+            // For now, defaults to CPU
+            if (useDirectML) {
+                qDebug() << "Attempting to use DirectML.";
+                // OrtSessionOptionsAppendExecutionProvider_DML(session_options, 0); // Example, API might vary
+            } else if (useCuda) {
+                qDebug() << "Attempting to use CUDA.";
+                // OrtCUDAProviderOptions cuda_options{};
+                // session_options.AppendExecutionProvider_CUDA(cuda_options); // Example
+            } else {
+                qDebug() << "Using CPU execution provider.";
+            }
+        };
+
+        m_prepackedWeights = prepackedWeightsFor(modelPath);
+
+        // The optimized graph depends on the ORT build, the execution provider and the optimization level
+        QString cachePath;
+        if (sessionSettings.value("use_optimized_model_cache", true).toBool()) {
+            const QString optionsKey = QString("%1|%2|%3")
+                .arg(QString::fromLatin1(Ort::GetVersionString().c_str()))
+                .arg(useDirectML ? "dml" : (useCuda ? "cuda" : "cpu"))
+                .arg(sessionSettings.value("graph_optimization_level", "extended").toString());
+            cachePath = OptimizedModelCache::cachePathFor(modelPath, optionsKey);
         }
-        
-        session_options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_EXTENDED);
 
-        #ifdef _WIN32
-            std::wstring modelPathW = modelPath.toStdWString();
-            m_ortSession = std::make_unique<Ort::Session>(m_ortEnv, modelPathW.c_str(), session_options);
-        #else
-            m_ortSession = std::make_unique<Ort::Session>(m_ortEnv, modelPath.toStdString().c_str(), session_options);
-        #endif
+        if (!cachePath.isEmpty() && QFile::exists(cachePath)) {
+            try {
+                Ort::SessionOptions session_options;
+                configureSessionOptions(session_options);
+                session_options.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_DISABLE_ALL); // Already optimized
+                m_ortSession = createSession(cachePath, session_options);
+                qDebug() << "Loaded optimized model from cache:" << cachePath;
+            } catch (const Ort::Exception& e) {
+                qWarning() << "Cached optimized model could not be loaded, rebuilding it:" << e.what();
+                m_ortSession.reset();
+                OptimizedModelCache::invalidate(cachePath);
+            }
+        }
+
+        if (!m_ortSession) {
+            Ort::SessionOptions session_options;
+            configureSessionOptions(session_options);
+            QString temporaryCachePath;
+            if (!cachePath.isEmpty()) {
+                temporaryCachePath = OptimizedModelCache::temporaryPathFor(cachePath);
+                session_options.SetOptimizedModelFilePath(toOrtPath(temporaryCachePath).c_str());
+            }
+            m_ortSession = createSession(modelPath, session_options);
+            if (!temporaryCachePath.isEmpty()) {
+                OptimizedModelCache::commit(temporaryCachePath, cachePath);
+            }
+        }
 
         // Vocabulary is already loaded by loadTagVocabulary() call above.
 
@@ -94,6 +150,9 @@ bool WdVIT_TaggerEngine::loadModel(const QString &modelPath, const QString &tags
         // We expect {1, 3, targetHeight, targetWidth} after preprocessing.
 
         m_outputNodeNames.push_back(m_ortSession->GetOutputNameAllocated(0, allocator).release());
+        const std::vector<int64_t> outputShape = m_ortSession->GetOutputTypeInfo(0).GetTensorTypeAndShapeInfo().GetShape();
+        m_outputTagCount = outputShape.size() == 2 && outputShape[1] > 0 ? outputShape[1] : 0;
+        m_ioBinding = std::make_unique<Ort::IoBinding>(*m_ortSession);
 
         qDebug() << "ONNX Model loaded successfully:" << modelPath;
         QString shapeStr = "{";
@@ -104,29 +163,115 @@ bool WdVIT_TaggerEngine::loadModel(const QString &modelPath, const QString &tags
         qDebug() << "Input node name:" << m_inputNodeNames[0] << "Expected shape (from model):" << shapeStr;
         qDebug() << "Output node name:" << m_outputNodeNames[0];
 
+        // Cached scores are only valid for the exact weights (fp32 vs int8 differ) and tag list they came from
+        const QFileInfo modelInfo(modelPath);
+        const QFileInfo csvInfo(tagsCsvPath);
+        const QByteArray modelIdentity = modelInfo.dir().dirName().toUtf8() + '/' + modelInfo.fileName().toUtf8() + '|'
+            + QByteArray::number(modelInfo.size()) + '|' + QByteArray::number(modelInfo.lastModified().toMSecsSinceEpoch()) + '|'
+            + QByteArray::number(csvInfo.size()) + '|' + QByteArray::number(qulonglong(m_tagVocabulary.size()));
+        m_modelId = QString::fromLatin1(QCryptographicHash::hash(modelIdentity, QCryptographicHash::Sha1).toHex().left(16));
+
         m_modelLoaded = true;
         return true;
 
     } catch (const Ort::Exception& e) {
         qWarning() << "ONNX Runtime exception during model load:" << e.what();
         m_ortSession.reset();
+        m_prepackedWeights.reset();
         m_modelLoaded = false;
         return false;
     } catch (const std::exception& e) {
         qWarning() << "Standard exception during model load:" << e.what();
         m_ortSession.reset();
+        m_prepackedWeights.reset();
         m_modelLoaded = false;
         return false;
     }
 }
 
+std::unique_ptr<Ort::Session> WdVIT_TaggerEngine::createSession(const QString &modelPath, const Ort::SessionOptions &sessionOptions)
+{
+    const std::basic_string<ORTCHAR_T> ortModelPath = toOrtPath(modelPath);
+    if (m_prepackedWeights) {
+        return std::make_unique<Ort::Session>(m_ortEnv, ortModelPath.c_str(), sessionOptions, m_prepackedWeights.get());
+    }
+    return std::make_unique<Ort::Session>(m_ortEnv, ortModelPath.c_str(), sessionOptions);
+}
+
+std::shared_ptr<OrtPrepackedWeightsContainer> WdVIT_TaggerEngine::prepackedWeightsFor(const QString &modelPath)
+{
+    // Sessions over the same weights reuse the prepacked copies instead of each holding their own.
+    // ORT only frees those copies with the container, so it must not outlive the model's sessions.
+    static QMutex registryMutex;
+    static QHash<QString, std::weak_ptr<OrtPrepackedWeightsContainer>> registry;
+    QMutexLocker locker(&registryMutex);
+    std::shared_ptr<OrtPrepackedWeightsContainer> container = registry.value(modelPath).lock();
+    if (!container) {
+        OrtPrepackedWeightsContainer *created = nullptr;
+        if (OrtStatus *status = Ort::GetApi().CreatePrepackedWeightsContainer(&created)) {
+            qWarning() << "Could not create prepacked weights container:" << Ort::GetApi().GetErrorMessage(status);
+            Ort::GetApi().ReleaseStatus(status);
+            return nullptr;
+        }
+        container.reset(created, [](OrtPrepackedWeightsContainer *released) {
+            Ort::GetApi().ReleasePrepackedWeightsContainer(released);
+        });
+        registry.insert(modelPath, container);
+    }
+    return container;
+}
+
+void WdVIT_TaggerEngine::applySessionOptions(Ort::SessionOptions &sessionOptions, const QVariantMap &sessionSettings) const
+{
+    const bool parallelExecution = sessionSettings.value("execution_mode", "sequential").toString() == "parallel";
+    // Set by TaggerEnginePool: sessions of one pool split the inference budget and get disjoint processors
+    const int sessionIndex = sessionSettings.value("session_index", 0).toInt();
+    const int sessionCount = qMax(1, sessionSettings.value("session_count", 1).toInt());
+    const int intraOpThreads = ThreadBudget::resolveIntraOpThreads(sessionSettings.value("intra_op_threads", 0).toInt(), sessionCount);
+    const int interOpThreads = ThreadBudget::resolveInterOpThreads(sessionSettings.value("inter_op_threads", 0).toInt(),
+                                                                   intraOpThreads, parallelExecution, sessionCount);
+    sessionOptions.SetIntraOpNumThreads(intraOpThreads);
+    sessionOptions.SetInterOpNumThreads(interOpThreads);
+    sessionOptions.SetExecutionMode(parallelExecution ? ExecutionMode::ORT_PARALLEL : ExecutionMode::ORT_SEQUENTIAL);
+
+    const QString optimizationLevel = sessionSettings.value("graph_optimization_level", "extended").toString();
+    GraphOptimizationLevel graphOptimizationLevel = GraphOptimizationLevel::ORT_ENABLE_EXTENDED;
+    if (optimizationLevel == "disabled") graphOptimizationLevel = GraphOptimizationLevel::ORT_DISABLE_ALL;
+    else if (optimizationLevel == "basic") graphOptimizationLevel = GraphOptimizationLevel::ORT_ENABLE_BASIC;
+    else if (optimizationLevel == "all") graphOptimizationLevel = GraphOptimizationLevel::ORT_ENABLE_ALL;
+    sessionOptions.SetGraphOptimizationLevel(graphOptimizationLevel);
+
+    QString affinities;
+    if (sessionSettings.value("thread_affinity", "os").toString() == "pinned") {
+        affinities = ThreadBudget::pinnedIntraOpAffinities(intraOpThreads, sessionIndex);
+        if (!affinities.isEmpty()) {
+            sessionOptions.AddConfigEntry("session.intra_op_thread_affinities", affinities.toStdString().c_str());
+        } else {
+            qWarning() << "Not enough logical processors to pin" << intraOpThreads << "intra-op threads, leaving placement to the OS.";
+        }
+    }
+
+    qDebug() << "Session options" << sessionIndex + 1 << "/" << sessionCount << ": intra-op threads" << intraOpThreads << "inter-op threads" << interOpThreads
+             << "execution mode" << (parallelExecution ? "parallel" : "sequential")
+             << "graph optimization" << optimizationLevel << "affinity" << (affinities.isEmpty() ? "os" : affinities);
+}
+
 void WdVIT_TaggerEngine::unloadModel()
 {
+    {
+        QMutexLocker locker(&m_inferenceMutex); // Never pull the session out from under a running batch
+        m_ioBinding.reset(); // Bindings refer to the session, release them first
+        m_outputTensor = Ort::Value(nullptr);
+        m_boundOutputBatch = 0;
+        m_outputTagCount = 0;
+    }
     if (m_ortSession) {
         m_ortSession.reset(); 
     }
+    m_prepackedWeights.reset(); // Frees the packed weights once no other session of the model holds them
     m_inputNodeNames.clear();
     m_outputNodeNames.clear();
+    m_modelId.clear();
     // m_tagVocabulary.clear(); // Vocabulary is cleared by unloadVocabulary
     // m_tagCategories.clear(); // Vocabulary is cleared by unloadVocabulary
     m_modelLoaded = false;
@@ -152,6 +297,11 @@ bool WdVIT_TaggerEngine::isVocabularyLoaded() const
     return m_vocabularyLoaded;
 }
 
+QString WdVIT_TaggerEngine::modelId() const
+{
+    return m_modelId;
+}
+
 QStringList WdVIT_TaggerEngine::getKnownTags() const
 {
     QStringList tags;
@@ -159,8 +309,10 @@ QStringList WdVIT_TaggerEngine::getKnownTags() const
         qWarning() << "getKnownTags called but vocabulary is not loaded.";
         return tags;
     }
-    for(const QString& tag : m_tagVocabulary) {
-        tags.append(tag);
+    const TagDictionary &dictionary = TagDictionary::instance();
+    tags.reserve(static_cast<int>(m_tagVocabulary.size()));
+    for (quint32 tagId : m_tagVocabulary) {
+        tags.append(dictionary.text(tagId));
     }
     return tags;
 }
@@ -195,7 +347,7 @@ bool WdVIT_TaggerEngine::loadTagVocabulary(const QString &tagsCsvPath)
             int category = parts.at(2).trimmed().toInt(&ok);
             
             if (!tagName.isEmpty() && ok) {
-                m_tagVocabulary.push_back(tagName);
+                m_tagVocabulary.push_back(TagDictionary::instance().intern(tagName));
                 m_tagCategories.push_back(category);
             } else {
                 qWarning() << "Skipping malformed CSV line:" << line;
@@ -213,198 +365,316 @@ bool WdVIT_TaggerEngine::loadTagVocabulary(const QString &tagsCsvPath)
     return true;
 }
 
-WdVIT_TaggerEngine::PreprocessedImage WdVIT_TaggerEngine::preprocessImage(const QImage &image, int targetHeight, int targetWidth)
+bool WdVIT_TaggerEngine::preprocessImage(const QImage &image, int targetHeight, int targetWidth, float *tensorOut)
 {
-    PreprocessedImage result;
-    if (image.isNull()) {
+    if (image.isNull() || !tensorOut) {
         qWarning() << "preprocessImage: Input image is null.";
-        return result;
+        return false;
     }
 
-    // 1. Resize
+    // 1. Resize, keeping the aspect ratio. The letterbox padding is written straight into the tensor below.
     QImage resizedImage = image.scaled(targetWidth, targetHeight, Qt::KeepAspectRatio, Qt::SmoothTransformation);
-    // If aspect ratio is kept, pad or crop to exact target size if model requires it.
-    // For now, assume scaled() gives us the right dimensions or model handles slight variations if dynamic.
-    // If not, create a new QImage of targetWidth x targetHeight and paint resizedImage onto it, centered.
-    if (resizedImage.width() != targetWidth || resizedImage.height() != targetHeight) {
-        QImage exactSizeImage(targetWidth, targetHeight, QImage::Format_RGB888); // Ensure format
-        exactSizeImage.fill(Qt::white); // Pad with white, as per Python script (255,255,255)
-        QPainter painter(&exactSizeImage);
-        int x = (targetWidth - resizedImage.width()) / 2;
-        int y = (targetHeight - resizedImage.height()) / 2;
-        painter.drawImage(x, y, resizedImage);
-        resizedImage = exactSizeImage;
+    if (resizedImage.isNull() || resizedImage.width() > targetWidth || resizedImage.height() > targetHeight) {
+        qWarning() << "preprocessImage: Resize failed.";
+        return false;
     }
-    
-    resizedImage = resizedImage.convertToFormat(QImage::Format_RGB888); // Ensure 3 channels, RGB
-
-    // 2. Convert to NHWC float tensor (as per model's expected input shape)
-    // Expected shape: {1, targetHeight, targetWidth, 3}
-    result.shape = {1, static_cast<int64_t>(targetHeight), static_cast<int64_t>(targetWidth), 3};
-    result.tensorValues.resize(1 * targetHeight * targetWidth * 3);
-
-    // Normalization parameters (PLACEHOLDERS - NEED ACTUAL VALUES FROM SCRIPT)
-    // Common for ImageNet:
-    // float mean[3] = {0.485f, 0.456f, 0.406f}; // R, G, B
-    // float stddev[3] = {0.229f, 0.224f, 0.225f}; // R, G, B
-    // For wd-tagger, it might just be scaling to [0,1] or [-1,1]
-    // The Python script uses:
-    //   img = img.convert("RGB")
-    //   img = np.array(img)
-    //   img = img.astype(np.float32)
-    //   img = img / 255.0  <-- Python script does NOT do this before model.run!
-    //                           It passes float32 array with values [0-255] and BGR order.
-    //                           This is unusual. Let's replicate it first.
-    //                           If it fails, scaling to [0,1] is the first thing to try.
-    //   H, W, C = img.shape
-    //   img = img.reshape((1, H, W, C)) # NHWC
-    // The ONNX model must be expecting BGR, [0-255], NHWC or NCHW.
-    // For C++ API, we MUST provide NCHW.
-
-    // float scale = 1.0f / 255.0f; // Still NOT scaling, values remain [0-255] to match Python script
-
-    int i = 0;
-    for (int h = 0; h < targetHeight; ++h) {
-        for (int w = 0; w < targetWidth; ++w) {
-            QRgb pixel = resizedImage.pixel(w, h);
-            // NHWC order: B, G, R
-            result.tensorValues[i++] = static_cast<float>(qBlue(pixel));
-            result.tensorValues[i++] = static_cast<float>(qGreen(pixel));
-            result.tensorValues[i++] = static_cast<float>(qRed(pixel));
+    // 32-bit layouts the scanline kernel understands; translucent pixels end up composited onto white
+    resizedImage = resizedImage.convertToFormat(resizedImage.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied
+                                                                               : QImage::Format_RGB32);
+
+    // 2. Write NHWC BGR floats for one slot of the {N, targetHeight, targetWidth, 3} batch tensor.
+    // Values stay in [0, 255] (no mean/std normalization) to match the reference Python pipeline.
+    // Padding is white (255, 255, 255) and the image is centered, as the Python script does.
+    const int offsetX = (targetWidth - resizedImage.width()) / 2;
+    const int offsetY = (targetHeight - resizedImage.height()) / 2;
+    const size_t rowFloats = static_cast<size_t>(targetWidth) * 3;
+    const size_t leftPadFloats = static_cast<size_t>(offsetX) * 3;
+    const size_t imageFloats = static_cast<size_t>(resizedImage.width()) * 3;
+    const size_t rightPadFloats = rowFloats - leftPadFloats - imageFloats;
+
+    SimdImageOps::fill(tensorOut, rowFloats * offsetY, 255.0f); // Top padding
+    for (int y = 0; y < resizedImage.height(); ++y) {
+        float *row = tensorOut + rowFloats * (offsetY + y);
+        SimdImageOps::fill(row, leftPadFloats, 255.0f);
+        SimdImageOps::bgraScanlineToBgrFloat(resizedImage.constScanLine(y), resizedImage.width(), row + leftPadFloats);
+        SimdImageOps::fill(row + leftPadFloats + imageFloats, rightPadFloats, 255.0f);
+    }
+    const int bottomRows = targetHeight - offsetY - resizedImage.height();
+    SimdImageOps::fill(tensorOut + rowFloats * (offsetY + resizedImage.height()), rowFloats * bottomRows, 255.0f); // Bottom padding
+    return true;
+}
+
+WdVIT_TaggerEngine::TagSelection WdVIT_TaggerEngine::tagSelection(const QVariantMap &settings) const
+{
+    TagSelection selection;
+    selection.generalThreshold = settings.value("general_threshold", m_generalThreshold).toFloat();
+    // The Python script uses a separate character threshold; without one the general threshold applies
+    selection.characterThreshold = settings.value("character_threshold", selection.generalThreshold).toFloat();
+    selection.charTagsFirst = settings.value("char_tags_first", false).toBool();
+    selection.hideRatingTags = settings.value("hide_rating_tags", false).toBool();
+    selection.maxTags = qMax(0, settings.value("max_tags", 0).toInt());
+    return selection;
+}
+
+template <typename ForEachScore>
+TaggingResult WdVIT_TaggerEngine::selectTags(ForEachScore forEachScore, const TagSelection &selection) const
+{
+    // CSV categories: 0 = general, 4 = character (as in the Python script's LabelData), 9 = rating/meta.
+    // Ratings are ranked with the general tags unless hidden; 1-3 (copyright, artist) are ignored like the Python script does.
+    struct Pick {
+        float score;
+        quint32 tagIndex;
+        bool character;
+    };
+    thread_local std::vector<Pick> picks; // Reused, so steady-state postprocessing does not allocate here
+    picks.clear();
+    forEachScore([&](size_t i, float score) {
+        const int category = m_tagCategories[i];
+        if (category == TaggingResult::CharacterCategory) {
+            if (score > selection.characterThreshold) {
+                picks.push_back({score, static_cast<quint32>(i), true});
+            }
+        } else if (category == TaggingResult::GeneralCategory
+                   || (category == TaggingResult::RatingCategory && !selection.hideRatingTags)) {
+            if (score > selection.generalThreshold) {
+                picks.push_back({score, static_cast<quint32>(i), false});
+            }
         }
+    });
+
+    const auto higherScore = [](const Pick &a, const Pick &b) {
+        return a.score != b.score ? a.score > b.score : a.tagIndex < b.tagIndex;
+    };
+    if (selection.maxTags > 0 && picks.size() > size_t(selection.maxTags)) { // Partial top-k: only the kept tags get sorted
+        std::nth_element(picks.begin(), picks.begin() + selection.maxTags, picks.end(), higherScore);
+        picks.resize(selection.maxTags);
+    }
+    // Character tags before or after the general ones, each group by score descending
+    std::sort(picks.begin(), picks.end(), [&](const Pick &a, const Pick &b) {
+        if (a.character != b.character) {
+            return a.character == selection.charTagsFirst;
+        }
+        return higherScore(a, b);
+    });
+
+    TaggingResult result;
+    result.reserve(picks.size());
+    for (const Pick &pick : picks) {
+        result.append(m_tagVocabulary[pick.tagIndex], pick.score, static_cast<quint8>(m_tagCategories[pick.tagIndex]));
     }
-    qDebug() << "Preprocessing: Image tensor created with shape {1," << targetHeight << "," << targetWidth << ",3}, BGR, float32, range [0-255]";
     return result;
 }
 
-QStringList WdVIT_TaggerEngine::postprocessOutput(const Ort::Value &outputTensor, const QVariantMap &settings)
+TaggingResult WdVIT_TaggerEngine::postprocessOutput(const float *scores, size_t numScores, const TagSelection &selection) const
 {
-    QStringList tags;
     if (m_tagVocabulary.empty()) { // Changed isEmpty() to empty()
         qWarning() << "Tag vocabulary is empty, cannot postprocess.";
-        return tags;
+        return TaggingResult();
     }
 
-    // Get pointer to output tensor float values
-    const float* logits = outputTensor.GetTensorData<float>();
-    auto outputShapeInfo = outputTensor.GetTensorTypeAndShapeInfo();
-    auto outputShape = outputShapeInfo.GetShape(); // Should be {1, num_tags} or {num_tags}
-
-    size_t num_tags = outputShapeInfo.GetElementCount();
-    if (num_tags != m_tagVocabulary.size()) {
-        qWarning() << "Output tensor size" << num_tags << "does not match vocabulary size" << m_tagVocabulary.size();
-        return tags;
+    // scores points at one row of the {N, num_tags} output tensor
+    if (numScores != m_tagVocabulary.size()) {
+        qWarning() << "Output tensor size" << numScores << "does not match vocabulary size" << m_tagVocabulary.size();
+        return TaggingResult();
     }
 
-    // Apply settings from QVariantMap
-    float general_thresh = settings.value("general_threshold", m_generalThreshold).toFloat();
-    // The Python script uses a separate character_thresh. We'll use general_thresh for all for now,
-    // unless specific character_thresh is provided in settings.
-    float character_thresh = settings.value("character_threshold", general_thresh).toFloat(); // Default to general_thresh
-    bool charTagsFirst = settings.value("char_tags_first", false).toBool();
-    bool hideRatingTags = settings.value("hide_rating_tags", false).toBool();
-
-    std::vector<std::pair<float, QString>> general_tag_pairs;
-    std::vector<std::pair<float, QString>> character_tag_pairs;
-    // Rating tags are typically category 9 as per CSV and Python script's LabelData
-    // The Python script's LabelData also considers category 4 as character.
-    // CSV categories: 0=general, 1=character(unused by py script?), 2=copyright, 3=artist, 4=character(used by py script)
-    // 9=rating/meta.
-
-    for (size_t i = 0; i < num_tags; ++i) {
-        int category = m_tagCategories[i];
-        const QString& tagName = m_tagVocabulary[i];
-        float score = logits[i];
-
-        if (category == 9) { // Rating/Meta tag
-            if (!hideRatingTags && score > general_thresh) { // Use general_thresh for ratings too for now
-                // Rating tags are usually not sorted by score but appended if above threshold
-                // Or handle them separately if they need different logic
-                 general_tag_pairs.push_back({score, tagName}); // Treat as general for now if not hidden
-            }
-        } else if (category == 4) { // Character tag (as per Python script's LabelData)
-            if (score > character_thresh) {
-                character_tag_pairs.push_back({score, tagName});
-            }
-        } else if (category == 0) { // General tag
-             if (score > general_thresh) {
-                general_tag_pairs.push_back({score, tagName});
-            }
+    // Vectorized pass over the whole row; only the few scores above the lower threshold reach the per-tag logic
+    thread_local std::vector<quint32> candidates;
+    candidates.resize(numScores);
+    const size_t candidateCount = SimdScoreOps::indicesAbove(scores, numScores,
+        std::min(selection.generalThreshold, selection.characterThreshold), candidates.data());
+    return selectTags([&](auto consider) {
+        for (size_t k = 0; k < candidateCount; ++k) {
+            consider(candidates[k], scores[candidates[k]]);
         }
-        // Other categories (1, 2, 3) are ignored for now, similar to Python script's simplified handling
-    }
-
-    // Sort character and general tags by score (descending)
-    std::sort(character_tag_pairs.rbegin(), character_tag_pairs.rend());
-    std::sort(general_tag_pairs.rbegin(), general_tag_pairs.rend());
+    }, selection);
+}
 
-    if (charTagsFirst) {
-        for(const auto& p : character_tag_pairs) tags.append(p.second);
-        for(const auto& p : general_tag_pairs) tags.append(p.second);
-    } else {
-        for(const auto& p : general_tag_pairs) tags.append(p.second);
-        for(const auto& p : character_tag_pairs) tags.append(p.second);
+TaggingResult WdVIT_TaggerEngine::tagsFromScores(const TagScoreCache::Scores &scores, const QVariantMap &settings) const
+{
+    if (m_tagVocabulary.empty()) {
+        qWarning() << "Tag vocabulary is empty, cannot apply cached scores.";
+        return TaggingResult();
     }
-    // Note: The Python script adds rating tags at the end regardless of charTagsFirst.
-    // My current logic includes them in general_tag_pairs if not hidden.
-    // This might need refinement if rating tags have special ordering.
+    const size_t vocabularySize = m_tagVocabulary.size();
+    return selectTags([&](auto consider) {
+        for (const TagScoreCache::ScoredTag &scoredTag : scores) {
+            if (scoredTag.tagIndex < vocabularySize) {
+                consider(scoredTag.tagIndex, scoredTag.score);
+            }
+        }
+    }, tagSelection(settings));
+}
 
-    return tags;
+bool WdVIT_TaggerEngine::cachedScoresCover(const QVariantMap &settings) const
+{
+    const TagSelection selection = tagSelection(settings);
+    return std::min(selection.generalThreshold, selection.characterThreshold) >= TagScoreCache::MinStoredScore;
 }
 
 
-QStringList WdVIT_TaggerEngine::generateTags(const QImage &image, const QVariantMap &settings)
+QSize WdVIT_TaggerEngine::modelInputSize() const
 {
-    if (!m_modelLoaded || !m_ortSession) {
-        qWarning() << "Model not loaded, cannot generate tags.";
-        return QStringList();
-    }
-    if (image.isNull()) {
-        qWarning() << "Input image is null for tag generation.";
-        return QStringList();
-    }
-
-    // Assuming m_inputShape from model is {1, 3, H, W} where H, W might be dynamic (-1)
     // We need to use the specific target H, W for this model (e.g., 448x448)
     int targetHeight = 448; 
     int targetWidth = 448;  
     // If model shape is NHWC: {-1, H, W, C}
-    if (m_inputShape.size() == 4 && m_inputShape[0] == -1) { // Dynamic batch
+    if (m_inputShape.size() == 4) {
         if (m_inputShape[1] > 0) targetHeight = static_cast<int>(m_inputShape[1]); // Index 1 is Height
         if (m_inputShape[2] > 0) targetWidth = static_cast<int>(m_inputShape[2]);  // Index 2 is Width
         // m_inputShape[3] should be 3 (Channels)
-        qDebug() << "Using model input HxW:" << targetHeight << "x" << targetWidth;
     } else {
         qDebug() << "Warning: Model input shape not as expected or not fully defined. Using default 448x448.";
     }
+    return QSize(targetWidth, targetHeight);
+}
 
-    PreprocessedImage pImg = preprocessImage(image, targetHeight, targetWidth);
-    if (pImg.tensorValues.empty()) {
-        return QStringList();
+TaggingResult WdVIT_TaggerEngine::generateTags(const QImage &image, const QVariantMap &settings, TagScoreCache::Scores *rawScores)
+{
+    if (image.isNull()) {
+        qWarning() << "Input image is null for tag generation.";
+        return TaggingResult();
+    }
+    QVector<TagScoreCache::Scores> batchScores;
+    QVector<TaggingResult> results = generateTagsBatch(QVector<QImage>{image}, settings, rawScores ? &batchScores : nullptr);
+    if (rawScores) {
+        *rawScores = batchScores.isEmpty() ? TagScoreCache::Scores() : batchScores.first();
     }
+    return results.isEmpty() ? TaggingResult() : results.first();
+}
 
-    try {
-        Ort::MemoryInfo memory_info = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
-        Ort::Value input_tensor = Ort::Value::CreateTensor<float>(
-            memory_info, pImg.tensorValues.data(), pImg.tensorValues.size(),
-            pImg.shape.data(), pImg.shape.size()
-        );
-
-        auto output_tensors = m_ortSession->Run(Ort::RunOptions{nullptr}, 
-                                                m_inputNodeNames.data(), &input_tensor, 1, 
-                                                m_outputNodeNames.data(), 1);
-
-        if (output_tensors.empty() || !output_tensors[0].IsTensor()) {
-            qWarning() << "Failed to get valid output tensor from ONNX session.";
-            return QStringList();
+QVector<TaggingResult> WdVIT_TaggerEngine::generateTagsBatch(const QVector<QImage> &images, const QVariantMap &settings,
+                                                             QVector<TagScoreCache::Scores> *rawScores)
+{
+    QVector<TaggingResult> results(images.size());
+    if (rawScores) {
+        *rawScores = QVector<TagScoreCache::Scores>(images.size());
+    }
+    if (!m_modelLoaded || !m_ortSession) {
+        qWarning() << "Model not loaded, cannot generate tags.";
+        return results;
+    }
+    if (images.isEmpty()) {
+        return results;
+    }
+
+    const QSize inputSize = modelInputSize();
+    const size_t imageElementCount = static_cast<size_t>(inputSize.height()) * inputSize.width() * 3;
+
+    thread_local AlignedBuffer<float> batchValues; // Per calling thread, reused across calls
+    batchValues.resize(imageElementCount * images.size());
+    QVector<int> sourceIndices; // Packed slot -> index into images (null/failed images are skipped)
+    sourceIndices.reserve(images.size());
+    for (int i = 0; i < images.size(); ++i) {
+        if (images.at(i).isNull()) {
+            qWarning() << "generateTagsBatch: Skipping null image at index" << i;
+            continue;
+        }
+        float *slot = batchValues.data() + imageElementCount * sourceIndices.size();
+        if (preprocessImage(images.at(i), inputSize.height(), inputSize.width(), slot)) {
+            sourceIndices.append(i);
+        }
+    }
+    if (sourceIndices.isEmpty()) {
+        return results;
+    }
+
+    QVector<TagScoreCache::Scores> packedScores;
+    QVector<TaggingResult> packedResults = generateTagsPreprocessed(batchValues.data(), static_cast<int>(sourceIndices.size()), settings,
+                                                                  rawScores ? &packedScores : nullptr);
+    for (int i = 0; i < packedResults.size(); ++i) {
+        results[sourceIndices.at(i)] = packedResults.at(i);
+        if (rawScores && i < packedScores.size()) {
+            (*rawScores)[sourceIndices.at(i)] = packedScores.at(i);
         }
-        return postprocessOutput(output_tensors[0], settings);
+    }
+    return results;
+}
+
+QVector<TaggingResult> WdVIT_TaggerEngine::generateTagsPreprocessed(const float *tensorValues, int imageCount, const QVariantMap &settings,
+                                                                    QVector<TagScoreCache::Scores> *rawScores)
+{
+    if (!m_modelLoaded || !m_ortSession) {
+        qWarning() << "Model not loaded, cannot generate tags.";
+        return QVector<TaggingResult>();
+    }
+    if (!tensorValues || imageCount <= 0) {
+        return QVector<TaggingResult>();
+    }
+
+    const QSize inputSize = modelInputSize();
+    const int targetHeight = inputSize.height();
+    const int targetWidth = inputSize.width();
+    const size_t imageElementCount = static_cast<size_t>(targetHeight) * targetWidth * 3;
+
+    // Models exported with a fixed batch dimension only accept exactly that many images per Run,
+    // so the batch is split into chunks of that size and a short last chunk is zero-padded.
+    const bool fixedBatch = !m_inputShape.empty() && m_inputShape[0] > 0;
+    const int chunkCapacity = fixedBatch ? static_cast<int>(m_inputShape[0]) : imageCount;
+
+    const TagSelection selection = tagSelection(settings); // Parsed once for the whole batch
+    QVector<TaggingResult> results(imageCount);
+    if (rawScores) {
+        *rawScores = QVector<TagScoreCache::Scores>(imageCount);
+    }
+    QMutexLocker locker(&m_inferenceMutex);
+    if (!m_ioBinding) {
+        return QVector<TaggingResult>(); // Unloaded while this call waited for the lock
+    }
+    const size_t scoresPerImage = m_outputTagCount > 0 ? static_cast<size_t>(m_outputTagCount) : m_tagVocabulary.size();
+    try {
+        for (int start = 0; start < imageCount; start += chunkCapacity) {
+            const int count = qMin(chunkCapacity, imageCount - start);
+            const int runBatch = fixedBatch ? chunkCapacity : count;
+            // CreateTensor wants a non-const pointer but does not write to the input
+            float *chunkValues = const_cast<float *>(tensorValues) + imageElementCount * start;
+            if (runBatch != count) {
+                m_paddedInput.resize(imageElementCount * runBatch);
+                std::copy(chunkValues, chunkValues + imageElementCount * count, m_paddedInput.begin());
+                std::fill(m_paddedInput.begin() + imageElementCount * count, m_paddedInput.end(), 0.0f);
+                chunkValues = m_paddedInput.data();
+            }
+            const int64_t shape[4] = {static_cast<int64_t>(runBatch), static_cast<int64_t>(targetHeight),
+                                      static_cast<int64_t>(targetWidth), 3};
+
+            // Wraps the caller's memory, nothing is copied
+            Ort::Value input_tensor = Ort::Value::CreateTensor<float>(
+                m_memoryInfo, chunkValues, imageElementCount * runBatch,
+                shape, 4
+            );
+            m_ioBinding->BindInput(m_inputNodeNames[0], input_tensor);
+
+            // The output tensor is only rebuilt when the batch size changes; ORT writes the scores
+            // straight into m_outputScores instead of allocating a result tensor per Run
+            if (m_boundOutputBatch != runBatch) {
+                m_outputScores.resize(scoresPerImage * runBatch);
+                const int64_t outputShape[2] = {static_cast<int64_t>(runBatch), static_cast<int64_t>(scoresPerImage)};
+                m_outputTensor = Ort::Value::CreateTensor<float>(m_memoryInfo, m_outputScores.data(), m_outputScores.size(),
+                                                                 outputShape, 2);
+                m_ioBinding->BindOutput(m_outputNodeNames[0], m_outputTensor);
+                m_boundOutputBatch = runBatch;
+            }
 
+            m_ortSession->Run(Ort::RunOptions{nullptr}, *m_ioBinding);
+            m_ioBinding->ClearBoundInputs(); // Don't keep pointing at the caller's buffer
+
+            // Output is {N, num_tags}; split it back into one score row per image
+            const float *scores = m_outputScores.data();
+            for (int j = 0; j < count; ++j) {
+                results[start + j] = postprocessOutput(scores + scoresPerImage * j, scoresPerImage, selection);
+                if (rawScores) {
+                    (*rawScores)[start + j] = TagScoreCache::fromModelOutput(scores + scoresPerImage * j, scoresPerImage);
+                }
+            }
+        }
     } catch (const Ort::Exception& e) {
         qWarning() << "ONNX Runtime exception during inference:" << e.what();
-        return QStringList();
+        m_ioBinding->ClearBoundInputs();
+        return QVector<TaggingResult>();
     } catch (const std::exception& e) {
         qWarning() << "Standard exception during inference:" << e.what();
-        return QStringList();
+        m_ioBinding->ClearBoundInputs();
+        return QVector<TaggingResult>();
     }
+    return results;
 }
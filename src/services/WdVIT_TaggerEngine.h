@@ -5,8 +5,14 @@
 #include <QStringList>
 #include <QImage>
 #include <QVariantMap>
+#include <QVector>
+#include <QSize>
+#include <QMutex>
 #include <vector>
 #include <memory> // For std::unique_ptr
+#include "TagScoreCache.h"
+#include "models/TaggingResult.h"
+#include "utils/AlignedBuffer.h"
 
 // ONNX Runtime C++ API
 // Ensure this path is correct based on your ONNXRUNTIME_INCLUDE_DIR setup
@@ -18,35 +24,83 @@ public:
     WdVIT_TaggerEngine();
     ~WdVIT_TaggerEngine();
 
+    // sessionSettings: intra_op_threads, inter_op_threads (0 = auto), execution_mode
+    // ("sequential"/"parallel"), graph_optimization_level ("disabled"/"basic"/"extended"/"all"),
+    // thread_affinity ("os"/"pinned"); session_index/session_count are set by TaggerEnginePool to
+    // split the thread budget and pinned cores between its sessions
     bool loadModel(const QString &modelPath, const QString &tagsCsvPath, 
-                   bool useCpu = true, bool useDirectML = false, bool useCuda = false);
+                   bool useCpu = true, bool useDirectML = false, bool useCuda = false,
+                   const QVariantMap &sessionSettings = QVariantMap());
     bool loadTagVocabulary(const QString &tagsCsvPath); // New method
     void unloadModel(); // Will also clear vocabulary
     void unloadVocabulary(); // New method
     bool isModelLoaded() const;
     bool isVocabularyLoaded() const; // New method
     QStringList getKnownTags() const; 
+    QString modelId() const; // Identifies the loaded model file + vocabulary, empty when not loaded
 
-    QStringList generateTags(const QImage &image, const QVariantMap &settings);
+    // rawScores, when given, receives the scores behind the tags (see TagScoreCache)
+    // Results carry tag ids, confidences and categories; call TaggingResult::toStringList() for text.
+    // settings: general_threshold, character_threshold, char_tags_first, hide_rating_tags, max_tags (0 = no limit)
+    TaggingResult generateTags(const QImage &image, const QVariantMap &settings, TagScoreCache::Scores *rawScores = nullptr);
+    // Packs all images into one {N, H, W, 3} tensor and runs a single inference.
+    // The result has one tag list per input image, in input order (empty for null images).
+    QVector<TaggingResult> generateTagsBatch(const QVector<QImage> &images, const QVariantMap &settings,
+                                             QVector<TagScoreCache::Scores> *rawScores = nullptr);
+    // Applies thresholds and ordering to previously cached scores; no inference
+    TaggingResult tagsFromScores(const TagScoreCache::Scores &scores, const QVariantMap &settings) const;
+    // False if a threshold in settings is below TagScoreCache::MinStoredScore, where cached scores miss tags
+    bool cachedScoresCover(const QVariantMap &settings) const;
+
+    // Split pipeline used by bulk jobs: preprocessing can run on other threads,
+    // then the packed {N, H, W, 3} values are handed to generateTagsPreprocessed.
+    QSize modelInputSize() const; // H x W the model expects, falls back to 448x448
+    static bool preprocessImage(const QImage &image, int targetHeight, int targetWidth, float *tensorOut); // Writes H*W*3 floats
+    // Returns one result per image, or an empty vector if inference failed. Runs are serialized per engine;
+    // the input is bound in place and scores land in a reused output buffer, so batches of a steady
+    // size do not allocate tensor memory.
+    QVector<TaggingResult> generateTagsPreprocessed(const float *tensorValues, int imageCount, const QVariantMap &settings,
+                                                    QVector<TagScoreCache::Scores> *rawScores = nullptr);
 
 private:
-    struct PreprocessedImage {
-        std::vector<float> tensorValues;
-        std::vector<int64_t> shape; // Should be {1, 3, H, W}
+    std::unique_ptr<Ort::Session> createSession(const QString &modelPath, const Ort::SessionOptions &sessionOptions);
+    // Shared by every session over the same model (pool sessions, the old and new pool during a
+    // reload) and released with the last of them; nullptr if ORT could not create one
+    static std::shared_ptr<OrtPrepackedWeightsContainer> prepackedWeightsFor(const QString &modelPath);
+    void applySessionOptions(Ort::SessionOptions &sessionOptions, const QVariantMap &sessionSettings) const;
+    struct TagSelection { // The postprocessing settings, parsed once per batch instead of once per image
+        float generalThreshold;
+        float characterThreshold;
+        bool charTagsFirst;
+        bool hideRatingTags;
+        int maxTags; // 0 = no limit
     };
-
-    PreprocessedImage preprocessImage(const QImage &image, int targetHeight, int targetWidth);
-    QStringList postprocessOutput(const Ort::Value &outputTensor, const QVariantMap &settings);
+    TagSelection tagSelection(const QVariantMap &settings) const;
+    TaggingResult postprocessOutput(const float *scores, size_t numScores, const TagSelection &selection) const;
+    // Threshold, category split, top-k and ordering; forEachScore(consider) calls consider(tagIndex, score) per candidate
+    template <typename ForEachScore>
+    TaggingResult selectTags(ForEachScore forEachScore, const TagSelection &selection) const;
 
     Ort::Env m_ortEnv;
+    std::shared_ptr<OrtPrepackedWeightsContainer> m_prepackedWeights; // Must outlive m_ortSession
     std::unique_ptr<Ort::Session> m_ortSession;
     Ort::AllocatorWithDefaultOptions m_allocator;
     
     std::vector<const char*> m_inputNodeNames;  // Store from session
     std::vector<const char*> m_outputNodeNames; // Store from session
     std::vector<int64_t> m_inputShape; 
+    int64_t m_outputTagCount; // Last dimension of the output, 0 if the model leaves it dynamic
+
+    // Inference buffers, reused across Run calls and guarded by m_inferenceMutex
+    QMutex m_inferenceMutex;
+    Ort::MemoryInfo m_memoryInfo; // CPU, created once
+    std::unique_ptr<Ort::IoBinding> m_ioBinding;
+    AlignedBuffer<float> m_paddedInput;  // Zero-padded short last chunk for fixed-batch models
+    AlignedBuffer<float> m_outputScores; // {batch, num_tags}, bound as the output tensor
+    Ort::Value m_outputTensor;
+    int64_t m_boundOutputBatch; // Batch size m_outputTensor is bound for, 0 = not bound
 
-    std::vector<QString> m_tagVocabulary; 
+    std::vector<quint32> m_tagVocabulary; // TagDictionary ids, in model output order
     std::vector<int> m_tagCategories; // Added to store category for each tag
 
     // Model-specific settings (placeholders for now)
@@ -55,6 +109,7 @@ private:
 
     bool m_modelLoaded;
     bool m_vocabularyLoaded; // New flag
+    QString m_modelId;
 };
 
 #endif // WDVIT_TAGGERENGINE_H
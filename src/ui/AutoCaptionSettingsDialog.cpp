@@ -3,6 +3,11 @@
 #include <QCheckBox>
 #include <QDialogButtonBox>
 #include <QLabel> // For messages if no settings for a model
+#include <QGroupBox>
+#include <QFormLayout>
+#include <QSpinBox>
+#include <QComboBox>
+#include "utils/ThreadBudget.h"
 #include <QDebug>
 
 AutoCaptionSettingsDialog::AutoCaptionSettingsDialog(const QString &modelName, 
@@ -13,7 +18,16 @@ AutoCaptionSettingsDialog::AutoCaptionSettingsDialog(const QString &modelName,
       m_charTagsFirstCheckBox(nullptr),       // Initialize members
       m_hideRatingTagsCheckBox(nullptr),
       m_removeSeparatorCheckBox(nullptr),
-      m_storeManualTagsWithUnderscoresCheckBox(nullptr) // Initialize new member
+      m_storeManualTagsWithUnderscoresCheckBox(nullptr), // Initialize new member
+      m_maxTagsSpinBox(nullptr),
+      m_inferenceSessionsSpinBox(nullptr),
+      m_intraOpThreadsSpinBox(nullptr),
+      m_interOpThreadsSpinBox(nullptr),
+      m_executionModeComboBox(nullptr),
+      m_graphOptimizationComboBox(nullptr),
+      m_threadAffinityComboBox(nullptr),
+      m_optimizedModelCacheCheckBox(nullptr),
+      m_modelVariantComboBox(nullptr)
 {
     setWindowTitle(tr("Advanced Settings for %1").arg(modelName));
     setMinimumWidth(350);
@@ -50,11 +64,80 @@ void AutoCaptionSettingsDialog::setupUi(const QString &modelName)
         m_storeManualTagsWithUnderscoresCheckBox = new QCheckBox(tr("Store manual tags with underscores (for file saving)"), this);
         m_storeManualTagsWithUnderscoresCheckBox->setChecked(m_currentSettings.value("store_manual_tags_with_underscores", false).toBool()); // Default false
         mainLayout->addWidget(m_storeManualTagsWithUnderscoresCheckBox);
+
+        QFormLayout *limitLayout = new QFormLayout();
+        m_maxTagsSpinBox = new QSpinBox(this);
+        m_maxTagsSpinBox->setRange(0, 500);
+        m_maxTagsSpinBox->setSpecialValueText(tr("No limit"));
+        m_maxTagsSpinBox->setValue(m_currentSettings.value("max_tags", 0).toInt());
+        m_maxTagsSpinBox->setToolTip(tr("Keep only this many of the highest-scoring tags above the thresholds."));
+        limitLayout->addRow(tr("Maximum tags:"), m_maxTagsSpinBox);
+        mainLayout->addLayout(limitLayout);
         
     } else {
         mainLayout->addWidget(new QLabel(tr("No advanced settings available for this model."), this));
     }
 
+    QGroupBox *performanceGroup = new QGroupBox(tr("Inference Performance (the loaded model is rebuilt in the background)"), this);
+    QFormLayout *performanceLayout = new QFormLayout(performanceGroup);
+
+    m_modelVariantComboBox = new QComboBox(performanceGroup);
+    m_modelVariantComboBox->addItem(tr("FP32 (model.onnx)"), "fp32");
+    m_modelVariantComboBox->addItem(tr("INT8 quantized (model_quantized.onnx)"), "int8");
+    m_modelVariantComboBox->setCurrentIndex(qMax(0, m_modelVariantComboBox->findData(m_currentSettings.value("model_variant", "fp32"))));
+    m_modelVariantComboBox->setToolTip(tr("The INT8 model is much faster on CPU. Use Caption > Compare FP32 and INT8 Tagger to check its accuracy first."));
+    performanceLayout->addRow(tr("Model variant:"), m_modelVariantComboBox);
+
+    m_inferenceSessionsSpinBox = new QSpinBox(performanceGroup);
+    m_inferenceSessionsSpinBox->setRange(0, qMax(1, ThreadBudget::inferenceThreads() / 2));
+    m_inferenceSessionsSpinBox->setSpecialValueText(tr("Auto (%1)").arg(ThreadBudget::resolveInferenceSessions(0)));
+    m_inferenceSessionsSpinBox->setValue(m_currentSettings.value("inference_sessions", 0).toInt());
+    m_inferenceSessionsSpinBox->setToolTip(tr("Model sessions running batches side by side. They share the weights and split the inference threads; "
+                                              "more sessions help bulk captioning on many-core machines."));
+    performanceLayout->addRow(tr("Inference sessions:"), m_inferenceSessionsSpinBox);
+
+    m_intraOpThreadsSpinBox = new QSpinBox(performanceGroup);
+    m_intraOpThreadsSpinBox->setRange(0, ThreadBudget::logicalProcessors());
+    m_intraOpThreadsSpinBox->setSpecialValueText(tr("Auto (%1)").arg(ThreadBudget::inferenceThreads()));
+    m_intraOpThreadsSpinBox->setValue(m_currentSettings.value("intra_op_threads", 0).toInt());
+    m_intraOpThreadsSpinBox->setToolTip(tr("Threads used inside each operator. Capped so thumbnail loading keeps its %1 threads.")
+                                            .arg(ThreadBudget::thumbnailThreads()));
+    performanceLayout->addRow(tr("Intra-op threads:"), m_intraOpThreadsSpinBox);
+
+    m_interOpThreadsSpinBox = new QSpinBox(performanceGroup);
+    m_interOpThreadsSpinBox->setRange(0, ThreadBudget::logicalProcessors());
+    m_interOpThreadsSpinBox->setSpecialValueText(tr("Auto"));
+    m_interOpThreadsSpinBox->setValue(m_currentSettings.value("inter_op_threads", 0).toInt());
+    m_interOpThreadsSpinBox->setToolTip(tr("Threads running independent operators concurrently. Only used in parallel execution mode."));
+    performanceLayout->addRow(tr("Inter-op threads:"), m_interOpThreadsSpinBox);
+
+    m_executionModeComboBox = new QComboBox(performanceGroup);
+    m_executionModeComboBox->addItem(tr("Sequential"), "sequential");
+    m_executionModeComboBox->addItem(tr("Parallel"), "parallel");
+    m_executionModeComboBox->setCurrentIndex(qMax(0, m_executionModeComboBox->findData(m_currentSettings.value("execution_mode", "sequential"))));
+    performanceLayout->addRow(tr("Execution mode:"), m_executionModeComboBox);
+
+    m_graphOptimizationComboBox = new QComboBox(performanceGroup);
+    m_graphOptimizationComboBox->addItem(tr("Disabled"), "disabled");
+    m_graphOptimizationComboBox->addItem(tr("Basic"), "basic");
+    m_graphOptimizationComboBox->addItem(tr("Extended"), "extended");
+    m_graphOptimizationComboBox->addItem(tr("All (layout optimizations)"), "all");
+    m_graphOptimizationComboBox->setCurrentIndex(qMax(0, m_graphOptimizationComboBox->findData(m_currentSettings.value("graph_optimization_level", "extended"))));
+    performanceLayout->addRow(tr("Graph optimization:"), m_graphOptimizationComboBox);
+
+    m_threadAffinityComboBox = new QComboBox(performanceGroup);
+    m_threadAffinityComboBox->addItem(tr("Let the OS decide"), "os");
+    m_threadAffinityComboBox->addItem(tr("Pin to dedicated cores"), "pinned");
+    m_threadAffinityComboBox->setCurrentIndex(qMax(0, m_threadAffinityComboBox->findData(m_currentSettings.value("thread_affinity", "os"))));
+    m_threadAffinityComboBox->setToolTip(tr("Pinning keeps inference threads off the cores used for thumbnails and the UI."));
+    performanceLayout->addRow(tr("Thread affinity:"), m_threadAffinityComboBox);
+
+    m_optimizedModelCacheCheckBox = new QCheckBox(tr("Cache the optimized model for faster loading"), performanceGroup);
+    m_optimizedModelCacheCheckBox->setChecked(m_currentSettings.value("use_optimized_model_cache", true).toBool());
+    performanceLayout->addRow(m_optimizedModelCacheCheckBox);
+
+    mainLayout->addWidget(performanceGroup);
+
     mainLayout->addStretch();
 
     m_buttonBox = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, this);
@@ -79,6 +162,19 @@ void AutoCaptionSettingsDialog::onAccepted()
     if (m_storeManualTagsWithUnderscoresCheckBox) {
         m_currentSettings["store_manual_tags_with_underscores"] = m_storeManualTagsWithUnderscoresCheckBox->isChecked();
     }
+    if (m_maxTagsSpinBox) {
+        m_currentSettings["max_tags"] = m_maxTagsSpinBox->value();
+    }
+    if (m_intraOpThreadsSpinBox) {
+        m_currentSettings["inference_sessions"] = m_inferenceSessionsSpinBox->value();
+        m_currentSettings["intra_op_threads"] = m_intraOpThreadsSpinBox->value();
+        m_currentSettings["inter_op_threads"] = m_interOpThreadsSpinBox->value();
+        m_currentSettings["execution_mode"] = m_executionModeComboBox->currentData().toString();
+        m_currentSettings["graph_optimization_level"] = m_graphOptimizationComboBox->currentData().toString();
+        m_currentSettings["thread_affinity"] = m_threadAffinityComboBox->currentData().toString();
+        m_currentSettings["use_optimized_model_cache"] = m_optimizedModelCacheCheckBox->isChecked();
+        m_currentSettings["model_variant"] = m_modelVariantComboBox->currentData().toString();
+    }
     
     QDialog::accept();
 }
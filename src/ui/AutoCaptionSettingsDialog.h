@@ -6,6 +6,8 @@
 
 QT_BEGIN_NAMESPACE
 class QCheckBox;
+class QSpinBox;
+class QComboBox;
 class QVBoxLayout;
 class QDialogButtonBox;
 QT_END_NAMESPACE
@@ -34,8 +36,19 @@ private:
     QCheckBox *m_hideRatingTagsCheckBox;
     QCheckBox *m_removeSeparatorCheckBox;
     QCheckBox *m_storeManualTagsWithUnderscoresCheckBox; // New setting for manual tag storage format
+    QSpinBox *m_maxTagsSpinBox; // Keeps only the highest-scoring tags, 0 = no limit
     // Add more QWidgets for other models' settings as needed
 
+    // ONNX Runtime session options (all models, applied on next model load)
+    QSpinBox *m_inferenceSessionsSpinBox; // Parallel model sessions, 0 = auto
+    QSpinBox *m_intraOpThreadsSpinBox;
+    QSpinBox *m_interOpThreadsSpinBox;
+    QComboBox *m_executionModeComboBox;
+    QComboBox *m_graphOptimizationComboBox;
+    QComboBox *m_threadAffinityComboBox;
+    QCheckBox *m_optimizedModelCacheCheckBox;
+    QComboBox *m_modelVariantComboBox;
+
     QDialogButtonBox *m_buttonBox;
     QVariantMap m_currentSettings;
 };
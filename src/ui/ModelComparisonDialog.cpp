@@ -0,0 +1,206 @@
+#include "ModelComparisonDialog.h"
+#include "services/AutoCaptionManager.h"
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QFormLayout>
+#include <QLineEdit>
+#include <QSpinBox>
+#include <QPushButton>
+#include <QProgressBar>
+#include <QLabel>
+#include <QTableWidget>
+#include <QHeaderView>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QDir>
+#include <QMessageBox>
+#include <QtConcurrent/QtConcurrent>
+#include <QDebug>
+
+ModelComparisonDialog::ModelComparisonDialog(const QString &modelDirectory, const QString &initialFolder,
+                                             const QVariantMap &settings, QWidget *parent)
+    : QDialog(parent)
+    , m_modelDirectory(modelDirectory)
+    , m_settings(settings)
+    , m_comparison(nullptr)
+    , m_watcher(new QFutureWatcher<ModelComparisonReport>(this))
+{
+    setWindowTitle(tr("Compare FP32 and INT8 Tagger"));
+    resize(640, 560);
+    setupUi(initialFolder);
+    connect(m_watcher, &QFutureWatcher<ModelComparisonReport>::finished, this, &ModelComparisonDialog::showReport);
+}
+
+ModelComparisonDialog::~ModelComparisonDialog()
+{
+    if (m_comparison) { // The worker references m_comparison, let it finish first
+        m_comparison->cancel();
+        m_watcher->waitForFinished();
+        delete m_comparison;
+    }
+}
+
+void ModelComparisonDialog::setupUi(const QString &initialFolder)
+{
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+
+    QFormLayout *formLayout = new QFormLayout();
+    QHBoxLayout *folderLayout = new QHBoxLayout();
+    m_folderEdit = new QLineEdit(initialFolder, this);
+    QPushButton *browseButton = new QPushButton(tr("Browse..."), this);
+    connect(browseButton, &QPushButton::clicked, this, &ModelComparisonDialog::browseFolder);
+    folderLayout->addWidget(m_folderEdit);
+    folderLayout->addWidget(browseButton);
+    formLayout->addRow(tr("Sample folder:"), folderLayout);
+
+    m_sampleSizeSpinBox = new QSpinBox(this);
+    m_sampleSizeSpinBox->setRange(1, 10000);
+    m_sampleSizeSpinBox->setValue(200);
+    m_sampleSizeSpinBox->setToolTip(tr("Larger folders are sampled evenly down to this many images."));
+    formLayout->addRow(tr("Images to compare:"), m_sampleSizeSpinBox);
+    mainLayout->addLayout(formLayout);
+
+    QHBoxLayout *buttonLayout = new QHBoxLayout();
+    m_runButton = new QPushButton(tr("Run Comparison"), this);
+    m_cancelButton = new QPushButton(tr("Cancel"), this);
+    m_cancelButton->setEnabled(false);
+    connect(m_runButton, &QPushButton::clicked, this, &ModelComparisonDialog::startComparison);
+    connect(m_cancelButton, &QPushButton::clicked, this, &ModelComparisonDialog::cancelComparison);
+    m_progressBar = new QProgressBar(this);
+    m_progressBar->setValue(0);
+    buttonLayout->addWidget(m_runButton);
+    buttonLayout->addWidget(m_cancelButton);
+    buttonLayout->addWidget(m_progressBar, 1);
+    mainLayout->addLayout(buttonLayout);
+
+    m_summaryLabel = new QLabel(tr("Compares model.onnx against model_quantized.onnx using the current thresholds. "
+                                   "The fp32 output is treated as ground truth."), this);
+    m_summaryLabel->setWordWrap(true);
+    m_summaryLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    mainLayout->addWidget(m_summaryLabel);
+
+    m_tagTable = new QTableWidget(0, 6, this);
+    m_tagTable->setHorizontalHeaderLabels({tr("Tag"), tr("FP32"), tr("INT8"), tr("Both"), tr("Precision"), tr("Recall")});
+    m_tagTable->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+    m_tagTable->verticalHeader()->setVisible(false);
+    m_tagTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    mainLayout->addWidget(m_tagTable, 1);
+
+    QPushButton *closeButton = new QPushButton(tr("Close"), this);
+    connect(closeButton, &QPushButton::clicked, this, &QDialog::accept);
+    mainLayout->addWidget(closeButton, 0, Qt::AlignRight);
+}
+
+void ModelComparisonDialog::browseFolder()
+{
+    QString folder = QFileDialog::getExistingDirectory(this, tr("Select Sample Folder"), m_folderEdit->text());
+    if (!folder.isEmpty()) {
+        m_folderEdit->setText(folder);
+    }
+}
+
+QStringList ModelComparisonDialog::sampleImages(const QString &folder, int maxImages) const
+{
+    QDir directory(folder);
+    QStringList nameFilters = {"*.jpg", "*.jpeg", "*.png", "*.bmp", "*.gif", "*.webp", "*.tiff"};
+    QStringList files = directory.entryList(nameFilters, QDir::Files | QDir::NoDotAndDotDot, QDir::Name);
+    QStringList sample;
+    if (files.isEmpty()) {
+        return sample;
+    }
+    const double step = files.size() > maxImages ? double(files.size()) / maxImages : 1.0; // Spread over the whole folder
+    for (double position = 0.0; position < files.size() && sample.size() < maxImages; position += step) {
+        sample.append(directory.filePath(files.at(static_cast<int>(position))));
+    }
+    return sample;
+}
+
+void ModelComparisonDialog::startComparison()
+{
+    if (m_comparison) return;
+
+    const QString referencePath = AutoCaptionManager::modelFileForVariant(m_modelDirectory, "fp32");
+    const QString candidatePath = AutoCaptionManager::modelFileForVariant(m_modelDirectory, "int8");
+    const QString csvPath = QDir(m_modelDirectory).filePath("selected_tags.csv");
+    if (!QFileInfo::exists(referencePath) || !QFileInfo::exists(csvPath)) {
+        QMessageBox::warning(this, windowTitle(), tr("The fp32 model has not been downloaded yet. Load it once first."));
+        return;
+    }
+    if (!QFileInfo::exists(candidatePath)) {
+        QMessageBox::warning(this, windowTitle(), tr("No quantized model found.\nPlace an INT8 export of the tagger at:\n%1").arg(candidatePath));
+        return;
+    }
+    QStringList images = sampleImages(m_folderEdit->text(), m_sampleSizeSpinBox->value());
+    if (images.isEmpty()) {
+        QMessageBox::warning(this, windowTitle(), tr("No images found in the selected folder."));
+        return;
+    }
+
+    m_comparison = new ModelVariantComparison(referencePath, candidatePath, csvPath, images, m_settings);
+    connect(m_comparison, &ModelVariantComparison::progress, this, &ModelComparisonDialog::updateProgress);
+    m_runButton->setEnabled(false);
+    m_cancelButton->setEnabled(true);
+    m_progressBar->setRange(0, images.size());
+    m_progressBar->setValue(0);
+    m_summaryLabel->setText(tr("Loading both models..."));
+    m_tagTable->setRowCount(0);
+
+    ModelVariantComparison *comparison = m_comparison;
+    m_watcher->setFuture(QtConcurrent::run([comparison]() { return comparison->run(); }));
+}
+
+void ModelComparisonDialog::cancelComparison()
+{
+    if (m_comparison) {
+        m_comparison->cancel();
+        m_cancelButton->setEnabled(false);
+    }
+}
+
+void ModelComparisonDialog::updateProgress(int processed, int total)
+{
+    m_progressBar->setRange(0, total);
+    m_progressBar->setValue(processed);
+    m_summaryLabel->setText(tr("Comparing... %1 / %2 images").arg(processed).arg(total));
+}
+
+void ModelComparisonDialog::showReport()
+{
+    const ModelComparisonReport report = m_watcher->result();
+    delete m_comparison;
+    m_comparison = nullptr;
+    m_runButton->setEnabled(true);
+    m_cancelButton->setEnabled(false);
+
+    if (!report.success) {
+        m_summaryLabel->setText(tr("Comparison failed: %1").arg(report.errorMessage));
+        return;
+    }
+
+    const double speedup = report.candidateSeconds > 0.0 ? report.referenceSeconds / report.candidateSeconds : 0.0;
+    m_summaryLabel->setText(tr("%1 images%2. Overall precision %3%, recall %4% (INT8 vs FP32).\n"
+                               "Throughput: FP32 %5 img/s, INT8 %6 img/s (%7x).")
+                                .arg(report.imageCount)
+                                .arg(report.cancelled ? tr(" (cancelled early)") : QString())
+                                .arg(report.precision() * 100.0, 0, 'f', 2)
+                                .arg(report.recall() * 100.0, 0, 'f', 2)
+                                .arg(report.referenceImagesPerSecond(), 0, 'f', 2)
+                                .arg(report.candidateImagesPerSecond(), 0, 'f', 2)
+                                .arg(speedup, 0, 'f', 2));
+
+    m_tagTable->setRowCount(static_cast<int>(report.tags.size())); // Already ordered with the most disagreements first
+    for (int row = 0; row < report.tags.size(); ++row) {
+        const TagAgreement &agreement = report.tags.at(row);
+        auto numberItem = [](const QString &text) {
+            QTableWidgetItem *item = new QTableWidgetItem(text);
+            item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+            return item;
+        };
+        m_tagTable->setItem(row, 0, new QTableWidgetItem(agreement.tag));
+        m_tagTable->setItem(row, 1, numberItem(QString::number(agreement.referenceCount)));
+        m_tagTable->setItem(row, 2, numberItem(QString::number(agreement.candidateCount)));
+        m_tagTable->setItem(row, 3, numberItem(QString::number(agreement.bothCount)));
+        m_tagTable->setItem(row, 4, numberItem(QString::number(agreement.precision(), 'f', 3)));
+        m_tagTable->setItem(row, 5, numberItem(QString::number(agreement.recall(), 'f', 3)));
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef MODELCOMPARISONDIALOG_H
+#define MODELCOMPARISONDIALOG_H
+
+#include <QDialog>
+#include <QVariantMap>
+#include <QFutureWatcher>
+#include "services/ModelVariantComparison.h"
+
+QT_BEGIN_NAMESPACE
+class QLineEdit;
+class QSpinBox;
+class QPushButton;
+class QProgressBar;
+class QLabel;
+class QTableWidget;
+QT_END_NAMESPACE
+
+// Runs the fp32 and quantized tagger side by side over a sample folder and shows how much the
+// quantized model's tags drift (per-tag precision/recall against fp32) and how much faster it is.
+class ModelComparisonDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    ModelComparisonDialog(const QString &modelDirectory, const QString &initialFolder,
+                          const QVariantMap &settings, QWidget *parent = nullptr);
+    ~ModelComparisonDialog();
+
+private slots:
+    void browseFolder();
+    void startComparison();
+    void cancelComparison();
+    void updateProgress(int processed, int total);
+    void showReport();
+
+private:
+    void setupUi(const QString &initialFolder);
+    QStringList sampleImages(const QString &folder, int maxImages) const;
+
+    QString m_modelDirectory;
+    QVariantMap m_settings;
+    ModelVariantComparison *m_comparison;
+    QFutureWatcher<ModelComparisonReport> *m_watcher;
+
+    QLineEdit *m_folderEdit;
+    QSpinBox *m_sampleSizeSpinBox;
+    QPushButton *m_runButton;
+    QPushButton *m_cancelButton;
+    QProgressBar *m_progressBar;
+    QLabel *m_summaryLabel;
+    QTableWidget *m_tagTable;
+};
+
+#endif // MODELCOMPARISONDIALOG_H
@@ -4,6 +4,7 @@
 #include <QDialog>
 #include <QStringList> 
 #include <QMap> // For tag frequencies
+#include "services/StatisticsEngine.h"
 
 QT_BEGIN_NAMESPACE
 class QTextEdit;
@@ -14,45 +15,26 @@ class QTabWidget; // Added for tabbing
 QT_END_NAMESPACE
 
 class WordCloudWidget; // Forward declaration
-
-// Struct to hold calculated statistics
-struct DatasetStatistics {
-    long long totalMediaSize = 0;
-    int captionedMediaCount = 0;
-    int imageCount = 0;
-    int videoCount = 0;
-    long long maxPixels = 0; // width * height
-    double averagePixels = 0.0;
-    int unpairedCaptionCount = 0;
-    int maxCaptionLengthWords = 0;
-    int minCaptionLengthWords = -1; // -1 indicates not set or no non-empty captions
-    double averageCaptionLengthWords = 0.0;
-    int totalFilesProcessed = 0; 
-    QMap<QString, int> tagFrequencies; // Added to hold tag counts
-
-    QString toString() const; 
-};
-
+class DatasetIndex;
 
 class StatisticsDialog : public QDialog
 {
     Q_OBJECT
 
 public:
-    explicit StatisticsDialog(const QStringList &mediaFiles, const QString &currentDirectory, QWidget *parent = nullptr);
+    explicit StatisticsDialog(const QStringList &mediaFiles, const QString &currentDirectory, DatasetIndex *datasetIndex = nullptr, QWidget *parent = nullptr);
     ~StatisticsDialog();
 
 private slots:
     void calculateStatistics();
     void updateStatisticsDisplay(const DatasetStatistics &stats);
     void updateProgress(int processedCount, int totalCount); 
-
-signals:
-    void progressUpdated(int processedCount, int totalCount); 
+    void onStatisticsFinished(const DatasetStatistics &stats);
+    void onStatisticsCancelled();
 
 private:
     void setupUI();
-    DatasetStatistics performCalculations(); 
+    void saveIndex(bool prune);
 
 
     QTabWidget *m_tabWidget; // Added
@@ -68,6 +50,8 @@ private:
 
     QStringList m_mediaFilePaths; 
     QString m_baseDirectoryPath; 
+    DatasetIndex *m_datasetIndex; // Sizes, dimensions and parsed captions; unchanged files are not re-read
+    StatisticsEngine *m_engine;   // Runs on the thread pool; the dialog stays responsive without processEvents
 };
 
 #endif // STATISTICSDIALOG_H
@@ -1,6 +1,7 @@
 #include "TagEditorWidget.h"
 #include "TagPillWidget.h"
 #include "utils/QFlowLayout.h"
+#include "models/TagDictionary.h"
 
 #include <QLineEdit>
 #include <QCompleter>
@@ -81,8 +82,9 @@ QStringList TagEditorWidget::getTags(bool underscoreFormat) const
 {
     QStringList result;
     bool useUnderscores = underscoreFormat || m_storeTagsWithUnderscores;
-    for (const QString &tag : qAsConst(m_tagsInternal)) {
-        result.append(useUnderscores ? formatTagForStorage(tag) : tag);
+    const TagDictionary &dictionary = TagDictionary::instance();
+    for (quint32 tagId : m_tagIds) {
+        result.append(useUnderscores ? dictionary.underscored(tagId) : dictionary.text(tagId)); // Spellings are precomputed
     }
     return result;
 }
@@ -97,8 +99,8 @@ void TagEditorWidget::setTags(const QStringList &tags, bool inputHasUnderscores)
         } else {
             processedTag = tag.trimmed(); 
         }
-        if (!processedTag.isEmpty() && !m_tagsInternal.contains(processedTag, Qt::CaseInsensitive)) {
-            m_tagsInternal.append(processedTag);
+        if (!processedTag.isEmpty() && indexOfTag(processedTag) < 0) {
+            m_tagIds.append(TagDictionary::instance().intern(processedTag));
         }
     }
     updateDisplayedTags();
@@ -107,10 +109,12 @@ void TagEditorWidget::setTags(const QStringList &tags, bool inputHasUnderscores)
 
 void TagEditorWidget::setKnownTagsVocabulary(const QStringList &vocabularyWithUnderscores)
 {
-    m_knownTagsWithUnderscores = vocabularyWithUnderscores;
+    const TagDictionary &dictionary = TagDictionary::instance();
+    m_knownTagIds = TagDictionary::instance().intern(vocabularyWithUnderscores);
     QStringList displayVocabulary;
-    for (const QString &tag : m_knownTagsWithUnderscores) {
-        displayVocabulary.append(formatTagForDisplay(tag));
+    displayVocabulary.reserve(m_knownTagIds.size());
+    for (quint32 tagId : m_knownTagIds) {
+        displayVocabulary.append(dictionary.spaced(tagId));
     }
     m_tagCompletionModel->setStringList(displayVocabulary);
 }
@@ -121,7 +125,7 @@ void TagEditorWidget::clear()
         delete item->widget(); 
         delete item;
     }
-    m_tagsInternal.clear();
+    m_tagIds.clear();
     m_tagInputLineEdit->clear();
     emit tagsChanged(); 
 }
@@ -161,20 +165,11 @@ void TagEditorWidget::onPillCloseButtonClicked(TagPillWidget *pill)
 {
     if (pill) {
         QString tagToRemove = pill->text().trimmed(); 
-        bool removed = false;
-        for(int i=0; i < m_tagsInternal.size(); ++i) {
-            if(m_tagsInternal.at(i).compare(tagToRemove, Qt::CaseSensitive) == 0) { 
-                m_tagsInternal.removeAt(i);
-                removed = true;
-                break;
-            }
-        }
+        bool removed = m_tagIds.removeOne(TagDictionary::instance().find(tagToRemove)); // Exact spelling first
         if(!removed) { 
-             for (int i = m_tagsInternal.size() - 1; i >= 0; --i) {
-                if (m_tagsInternal.at(i).compare(tagToRemove, Qt::CaseInsensitive) == 0) {
-                    m_tagsInternal.removeAt(i);
-                    removed = true; 
-                }
+            for (int i = indexOfTag(tagToRemove); i >= 0; i = indexOfTag(tagToRemove)) {
+                m_tagIds.removeAt(i);
+                removed = true; 
             }
         }
         removeTagPill(pill);
@@ -211,15 +206,7 @@ void TagEditorWidget::onPillTagEdited(TagPillWidget *pill, const QString &oldTex
         return;
     }
 
-    int foundOldTextIndex = -1;
-    QString actualTextInListMatchingOld;
-    for (int i = 0; i < m_tagsInternal.size(); ++i) {
-        if (m_tagsInternal.at(i).compare(oldTextFromPill, Qt::CaseInsensitive) == 0) {
-            foundOldTextIndex = i;
-            actualTextInListMatchingOld = m_tagsInternal.at(i);
-            break;
-        }
-    }
+    const int foundOldTextIndex = indexOfTag(oldTextFromPill);
 
     if (foundOldTextIndex == -1) {
         pill->setText(oldTextFromPill); 
@@ -227,21 +214,12 @@ void TagEditorWidget::onPillTagEdited(TagPillWidget *pill, const QString &oldTex
         return;
     }
 
-    bool newTextIsDuplicateOfAnother = false;
-    for (int i = 0; i < m_tagsInternal.size(); ++i) {
-        if (i == foundOldTextIndex) { 
-            continue;
-        }
-        if (m_tagsInternal.at(i).compare(newTextFromPill, Qt::CaseInsensitive) == 0) {
-            newTextIsDuplicateOfAnother = true;
-            break;
-        }
-    }
+    const bool newTextIsDuplicateOfAnother = indexOfTag(newTextFromPill, foundOldTextIndex) >= 0;
 
     if (newTextIsDuplicateOfAnother) {
-        pill->setText(actualTextInListMatchingOld); 
+        pill->setText(TagDictionary::instance().text(m_tagIds.at(foundOldTextIndex))); 
     } else {
-        m_tagsInternal[foundOldTextIndex] = newTextFromPill; 
+        m_tagIds[foundOldTextIndex] = TagDictionary::instance().intern(newTextFromPill); 
         emit tagsChanged(); 
     }
 
@@ -254,13 +232,11 @@ void TagEditorWidget::addTagInternal(const QString &tagTextWithSpaces)
     QString cleanTag = tagTextWithSpaces.trimmed();
     if (cleanTag.isEmpty()) return;
 
-    for (const QString &existingTag : qAsConst(m_tagsInternal)) {
-        if (existingTag.compare(cleanTag, Qt::CaseInsensitive) == 0) {
-            return; 
-        }
+    if (indexOfTag(cleanTag) >= 0) {
+        return; 
     }
     
-    m_tagsInternal.append(cleanTag); 
+    m_tagIds.append(TagDictionary::instance().intern(cleanTag)); 
     TagPillWidget *pill = new TagPillWidget(cleanTag, m_tagCompleter, m_tagDisplayArea); 
     connect(pill, &TagPillWidget::closeClicked, this, &TagEditorWidget::onPillCloseButtonClicked);
     connect(pill, &TagPillWidget::tagEdited, this, &TagEditorWidget::onPillTagEdited); 
@@ -284,7 +260,8 @@ void TagEditorWidget::updateDisplayedTags()
         delete item->widget();
         delete item;
     }
-    for (const QString &tagText : qAsConst(m_tagsInternal)) {
+    const QStringList tagTexts = TagDictionary::instance().texts(m_tagIds);
+    for (const QString &tagText : tagTexts) {
         TagPillWidget *pill = new TagPillWidget(tagText, m_tagCompleter, m_tagDisplayArea); 
         connect(pill, &TagPillWidget::closeClicked, this, &TagEditorWidget::onPillCloseButtonClicked);
         connect(pill, &TagPillWidget::tagEdited, this, &TagEditorWidget::onPillTagEdited); 
@@ -297,9 +274,19 @@ QString TagEditorWidget::formatTagForDisplay(const QString &tagWithUnderscores)
     return QString(tagWithUnderscores).replace('_', ' ');
 }
 
-QString TagEditorWidget::formatTagForStorage(const QString &tagWithSpaces) const
+int TagEditorWidget::indexOfTag(const QString &tagText, int skipIndex) const
 {
-    return QString(tagWithSpaces).replace(' ', '_');
+    TagDictionary &dictionary = TagDictionary::instance();
+    const quint32 foldedId = dictionary.findFolded(tagText); // Lookups must not grow the dictionary
+    if (foldedId == TagDictionary::InvalidId) {
+        return -1; // No tag folding to it was ever interned, so none is shown
+    }
+    for (int i = 0; i < m_tagIds.size(); ++i) {
+        if (i != skipIndex && dictionary.foldedId(m_tagIds.at(i)) == foldedId) {
+            return i;
+        }
+    }
+    return -1;
 }
 
 void TagEditorWidget::dragEnterEvent(QDragEnterEvent *event)
@@ -339,14 +326,7 @@ void TagEditorWidget::dropEvent(QDropEvent *event)
         if (sourcePill && sourcePill->parentWidget() == m_tagDisplayArea) {
             QString droppedTagText = event->mimeData()->text();
             
-            int fromIndex = -1;
-            for(int i=0; i < m_tagsInternal.size(); ++i) {
-                if (m_tagsInternal.at(i).compare(droppedTagText, Qt::CaseInsensitive) == 0) {
-                    fromIndex = i;
-                    droppedTagText = m_tagsInternal.at(i); // Use the actual cased string from list
-                    break;
-                }
-            }
+            const int fromIndex = indexOfTag(droppedTagText);
 
             if (fromIndex == -1) {
                 qWarning() << "Drop event: Could not find dragged tag [" << droppedTagText << "] in internal list.";
@@ -355,7 +335,7 @@ void TagEditorWidget::dropEvent(QDropEvent *event)
             }
             
             QPoint displayAreaDropPos = m_tagDisplayArea->mapFrom(this, event->position().toPoint());
-            int toIndex = m_tagsInternal.count(); // Default to end if not dropped on/before another pill
+            int toIndex = m_tagIds.count(); // Default to end if not dropped on/before another pill
 
             for (int i = 0; i < m_flowLayout->count(); ++i) {
                 QWidget *widget = m_flowLayout->itemAt(i)->widget();
@@ -381,15 +361,15 @@ void TagEditorWidget::dropEvent(QDropEvent *event)
                  return;
             }
             
-            QString tagToMove = m_tagsInternal.takeAt(fromIndex);
+            const quint32 tagToMove = m_tagIds.takeAt(fromIndex);
             
             if (toIndex > fromIndex) {
                 toIndex--; 
             }
             if (toIndex < 0) toIndex = 0; 
-            if (toIndex > m_tagsInternal.count()) toIndex = m_tagsInternal.count();
+            if (toIndex > m_tagIds.count()) toIndex = m_tagIds.count();
 
-            m_tagsInternal.insert(toIndex, tagToMove);
+            m_tagIds.insert(toIndex, tagToMove);
             
             updateDisplayedTags(); 
             emit tagsChanged();
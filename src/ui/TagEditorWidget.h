@@ -3,6 +3,7 @@
 
 #include <QWidget>
 #include <QStringList>
+#include <QVector>
 
 QT_BEGIN_NAMESPACE
 class QLineEdit;
@@ -46,9 +47,9 @@ private:
     void removeTagPill(TagPillWidget *pillWidget);
     void updateDisplayedTags();
     QString formatTagForDisplay(const QString &tagWithUnderscores) const;
-    QString formatTagForStorage(const QString &tagWithSpaces) const;
+    int indexOfTag(const QString &tagText, int skipIndex = -1) const; // Ignoring case and '_' vs ' ', -1 if absent
 
-    QList<QString> m_tagsInternal; 
+    QVector<quint32> m_tagIds; // TagDictionary ids of the tags shown, in order
     
     QLineEdit *m_tagInputLineEdit;
     QCompleter *m_tagCompleter;
@@ -58,7 +59,7 @@ private:
     QFlowLayout *m_flowLayout;      
     QScrollArea *m_scrollArea;      
 
-    QStringList m_knownTagsWithUnderscores; 
+    QVector<quint32> m_knownTagIds; // Tagger vocabulary, for completion
     bool m_storeTagsWithUnderscores; 
     QTimer *m_completionTimer; 
 
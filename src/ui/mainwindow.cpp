@@ -7,6 +7,7 @@
 #include "services/AutoCaptionManager.h" 
 #include "ui/TagEditorWidget.h" 
 #include "ui/ThumbnailDelegate.h" // Added
+#include "ui/ModelComparisonDialog.h"
 #include "utils/QFlowLayout.h" 
 
 #include <QApplication>
@@ -54,6 +55,12 @@
 #include <QPushButton>
 #include <QSlider>
 #include <QStyle> 
+#include <QProgressBar>
+#include <algorithm>
+
+namespace {
+const QStringList MediaSuffixes = {"jpg", "jpeg", "png", "bmp", "gif", "webp", "tiff", "mp4", "mkv", "webm"};
+}
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -67,6 +74,10 @@ MainWindow::MainWindow(QWidget *parent)
     , thumbnailListView(nullptr) 
     , m_thumbnailModel(nullptr)  
     , m_thumbnailLoaderService(nullptr) 
+    , m_previewLoader(nullptr)
+    , m_directoryScanner(nullptr)
+    , m_datasetWatcher(nullptr)
+    , m_autoSelectedDuringScan(false)
     , m_bulbButton(nullptr)            
     , m_sparkleActionButton(nullptr)       
     , m_autoCaptionSettingsPanel(nullptr)   
@@ -86,6 +97,10 @@ MainWindow::MainWindow(QWidget *parent)
     , playPauseButton(nullptr)
     , seekerSlider(nullptr)
     , durationLabel(nullptr)
+    , m_bulkCaptionProgressBar(nullptr)
+    , m_bulkCaptionPauseButton(nullptr)
+    , m_bulkCaptionCancelButton(nullptr)
+    , m_thumbnailMemoryLabel(nullptr)
     , mainSplitter(nullptr)
     , rightPanelSplitter(nullptr) 
     , mediaPlayer(nullptr)
@@ -95,6 +110,8 @@ MainWindow::MainWindow(QWidget *parent)
     , thumbnailDefaultSize(180, 100) // Default, can be overridden by settings
     , autoSaveTimer(nullptr)
     , m_scrollStopTimer(nullptr) 
+    , m_lastScrollValue(0)
+    , m_scrollDirection(0)
     , openDirAction(nullptr) 
     , openProjectAction(nullptr)
     , saveProjectAction(nullptr)
@@ -104,6 +121,11 @@ MainWindow::MainWindow(QWidget *parent)
     , aboutQtAction(nullptr)
     , statisticsAction(nullptr)
     , refreshThumbnailsAction(nullptr)
+    , recursiveScanAction(nullptr)
+    , captionAllAction(nullptr)
+    , captionSelectedAction(nullptr)
+    , reapplyThresholdsAction(nullptr)
+    , compareModelVariantsAction(nullptr)
     , m_currentProjectPath("") 
     , m_storeManualTagsWithUnderscores(false) // Initialize setting
 {
@@ -126,12 +148,29 @@ MainWindow::MainWindow(QWidget *parent)
     m_thumbnailLoaderService = new ThumbnailLoader(this);
     m_thumbnailModel->setThumbnailLoader(m_thumbnailLoaderService);
     m_thumbnailModel->setThumbnailSize(thumbnailDefaultSize);
+    // Bounded so 300k-image folders don't keep every thumbnail ever scrolled past; 0 MB compressed = evict straight to the disk cache
+    m_thumbnailModel->setMemoryBudget(settings.value("thumbnailMemoryBudgetMB", 256).toLongLong() * 1024 * 1024,
+                                      settings.value("thumbnailCompressedTierMB", 0).toLongLong() * 1024 * 1024);
 
     m_autoCaptionManager = new AutoCaptionManager(this); 
 
+    m_previewLoader = new PreviewLoader(this);
+    m_previewLoader->setPrefetchDepth(settings.value("previewPrefetchAhead", 3).toInt(), settings.value("previewPrefetchBehind", 1).toInt());
+    connect(m_previewLoader, &PreviewLoader::previewReady, this, &MainWindow::onPreviewReady);
+
+    m_directoryScanner = new DirectoryScanner(this);
+    connect(m_directoryScanner, &DirectoryScanner::batchFound, this, &MainWindow::onScanBatchFound);
+    connect(m_directoryScanner, &DirectoryScanner::finished, this, &MainWindow::onScanFinished);
+    m_datasetWatcher = new DatasetWatcher(this);
+    connect(m_datasetWatcher, &DatasetWatcher::filesAdded, this, &MainWindow::onWatchedFilesAdded);
+    connect(m_datasetWatcher, &DatasetWatcher::filesRemoved, this, &MainWindow::onWatchedFilesRemoved);
+    connect(m_datasetWatcher, &DatasetWatcher::filesRenamed, this, &MainWindow::onWatchedFilesRenamed);
+    connect(m_datasetWatcher, &DatasetWatcher::filesModified, this, &MainWindow::onWatchedFilesModified);
+    connect(m_datasetWatcher, &DatasetWatcher::captionsChanged, this, &MainWindow::onWatchedCaptionsChanged);
+
     m_scrollStopTimer = new QTimer(this);
     m_scrollStopTimer->setSingleShot(true);
-    m_scrollStopTimer->setInterval(500); 
+    m_scrollStopTimer->setInterval(100); // Stale requests are cancelled, so re-prioritizing often is cheap
     connect(m_scrollStopTimer, &QTimer::timeout, this, &MainWindow::loadVisibleThumbnails);
     
     m_fabAutoHideTimer = new QTimer(this);
@@ -174,6 +213,9 @@ MainWindow::MainWindow(QWidget *parent)
         connect(m_autoCaptionManager, &AutoCaptionManager::downloadProgress,
                 m_autoCaptionSettingsPanel, &AutoCaptionSettingsPanel::showDownloadProgress);
     }
+    connect(m_autoCaptionManager, &AutoCaptionManager::bulkCaptionProgress, this, &MainWindow::onBulkCaptionProgress);
+    connect(m_autoCaptionManager, &AutoCaptionManager::bulkCaptionWritten, this, &MainWindow::onBulkCaptionWritten);
+    connect(m_autoCaptionManager, &AutoCaptionManager::bulkCaptionFinished, this, &MainWindow::onBulkCaptionFinished);
     
     if (m_nlpModeRadioMain) {
         connect(m_nlpModeRadioMain, &QRadioButton::toggled, this, &MainWindow::onCaptionEditingModeChanged);
@@ -245,6 +287,7 @@ void MainWindow::setupUI()
     thumbnailListView->setResizeMode(QListView::Adjust); 
     thumbnailListView->setMovement(QListView::Static); 
     thumbnailListView->setWordWrap(true); 
+    thumbnailListView->setSelectionMode(QAbstractItemView::ExtendedSelection); // Allows picking files for bulk captioning
     thumbnailListView->setItemDelegate(new ThumbnailDelegate(thumbnailDefaultSize, this)); // Pass the QSize object
 
     connect(thumbnailListView, &QListView::clicked, this, &MainWindow::onThumbnailViewClicked);
@@ -592,7 +635,13 @@ void MainWindow::onThumbnailViewClicked(const QModelIndex &index) {
     displayMediaAtIndex(index.row());
 }
 void MainWindow::onThumbnailViewScrolled() {
-    if (m_scrollStopTimer) {
+    const int scrollValue = thumbnailListView->verticalScrollBar()->value();
+    if (scrollValue != m_lastScrollValue) {
+        m_scrollDirection = scrollValue > m_lastScrollValue ? 1 : -1;
+        m_lastScrollValue = scrollValue;
+    }
+    // Throttle rather than debounce: during a long fling the viewport is still re-requested every interval
+    if (m_scrollStopTimer && !m_scrollStopTimer->isActive()) {
         m_scrollStopTimer->start(); 
     }
 }
@@ -605,9 +654,11 @@ void MainWindow::loadVisibleThumbnails() {
     int firstVisibleRow = topLeft.isValid() ? topLeft.row() : 0;
     int lastVisibleRow = bottomRight.isValid() ? bottomRight.row() : m_thumbnailModel->rowCount() - 1;
     int buffer = 10; 
-    int startRow = qMax(0, firstVisibleRow - buffer);
-    int endRow = qMin(m_thumbnailModel->rowCount() - 1, lastVisibleRow + buffer);
-    m_thumbnailLoaderService->clearQueue();
+    // Prefetch two more screens in the direction of travel; the loader serves them after the visible rows
+    int prefetch = qMax(buffer, 2 * (lastVisibleRow - firstVisibleRow + 1));
+    int startRow = qMax(0, firstVisibleRow - (m_scrollDirection < 0 ? prefetch : buffer));
+    int endRow = qMin(m_thumbnailModel->rowCount() - 1, lastVisibleRow + (m_scrollDirection > 0 ? prefetch : buffer));
+    m_thumbnailLoaderService->setViewport(firstVisibleRow, lastVisibleRow, m_scrollDirection);
     QList<ThumbnailRequest> requests;
     for (int i = startRow; i <= endRow; ++i) {
         if (!m_thumbnailModel->isThumbnailLoaded(i)) { 
@@ -618,6 +669,17 @@ void MainWindow::loadVisibleThumbnails() {
         m_thumbnailLoaderService->requestThumbnailBatch(requests);
     }
 }
+void MainWindow::updateThumbnailMemoryLabel() {
+    if (!m_thumbnailMemoryLabel || !m_thumbnailModel) {
+        return;
+    }
+    const ThumbnailResidency &residency = m_thumbnailModel->residency();
+    QString text = tr("Thumbnails: %1 (%2 MB)").arg(residency.residentCount()).arg(residency.residentBytes() / (1024.0 * 1024.0), 0, 'f', 1);
+    if (residency.compressedCount() > 0) {
+        text += tr(" + %1 compressed (%2 MB)").arg(residency.compressedCount()).arg(residency.compressedBytes() / (1024.0 * 1024.0), 0, 'f', 1);
+    }
+    m_thumbnailMemoryLabel->setText(text);
+}
 void MainWindow::createMenus() { 
     QMenu *fileMenu = menuBar()->addMenu(tr("&File"));
     openDirAction = new QAction(tr("&Open Directory..."), this);
@@ -637,6 +699,12 @@ void MainWindow::createMenus() {
     saveProjectAsAction = new QAction(tr("Save Project &As..."), this);
     connect(saveProjectAsAction, &QAction::triggered, this, &MainWindow::saveProjectAs);
     fileMenu->addAction(saveProjectAsAction);
+
+    recursiveScanAction = new QAction(tr("Include Sub&folders"), this);
+    recursiveScanAction->setCheckable(true);
+    recursiveScanAction->setChecked(QSettings("KetenganDiffusion", "HaigakuManager").value("scanRecursive", false).toBool());
+    connect(recursiveScanAction, &QAction::toggled, this, &MainWindow::toggleRecursiveScan);
+    fileMenu->addAction(recursiveScanAction);
     
     fileMenu->addSeparator();
     QAction *saveIndividualCaptionAction = new QAction(tr("Save &Caption (current file)"), this); 
@@ -660,6 +728,21 @@ void MainWindow::createMenus() {
     connect(refreshThumbnailsAction, &QAction::triggered, this, &MainWindow::onRefreshThumbnails);
     viewMenu->addAction(refreshThumbnailsAction);
 
+    QMenu *captionMenu = menuBar()->addMenu(tr("&Caption"));
+    captionAllAction = new QAction(tr("Auto-Caption &All Images..."), this);
+    connect(captionAllAction, &QAction::triggered, this, &MainWindow::captionAllFiles);
+    captionMenu->addAction(captionAllAction);
+    captionSelectedAction = new QAction(tr("Auto-Caption &Selected Images..."), this);
+    connect(captionSelectedAction, &QAction::triggered, this, &MainWindow::captionSelectedFiles);
+    captionMenu->addAction(captionSelectedAction);
+    reapplyThresholdsAction = new QAction(tr("&Re-apply Thresholds from Cached Scores..."), this);
+    connect(reapplyThresholdsAction, &QAction::triggered, this, &MainWindow::reapplyCachedThresholds);
+    captionMenu->addAction(reapplyThresholdsAction);
+    captionMenu->addSeparator();
+    compareModelVariantsAction = new QAction(tr("&Compare FP32 and INT8 Tagger..."), this);
+    connect(compareModelVariantsAction, &QAction::triggered, this, &MainWindow::showModelComparisonDialog);
+    captionMenu->addAction(compareModelVariantsAction);
+
     QMenu *statisticMenu = menuBar()->addMenu(tr("&Statistic"));
     statisticsAction = new QAction(tr("Show &Dataset Statistics..."), this);
     connect(statisticsAction, &QAction::triggered, this, &MainWindow::showStatisticsDialog);
@@ -674,6 +757,30 @@ void MainWindow::createMenus() {
 }
 void MainWindow::createStatusBar() { 
     statusBar()->showMessage(tr("Ready"));
+
+    m_bulkCaptionProgressBar = new QProgressBar(this);
+    m_bulkCaptionProgressBar->setMaximumWidth(200);
+    m_bulkCaptionProgressBar->setFormat(tr("%v / %m"));
+    m_bulkCaptionPauseButton = new QToolButton(this);
+    m_bulkCaptionPauseButton->setIcon(style()->standardIcon(QStyle::SP_MediaPause));
+    m_bulkCaptionPauseButton->setToolTip(tr("Pause Captioning"));
+    connect(m_bulkCaptionPauseButton, &QToolButton::clicked, this, &MainWindow::toggleBulkCaptionPause);
+    m_bulkCaptionCancelButton = new QToolButton(this);
+    m_bulkCaptionCancelButton->setIcon(style()->standardIcon(QStyle::SP_DialogCancelButton));
+    m_bulkCaptionCancelButton->setToolTip(tr("Cancel Captioning"));
+    connect(m_bulkCaptionCancelButton, &QToolButton::clicked, m_autoCaptionManager, &AutoCaptionManager::cancelBulkCaption);
+
+    m_thumbnailMemoryLabel = new QLabel(this);
+    statusBar()->addPermanentWidget(m_thumbnailMemoryLabel);
+    connect(m_thumbnailModel, &ThumbnailListModel::residencyChanged, this, &MainWindow::updateThumbnailMemoryLabel);
+    updateThumbnailMemoryLabel();
+
+    statusBar()->addPermanentWidget(m_bulkCaptionProgressBar);
+    statusBar()->addPermanentWidget(m_bulkCaptionPauseButton);
+    statusBar()->addPermanentWidget(m_bulkCaptionCancelButton);
+    m_bulkCaptionProgressBar->setVisible(false); // Only shown while a bulk job runs
+    m_bulkCaptionPauseButton->setVisible(false);
+    m_bulkCaptionCancelButton->setVisible(false);
 }
 void MainWindow::openDirectory() { 
     if (captionChangedSinceLoad && currentMediaIndex >= 0 && currentMediaIndex < mediaFiles.count()) {
@@ -705,15 +812,41 @@ void MainWindow::loadFiles(const QString &dirPath)
     if(mediaPlayer) mediaPlayer->stop();
     mediaFiles.clear(); 
     if(m_thumbnailModel) m_thumbnailModel->clear(); 
+    if(m_previewLoader) m_previewLoader->setFiles(QStringList());
     currentMediaIndex = -1;
     captionChangedSinceLoad = false; 
-    QDir directory(dirPath);
-    QStringList nameFilters;
-    nameFilters << "*.jpg" << "*.jpeg" << "*.png" << "*.bmp" << "*.gif" << "*.webp" << "*.tiff";
-    nameFilters << "*.mp4" << "*.mkv" << "*.webm";
-    QStringList filesFound = directory.entryList(nameFilters, QDir::Files | QDir::NoDotAndDotDot, QDir::Name);
-    if (filesFound.isEmpty()) { 
-        statusBar()->showMessage(tr("No supported media files found in %1").arg(dirPath));
+    m_autoSelectedDuringScan = false;
+    if(m_thumbnailLoaderService) m_thumbnailLoaderService->setDatasetDirectory(dirPath);
+    m_datasetIndex.open(dirPath); // Saves the previous folder's index first
+    if(m_datasetWatcher) m_datasetWatcher->stop(); // Restarted with the complete listing in onScanFinished
+
+    // Listed on a pool thread; rows stream in through onScanBatchFound so the first screen shows up right away
+    const bool recursive = recursiveScanAction && recursiveScanAction->isChecked();
+    m_directoryScanner->start(dirPath, MediaSuffixes, recursive);
+    statusBar()->showMessage(tr("Scanning %1...").arg(dirPath));
+}
+void MainWindow::onScanBatchFound(const QStringList &filePaths) {
+    const bool wasEmpty = mediaFiles.isEmpty();
+    mediaFiles.append(filePaths);
+    if(m_previewLoader) m_previewLoader->appendFiles(filePaths);
+    if(m_thumbnailModel) m_thumbnailModel->appendFilePaths(filePaths);
+    if (wasEmpty && !mediaFiles.isEmpty()) {
+        displayMediaAtIndex(0);
+        m_autoSelectedDuringScan = true; // Cleared as soon as anything else is displayed
+    }
+    if (m_scrollStopTimer && !m_scrollStopTimer->isActive()) {
+        m_scrollStopTimer->start(); // Newly visible rows get thumbnails without waiting for the scan to end
+    }
+    statusBar()->showMessage(tr("Scanning... %1 media files found").arg(mediaFiles.count()));
+}
+void MainWindow::onScanFinished(const QStringList &sortedFilePaths) {
+    if (m_datasetWatcher) {
+        // From here on, files written by other tools show up as single-row changes instead of needing a reload
+        m_datasetWatcher->watch(currentDirectory, MediaSuffixes, recursiveScanAction && recursiveScanAction->isChecked(), sortedFilePaths);
+        m_datasetWatcher->setFocusFile(currentMediaIndex >= 0 ? mediaFiles.value(currentMediaIndex) : QString());
+    }
+    if (sortedFilePaths.isEmpty()) { 
+        statusBar()->showMessage(tr("No supported media files found in %1").arg(currentDirectory));
         if(mediaDisplayContainer && imageScrollArea) mediaDisplayContainer->setCurrentWidget(imageScrollArea);
         if(imageDisplayLabel) { imageDisplayLabel->clear(); imageDisplayLabel->setText(tr("No media files found in directory."));}
         if(videoControlsWidget) videoControlsWidget->setVisible(false);
@@ -724,84 +857,211 @@ void MainWindow::loadFiles(const QString &dirPath)
         if(fileDetailsLabel) fileDetailsLabel->setText(tr("File details will appear here..."));
         return;
     }
-    QStringList fullFilePaths;
-    for(const QString &file : filesFound) {
-        fullFilePaths.append(directory.filePath(file));
-    }
-    mediaFiles = fullFilePaths; 
-    if(m_thumbnailModel) m_thumbnailModel->setFilePaths(fullFilePaths); 
-    if (!mediaFiles.isEmpty()) {
-        displayMediaAtIndex(0);
-        if(thumbnailListView && m_thumbnailModel) {
-            QModelIndex firstIndex = m_thumbnailModel->index(0,0);
-            thumbnailListView->setCurrentIndex(firstIndex);
+
+    if (sortedFilePaths != mediaFiles) {
+        // Batches were sorted individually; put the whole list in order without dropping loaded thumbnails
+        const QString currentPath = currentMediaIndex >= 0 ? mediaFiles.value(currentMediaIndex) : QString();
+        mediaFiles = sortedFilePaths;
+        if(m_thumbnailModel) m_thumbnailModel->reorderFilePaths(sortedFilePaths);
+        if(m_thumbnailLoaderService) m_thumbnailLoaderService->clearQueue(); // Pending requests carry old row numbers
+        if(m_previewLoader) m_previewLoader->setFiles(sortedFilePaths);
+        currentMediaIndex = mediaFiles.indexOf(currentPath);
+        if (m_autoSelectedDuringScan && !captionChangedSinceLoad && currentMediaIndex != 0) {
+            currentMediaIndex = -1;
+            displayMediaAtIndex(0); // The user hasn't moved yet, so start at the real first file
+        } else {
+            if(thumbnailListView && m_thumbnailModel && currentMediaIndex >= 0) {
+                thumbnailListView->setCurrentIndex(m_thumbnailModel->index(currentMediaIndex, 0));
+            }
         }
-        QTimer::singleShot(0, this, &MainWindow::loadVisibleThumbnails); 
     }
+    QTimer::singleShot(0, this, &MainWindow::loadVisibleThumbnails); 
     statusBar()->showMessage(tr("Loaded %1 media files. Thumbnails loading on demand...").arg(mediaFiles.count()));
 }
+void MainWindow::toggleRecursiveScan(bool recursive) {
+    QSettings("KetenganDiffusion", "HaigakuManager").setValue("scanRecursive", recursive);
+    if (!currentDirectory.isEmpty()) {
+        loadFiles(currentDirectory);
+    }
+}
+int MainWindow::rowOfMediaFile(const QString &filePath) const {
+    // mediaFiles is sorted once the scan has finished, which is when the watcher starts
+    auto it = std::lower_bound(mediaFiles.constBegin(), mediaFiles.constEnd(), filePath);
+    return (it != mediaFiles.constEnd() && *it == filePath) ? int(it - mediaFiles.constBegin()) : -1;
+}
+void MainWindow::afterWatchedRowsChanged(const QString &currentPath, int previousIndex) {
+    if(m_thumbnailLoaderService) m_thumbnailLoaderService->clearQueue(); // Pending requests carry old row numbers
+    if(m_previewLoader) m_previewLoader->setFiles(mediaFiles); // Indices shifted
+    if (!currentPath.isEmpty()) {
+        const int row = rowOfMediaFile(currentPath);
+        if (row >= 0) {
+            currentMediaIndex = row; // Still on screen, just at a different row
+            if(thumbnailListView && m_thumbnailModel) thumbnailListView->setCurrentIndex(m_thumbnailModel->index(row, 0));
+        } else if (mediaFiles.isEmpty()) {
+            currentMediaIndex = -1;
+            if(imageDisplayLabel) imageDisplayLabel->clear();
+            if(videoDisplayWidget && mediaPlayer) mediaPlayer->setSource(QUrl());
+            if(videoControlsWidget) videoControlsWidget->setVisible(false);
+            if (captionEditor) captionEditor->clear();
+            if (m_tagEditorWidget) m_tagEditorWidget->clear();
+            if(fileDetailsLabel) fileDetailsLabel->setText(tr("File details will appear here..."));
+        } else {
+            currentMediaIndex = -1;
+            displayMediaAtIndex(qBound(0, previousIndex, int(mediaFiles.count()) - 1)); // The displayed file is gone
+        }
+    }
+    QTimer::singleShot(0, this, &MainWindow::loadVisibleThumbnails);
+}
+void MainWindow::onWatchedFilesAdded(const QStringList &filePaths) {
+    const QString currentPath = currentMediaIndex >= 0 ? mediaFiles.value(currentMediaIndex) : QString();
+    int addedCount = 0;
+    for (const QString &filePath : filePaths) {
+        auto it = std::lower_bound(mediaFiles.begin(), mediaFiles.end(), filePath);
+        if (it != mediaFiles.end() && *it == filePath) continue;
+        const int row = int(it - mediaFiles.begin());
+        mediaFiles.insert(row, filePath);
+        if(m_thumbnailModel) m_thumbnailModel->insertFilePath(row, filePath);
+        ++addedCount;
+    }
+    if (addedCount == 0) return;
+    afterWatchedRowsChanged(currentPath, currentMediaIndex);
+    if (currentPath.isEmpty() && currentMediaIndex < 0 && !mediaFiles.isEmpty()) displayMediaAtIndex(0); // Folder was empty so far
+    statusBar()->showMessage(tr("%n media file(s) added on disk", "", addedCount), 3000);
+}
+void MainWindow::onWatchedFilesRemoved(const QStringList &filePaths) {
+    const QString currentPath = currentMediaIndex >= 0 ? mediaFiles.value(currentMediaIndex) : QString();
+    const int previousIndex = currentMediaIndex;
+    int removedCount = 0;
+    for (const QString &filePath : filePaths) {
+        const int row = rowOfMediaFile(filePath);
+        if (row < 0) continue; // Already dropped, e.g. deleted from within the app
+        mediaFiles.removeAt(row);
+        if(m_thumbnailModel) m_thumbnailModel->removeFilePath(row);
+        unsavedCaptions.remove(filePath);
+        ++removedCount;
+    }
+    if (removedCount == 0) return;
+    afterWatchedRowsChanged(currentPath, previousIndex);
+    statusBar()->showMessage(tr("%n media file(s) removed on disk", "", removedCount), 3000);
+}
+void MainWindow::onWatchedFilesRenamed(const QList<QPair<QString, QString>> &renames) {
+    QString currentPath = currentMediaIndex >= 0 ? mediaFiles.value(currentMediaIndex) : QString();
+    int renamedCount = 0;
+    for (const auto &rename : renames) {
+        const int fromRow = rowOfMediaFile(rename.first);
+        if (fromRow < 0 || rowOfMediaFile(rename.second) >= 0) continue;
+        mediaFiles.removeAt(fromRow);
+        const int toRow = int(std::lower_bound(mediaFiles.begin(), mediaFiles.end(), rename.second) - mediaFiles.begin());
+        mediaFiles.insert(toRow, rename.second);
+        if(m_thumbnailModel) m_thumbnailModel->moveFilePath(fromRow, toRow, rename.second); // Keeps its thumbnail
+        if (unsavedCaptions.contains(rename.first)) unsavedCaptions.insert(rename.second, unsavedCaptions.take(rename.first));
+        if (rename.first == currentPath) {
+            currentPath = rename.second;
+            if(mediaPlayer && !PreviewLoader::isPreviewable(currentPath)) mediaPlayer->setSource(QUrl::fromLocalFile(currentPath));
+            const DatasetIndexEntry indexEntry = m_datasetIndex.refresh(currentPath);
+            updateFileDetails(currentPath, indexEntry.fileSize, indexEntry.dimensions);
+            if(m_datasetWatcher) m_datasetWatcher->setFocusFile(currentPath);
+        }
+        ++renamedCount;
+    }
+    if (renamedCount == 0) return;
+    afterWatchedRowsChanged(currentPath, currentMediaIndex);
+}
+void MainWindow::onWatchedFilesModified(const QStringList &filePaths) {
+    for (const QString &filePath : filePaths) {
+        const int row = rowOfMediaFile(filePath);
+        if (row < 0) continue;
+        if(m_thumbnailModel) m_thumbnailModel->invalidateThumbnail(row); // The disk cache is keyed by mtime, so it re-decodes
+        if (row == currentMediaIndex && m_previewLoader && PreviewLoader::isPreviewable(filePath)) {
+            m_previewLoader->setFiles(mediaFiles); // Drops the stale decode; onPreviewReady shows the new one
+            QSize viewportSize;
+            if (imageScrollArea && imageScrollArea->viewport()) viewportSize = imageScrollArea->viewport()->size();
+            m_previewLoader->request(row, viewportSize, 0);
+        }
+    }
+    QTimer::singleShot(0, this, &MainWindow::loadVisibleThumbnails);
+}
+void MainWindow::onWatchedCaptionsChanged(const QStringList &mediaPaths) {
+    const QString currentPath = currentMediaIndex >= 0 ? mediaFiles.value(currentMediaIndex) : QString();
+    // Same rule as for bulk captioning: only reload if the user has nothing unsaved for this file
+    if (!currentPath.isEmpty() && mediaPaths.contains(currentPath) && !captionChangedSinceLoad && !unsavedCaptions.contains(currentPath)) {
+        loadCaptionForCurrentImage();
+    }
+}
 void MainWindow::displayMediaAtIndex(int index) { 
     if (index < 0 || index >= mediaFiles.count()) { 
         qWarning() << "displayMediaAtIndex: Index out of bounds" << index;
         return;
     }
     if(mediaPlayer) mediaPlayer->stop();
+    m_autoSelectedDuringScan = false;
+    if(m_datasetWatcher) m_datasetWatcher->setFocusFile(mediaFiles.at(index));
+    const int navigationDirection = currentMediaIndex < 0 ? 0 : (index > currentMediaIndex ? 1 : (index < currentMediaIndex ? -1 : 0));
     currentMediaIndex = index;
     QString filePath = mediaFiles.at(currentMediaIndex);
-    QFileInfo fileInfo(filePath);
-    QStringList imageExtensions = {"jpg", "jpeg", "png", "bmp", "gif", "webp", "tiff"};
-    bool isImage = imageExtensions.contains(fileInfo.suffix().toLower());
+    bool isImage = PreviewLoader::isPreviewable(filePath);
+    QSize viewportSize; // Previews are decoded only as large as the viewport can show
+    if (imageScrollArea && imageScrollArea->viewport()) viewportSize = imageScrollArea->viewport()->size();
     if (isImage) {
         if(mediaDisplayContainer && imageScrollArea) mediaDisplayContainer->setCurrentWidget(imageScrollArea);
         if(videoControlsWidget) videoControlsWidget->setVisible(false);
         if(videoDisplayWidget) videoDisplayWidget->setVisible(false); 
         if(imageScrollArea) imageScrollArea->setVisible(true);
-        QImageReader reader(filePath); reader.setAutoTransform(true); QImage image = reader.read();
-        if (image.isNull()) {
-            qWarning() << "Failed to read image:" << filePath << "Error:" << reader.errorString();
-            if(imageDisplayLabel) {
-                imageDisplayLabel->setText(tr("Cannot load image: %1").arg(fileInfo.fileName()));
-                QPixmap errorPixmap(200, 200); errorPixmap.fill(Qt::gray); imageDisplayLabel->setPixmap(errorPixmap);
-            }
-        } else {
-            QPixmap pixmap = QPixmap::fromImage(image);
-            if (!pixmap.isNull() && imageScrollArea && imageScrollArea->viewport()) {
-                QSize viewportSize = imageScrollArea->viewport()->size();
-                if (viewportSize.width() > 0 && viewportSize.height() > 0) 
-                     pixmap = pixmap.scaled(viewportSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
-            }
-            if(imageDisplayLabel) {
-                imageDisplayLabel->setPixmap(pixmap);
-                if (!pixmap.isNull()) imageDisplayLabel->adjustSize(); else imageDisplayLabel->setMinimumSize(1,1);
-            }
+        // Decoded off the GUI thread; onPreviewReady shows it (immediately if it was prefetched)
+        const DatasetIndexEntry indexEntry = m_datasetIndex.refresh(filePath); // Header-only probe, and only if the file changed
+        updateFileDetails(filePath, indexEntry.fileSize, indexEntry.dimensions); // Confirmed again with the decoded image
+        if(imageDisplayLabel) { // Never leave the previous image up next to this file's caption
+            imageDisplayLabel->clear();
+            imageDisplayLabel->setText(tr("Loading %1...").arg(QFileInfo(filePath).fileName()));
         }
+        if (m_previewLoader) m_previewLoader->request(index, viewportSize, navigationDirection); // A cache hit replaces the placeholder right away
     } else { 
         if(mediaDisplayContainer && videoDisplayWidget) mediaDisplayContainer->setCurrentWidget(videoDisplayWidget);
         if(videoControlsWidget) videoControlsWidget->setVisible(true);
         if(imageScrollArea) imageScrollArea->setVisible(false); 
         if(videoDisplayWidget) videoDisplayWidget->setVisible(true);
         if(mediaPlayer) mediaPlayer->setSource(QUrl::fromLocalFile(filePath));
+        updateFileDetails(filePath, m_datasetIndex.refresh(filePath).fileSize);
+        if (m_previewLoader) m_previewLoader->request(index, viewportSize, navigationDirection); // Still prefetches the image neighbours
     }
-    updateFileDetails(filePath);
     loadCaptionForCurrentImage(); 
     if(thumbnailListView && m_thumbnailModel) {
          thumbnailListView->setCurrentIndex(m_thumbnailModel->index(currentMediaIndex, 0));
     }
     statusBar()->showMessage(tr("Displaying: %1 (%2/%3)")
-                             .arg(fileInfo.fileName()).arg(currentMediaIndex + 1).arg(mediaFiles.count()));
+                             .arg(QFileInfo(filePath).fileName()).arg(currentMediaIndex + 1).arg(mediaFiles.count()));
 }
-void MainWindow::updateFileDetails(const QString &filePath) { 
+void MainWindow::updateFileDetails(const QString &filePath, qint64 fileSize, const QSize &resolution) { 
     QFileInfo info(filePath);
-    QString detailsText = QString("<b>File:</b> %1<br><b>Path:</b> %2<br><b>Size:</b> %3 KB")
-                          .arg(info.fileName()).arg(info.absoluteFilePath()).arg(info.size() / 1024);
-    QStringList imageExtensions = {"jpg", "jpeg", "png", "bmp", "gif", "webp", "tiff"};
-    if (imageExtensions.contains(info.suffix().toLower())) {
-        QImageReader reader(filePath);
-        QSize imageSize = reader.size();
-        detailsText += QString("<br><b>Resolution:</b> %1x%2").arg(imageSize.width()).arg(imageSize.height());
+    QString detailsText = QString("<b>File:</b> %1<br><b>Path:</b> %2")
+                          .arg(info.fileName()).arg(info.absoluteFilePath());
+    if (fileSize >= 0) {
+        detailsText += QString("<br><b>Size:</b> %1 KB").arg(fileSize / 1024);
+    }
+    if (resolution.isValid()) {
+        detailsText += QString("<br><b>Resolution:</b> %1x%2").arg(resolution.width()).arg(resolution.height());
     }
     if(fileDetailsLabel) fileDetailsLabel->setText(detailsText);
 }
+void MainWindow::onPreviewReady(int index, const PreviewImage &preview) {
+    if (index != currentMediaIndex || index < 0 || index >= mediaFiles.count() || mediaFiles.at(index) != preview.filePath) {
+        return;
+    }
+    if (preview.image.isNull()) {
+        qWarning() << "Failed to read image:" << preview.filePath << "Error:" << preview.error;
+        if(imageDisplayLabel) {
+            imageDisplayLabel->setText(tr("Cannot load image: %1").arg(QFileInfo(preview.filePath).fileName()));
+            QPixmap errorPixmap(200, 200); errorPixmap.fill(Qt::gray); imageDisplayLabel->setPixmap(errorPixmap);
+        }
+    } else {
+        QPixmap pixmap = QPixmap::fromImage(preview.image); // Already fitted to the viewport
+        if(imageDisplayLabel) {
+            imageDisplayLabel->setPixmap(pixmap);
+            if (!pixmap.isNull()) imageDisplayLabel->adjustSize(); else imageDisplayLabel->setMinimumSize(1,1);
+        }
+    }
+    updateFileDetails(preview.filePath, preview.fileSize, preview.sourceSize);
+}
 void MainWindow::loadCaptionForCurrentImage() { 
     QString captionToLoad = "";
     if (currentMediaIndex >= 0 && currentMediaIndex < mediaFiles.count()) {
@@ -1044,8 +1304,10 @@ void MainWindow::deleteCurrentMediaItem() {
     unsavedCaptions.remove(filePathToDelete);
     mediaFiles.removeAt(currentMediaIndex);
     if (m_thumbnailModel) {
-        m_thumbnailModel->setFilePaths(mediaFiles); 
+        m_thumbnailModel->removeFilePath(currentMediaIndex); // Other rows keep their thumbnails
     }
+    if (m_thumbnailLoaderService) m_thumbnailLoaderService->clearQueue(); // Pending requests carry old row numbers
+    if (m_previewLoader) m_previewLoader->setFiles(mediaFiles); // Indices shifted
     if (mediaFiles.isEmpty()) {
         currentMediaIndex = -1;
         if(imageDisplayLabel) imageDisplayLabel->clear();
@@ -1070,7 +1332,7 @@ void MainWindow::showStatisticsDialog() {
     if (mediaFiles.isEmpty() && currentDirectory.isEmpty()) {
         QMessageBox::information(this, tr("Statistics"), tr("Please open a directory first.")); return;
     }
-    StatisticsDialog dialog(mediaFiles, currentDirectory, this);
+    StatisticsDialog dialog(mediaFiles, currentDirectory, &m_datasetIndex, this);
     dialog.exec();
 }
 void MainWindow::showAboutDialog()  { 
@@ -1136,6 +1398,7 @@ void MainWindow::onRefreshThumbnails()
     }
     if (m_thumbnailLoaderService) {
         m_thumbnailLoaderService->clearQueue(); 
+        m_thumbnailLoaderService->clearDiskCache(); // Refresh means re-decode, not re-read the cache
     }
     loadVisibleThumbnails(); 
     statusBar()->showMessage(tr("Thumbnails refreshed."), 3000);
@@ -1297,3 +1560,150 @@ void MainWindow::handleModelStatusChanged(const QString &status, const QString &
         }
     }
 }
+
+void MainWindow::captionAllFiles()
+{
+    if (mediaFiles.isEmpty()) {
+        QMessageBox::information(this, tr("Auto-Caption"), tr("Please open a directory first.")); return;
+    }
+    startBulkCaption(mediaFiles);
+}
+
+void MainWindow::captionSelectedFiles()
+{
+    QStringList selectedFiles;
+    if (thumbnailListView && thumbnailListView->selectionModel()) {
+        QModelIndexList selectedIndexes = thumbnailListView->selectionModel()->selectedIndexes();
+        std::sort(selectedIndexes.begin(), selectedIndexes.end());
+        for (const QModelIndex &index : selectedIndexes) {
+            if (index.row() >= 0 && index.row() < mediaFiles.count()) {
+                selectedFiles.append(mediaFiles.at(index.row()));
+            }
+        }
+    }
+    if (selectedFiles.isEmpty()) {
+        QMessageBox::information(this, tr("Auto-Caption"), tr("Please select one or more images first.")); return;
+    }
+    startBulkCaption(selectedFiles);
+}
+
+void MainWindow::reapplyCachedThresholds()
+{
+    if (!m_autoCaptionManager) return;
+    if (mediaFiles.isEmpty()) {
+        QMessageBox::information(this, tr("Auto-Caption"), tr("Please open a directory first.")); return;
+    }
+    if (m_autoCaptionManager->isBulkCaptionRunning()) {
+        QMessageBox::information(this, tr("Auto-Caption"), tr("A bulk captioning job is already running.")); return;
+    }
+
+    QStringList imageExtensions = {"jpg", "jpeg", "png", "bmp", "gif", "webp", "tiff"};
+    QStringList imagePaths;
+    for (const QString &filePath : mediaFiles) {
+        if (imageExtensions.contains(QFileInfo(filePath).suffix().toLower())) {
+            imagePaths.append(filePath);
+        }
+    }
+    if (imagePaths.isEmpty()) {
+        QMessageBox::information(this, tr("Auto-Caption"), tr("No images to caption (videos are skipped).")); return;
+    }
+
+    // Only images the loaded model has already scored are rewritten, nothing goes through inference
+    QMessageBox::StandardButton choice = QMessageBox::question(this, tr("Auto-Caption"),
+        tr("Rewrite the captions of %1 images from their cached tagger scores, using the current thresholds and tag order?\n\n"
+           "Images that were never tagged with the loaded model are skipped.").arg(imagePaths.count()),
+        QMessageBox::Yes | QMessageBox::Cancel, QMessageBox::Yes);
+    if (choice != QMessageBox::Yes) return;
+
+    // Pending edits are kept: which images get rewritten is only known per file, and auto-save lets the edit win
+    m_autoCaptionManager->startBulkCaption(imagePaths, true, true);
+}
+
+void MainWindow::startBulkCaption(const QStringList &filePaths)
+{
+    if (!m_autoCaptionManager) return;
+    if (m_autoCaptionManager->isBulkCaptionRunning()) {
+        QMessageBox::information(this, tr("Auto-Caption"), tr("A bulk captioning job is already running.")); return;
+    }
+
+    QStringList imageExtensions = {"jpg", "jpeg", "png", "bmp", "gif", "webp", "tiff"};
+    QStringList imagePaths;
+    for (const QString &filePath : filePaths) {
+        if (imageExtensions.contains(QFileInfo(filePath).suffix().toLower())) {
+            imagePaths.append(filePath);
+        }
+    }
+    if (imagePaths.isEmpty()) {
+        QMessageBox::information(this, tr("Auto-Caption"), tr("No images to caption (videos are skipped).")); return;
+    }
+
+    QMessageBox::StandardButton overwriteChoice = QMessageBox::question(this, tr("Auto-Caption"),
+        tr("Caption %1 images with the loaded model.\n\nOverwrite existing caption files?").arg(imagePaths.count()),
+        QMessageBox::Yes | QMessageBox::No | QMessageBox::Cancel, QMessageBox::No);
+    if (overwriteChoice == QMessageBox::Cancel) return;
+
+    if (overwriteChoice == QMessageBox::Yes) { // Pending edits would otherwise be written over the new captions by auto-save
+        for (const QString &imagePath : imagePaths) {
+            unsavedCaptions.remove(imagePath);
+        }
+    }
+    m_autoCaptionManager->startBulkCaption(imagePaths, overwriteChoice == QMessageBox::Yes);
+}
+
+void MainWindow::toggleBulkCaptionPause()
+{
+    if (!m_autoCaptionManager || !m_autoCaptionManager->isBulkCaptionRunning()) return;
+    if (m_autoCaptionManager->isBulkCaptionPaused()) {
+        m_autoCaptionManager->resumeBulkCaption();
+        m_bulkCaptionPauseButton->setIcon(style()->standardIcon(QStyle::SP_MediaPause));
+        m_bulkCaptionPauseButton->setToolTip(tr("Pause Captioning"));
+    } else {
+        m_autoCaptionManager->pauseBulkCaption();
+        m_bulkCaptionPauseButton->setIcon(style()->standardIcon(QStyle::SP_MediaPlay));
+        m_bulkCaptionPauseButton->setToolTip(tr("Resume Captioning"));
+    }
+}
+
+void MainWindow::onBulkCaptionProgress(int processed, int total)
+{
+    if (!m_bulkCaptionProgressBar) return;
+    if (!m_bulkCaptionProgressBar->isVisible()) {
+        m_bulkCaptionPauseButton->setIcon(style()->standardIcon(QStyle::SP_MediaPause));
+        m_bulkCaptionPauseButton->setToolTip(tr("Pause Captioning"));
+        m_bulkCaptionProgressBar->setVisible(true);
+        m_bulkCaptionPauseButton->setVisible(true);
+        m_bulkCaptionCancelButton->setVisible(true);
+    }
+    m_bulkCaptionProgressBar->setRange(0, total);
+    m_bulkCaptionProgressBar->setValue(processed);
+}
+
+void MainWindow::onBulkCaptionWritten(const QString &imagePath)
+{
+    // Refresh the editor if the caption of the displayed image was just written and the user has not touched it
+    if (currentMediaIndex >= 0 && currentMediaIndex < mediaFiles.count() && mediaFiles.at(currentMediaIndex) == imagePath &&
+        !captionChangedSinceLoad && !unsavedCaptions.contains(imagePath)) {
+        loadCaptionForCurrentImage();
+    }
+}
+
+void MainWindow::onBulkCaptionFinished(int written, int skipped, int failed, bool cancelled)
+{
+    if (m_bulkCaptionProgressBar) {
+        m_bulkCaptionProgressBar->setVisible(false);
+        m_bulkCaptionPauseButton->setVisible(false);
+        m_bulkCaptionCancelButton->setVisible(false);
+    }
+    QString summary = tr("%1 captions written, %2 skipped, %3 failed.").arg(written).arg(skipped).arg(failed);
+    statusBar()->showMessage(cancelled ? tr("Bulk captioning cancelled. %1").arg(summary)
+                                       : tr("Bulk captioning finished. %1").arg(summary), 10000);
+}
+
+void MainWindow::showModelComparisonDialog()
+{
+    if (!m_autoCaptionManager) return;
+    QString currentModel = "SmilingWolf/wd-vit-tagger-v3";
+    ModelComparisonDialog dialog(AutoCaptionManager::modelDirectory(currentModel), currentDirectory,
+                                 m_autoCaptionManager->getModelSettings(), this);
+    dialog.exec();
+}
@@ -10,6 +10,10 @@
 #include "services/ThumbnailLoader.h"  
 #include "ui/AutoCaptionSettingsPanel.h" 
 #include "services/AutoCaptionManager.h"
+#include "services/PreviewLoader.h"
+#include "services/DirectoryScanner.h"
+#include "services/DatasetIndex.h"
+#include "services/DatasetWatcher.h"
 #include "ui/TagEditorWidget.h" // Added
 
 // Forward declarations
@@ -31,6 +35,7 @@ class QStackedWidget;
 class QToolBar; 
 class QPropertyAnimation; 
 class QGraphicsOpacityEffect; 
+class QProgressBar; 
 QT_END_NAMESPACE
 
 class MainWindow : public QMainWindow
@@ -69,15 +74,38 @@ private slots:
     void saveProject();          
     void saveProjectAs();        
 
+    // Bulk auto-captioning
+    void captionAllFiles();
+    void captionSelectedFiles();
+    void reapplyCachedThresholds();
+    void toggleBulkCaptionPause();
+    void onBulkCaptionProgress(int processed, int total);
+    void onBulkCaptionWritten(const QString &imagePath);
+    void onBulkCaptionFinished(int written, int skipped, int failed, bool cancelled);
+    void showModelComparisonDialog();
+    void updateThumbnailMemoryLabel();
+    void onPreviewReady(int index, const PreviewImage &preview);
+    void onScanBatchFound(const QStringList &filePaths);
+    void onScanFinished(const QStringList &sortedFilePaths);
+    void toggleRecursiveScan(bool recursive);
+    void onWatchedFilesAdded(const QStringList &filePaths);
+    void onWatchedFilesRemoved(const QStringList &filePaths);
+    void onWatchedFilesRenamed(const QList<QPair<QString, QString>> &renames);
+    void onWatchedFilesModified(const QStringList &filePaths);
+    void onWatchedCaptionsChanged(const QStringList &mediaPaths);
+
 private:
     void setupUI();
     void createMenus();
     void createStatusBar();
     void loadFiles(const QString &dirPath);
-    void updateFileDetails(const QString &filePath);
+    void updateFileDetails(const QString &filePath, qint64 fileSize, const QSize &resolution = QSize());
     void loadCaptionForCurrentImage();
     void saveCurrentCaption(); 
     void applyScoreToCaption(int score); 
+    void startBulkCaption(const QStringList &filePaths);
+    int rowOfMediaFile(const QString &filePath) const; // Binary search, -1 if not listed
+    void afterWatchedRowsChanged(const QString &currentPath, int previousIndex);
 
 
     // UI Elements
@@ -97,6 +125,11 @@ private:
     // Thumbnail Handling
     ThumbnailListModel *m_thumbnailModel;
     ThumbnailLoader *m_thumbnailLoaderService;
+    PreviewLoader *m_previewLoader; // Main-view image decoding and prefetch
+    DirectoryScanner *m_directoryScanner;
+    DatasetWatcher *m_datasetWatcher; // Applies outside changes to the folder as row-level updates
+    DatasetIndex m_datasetIndex; // <dataset>/.haigaku/index.bin, saved on folder switch and exit
+    bool m_autoSelectedDuringScan; // First file was picked for the user while the scan was still unsorted
 
     // Auto Captioning UI & Logic
     QToolButton *m_sparkleActionButton;          
@@ -124,6 +157,12 @@ private:
     QSlider *seekerSlider;
     QLabel *durationLabel;
 
+    // Bulk captioning status bar controls
+    QProgressBar *m_bulkCaptionProgressBar;
+    QToolButton *m_bulkCaptionPauseButton;
+    QToolButton *m_bulkCaptionCancelButton;
+    QLabel *m_thumbnailMemoryLabel; // Resident thumbnail count / bytes
+
 
     QSplitter *mainSplitter;
     QSplitter *rightPanelSplitter; 
@@ -143,6 +182,8 @@ private:
     QMap<QString, QString> unsavedCaptions; 
     QTimer *autoSaveTimer;
     QTimer *m_scrollStopTimer; 
+    int m_lastScrollValue;
+    int m_scrollDirection; // -1 up, 1 down, 0 before any scrolling
 
     // Menu actions
     QAction *openDirAction;
@@ -154,6 +195,11 @@ private:
     QAction *aboutQtAction; 
     QAction *statisticsAction; 
     QAction *refreshThumbnailsAction; 
+    QAction *recursiveScanAction;
+    QAction *captionAllAction;
+    QAction *captionSelectedAction;
+    QAction *reapplyThresholdsAction;
+    QAction *compareModelVariantsAction;
 
     bool m_storeManualTagsWithUnderscores; // User preference for tag storage
 
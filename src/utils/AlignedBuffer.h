@@ -0,0 +1,78 @@
+#ifndef ALIGNEDBUFFER_H
+#define ALIGNEDBUFFER_H
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Grow-only scratch storage for tensor data, aligned to a cache line (and to any SIMD width we use).
+// resize() only allocates when the buffer has to grow, so one buffer reused across batches stops
+// allocating once it has seen the largest batch. Contents are not preserved when it grows. Move-only.
+template <typename T>
+class AlignedBuffer
+{
+    static_assert(std::is_trivial<T>::value, "AlignedBuffer holds plain numeric data only");
+
+public:
+    static constexpr size_t Alignment = 64;
+
+    AlignedBuffer() : m_data(nullptr), m_size(0), m_capacity(0) {}
+    ~AlignedBuffer() { release(); }
+
+    AlignedBuffer(AlignedBuffer &&other) noexcept
+        : m_data(std::exchange(other.m_data, nullptr))
+        , m_size(std::exchange(other.m_size, 0))
+        , m_capacity(std::exchange(other.m_capacity, 0))
+    {
+    }
+
+    AlignedBuffer &operator=(AlignedBuffer &&other) noexcept
+    {
+        if (this != &other) {
+            release();
+            m_data = std::exchange(other.m_data, nullptr);
+            m_size = std::exchange(other.m_size, 0);
+            m_capacity = std::exchange(other.m_capacity, 0);
+        }
+        return *this;
+    }
+
+    AlignedBuffer(const AlignedBuffer &) = delete;
+    AlignedBuffer &operator=(const AlignedBuffer &) = delete;
+
+    void resize(size_t count)
+    {
+        if (count > m_capacity) {
+            release();
+            m_data = static_cast<T *>(::operator new(count * sizeof(T), std::align_val_t(Alignment)));
+            m_capacity = count;
+        }
+        m_size = count;
+    }
+
+    T *data() { return m_data; }
+    const T *data() const { return m_data; }
+    size_t size() const { return m_size; }
+    size_t capacity() const { return m_capacity; }
+    bool empty() const { return m_size == 0; }
+    T *begin() { return m_data; }
+    T *end() { return m_data + m_size; }
+
+private:
+    void release()
+    {
+        if (m_data) {
+            ::operator delete(m_data, std::align_val_t(Alignment));
+        }
+        m_data = nullptr;
+        m_size = 0;
+        m_capacity = 0;
+    }
+
+    T *m_data;
+    size_t m_size;
+    size_t m_capacity;
+};
+
+#endif // ALIGNEDBUFFER_H
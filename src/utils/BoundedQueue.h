@@ -0,0 +1,82 @@
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QVector>
+#include <utility>
+
+// Blocking FIFO with a fixed capacity for handing work between producer and consumer threads.
+// push() blocks while the queue is full, popBatch() blocks while it is empty.
+// close() wakes every waiter: later pushes are rejected and popBatch() drains what is left.
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(int capacity) : m_capacity(qMax(1, capacity)), m_closed(false) {}
+
+    bool push(T item)
+    {
+        QMutexLocker locker(&m_mutex);
+        while (!m_closed && m_items.size() >= m_capacity) {
+            m_notFull.wait(&m_mutex);
+        }
+        if (m_closed) {
+            return false;
+        }
+        m_items.enqueue(std::move(item));
+        m_notEmpty.wakeOne();
+        return true;
+    }
+
+    // Waits for at least one item, then takes up to maxItems without waiting any longer.
+    // Returns an empty vector once the queue is closed and drained.
+    QVector<T> popBatch(int maxItems)
+    {
+        QVector<T> batch;
+        QMutexLocker locker(&m_mutex);
+        while (!m_closed && m_items.isEmpty()) {
+            m_notEmpty.wait(&m_mutex);
+        }
+        while (!m_items.isEmpty() && batch.size() < maxItems) {
+            batch.append(m_items.dequeue());
+        }
+        if (!batch.isEmpty()) {
+            m_notFull.wakeAll();
+        }
+        return batch;
+    }
+
+    void close()
+    {
+        QMutexLocker locker(&m_mutex);
+        m_closed = true;
+        m_notEmpty.wakeAll();
+        m_notFull.wakeAll();
+    }
+
+    void clear()
+    {
+        QMutexLocker locker(&m_mutex);
+        m_items.clear();
+        m_notFull.wakeAll();
+    }
+
+    bool isClosed() const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_closed;
+    }
+
+private:
+    mutable QMutex m_mutex;
+    QWaitCondition m_notEmpty;
+    QWaitCondition m_notFull;
+    QQueue<T> m_items;
+    int m_capacity;
+    bool m_closed;
+};
+
+#endif // BOUNDEDQUEUE_H
@@ -0,0 +1,283 @@
+#include "ExifThumbnailReader.h"
+#include "ImageHeaderProbe.h"
+#include <QFile>
+#include <QTransform>
+#include <QImageIOHandler>
+#include <cstring>
+
+namespace ExifThumbnailReader {
+
+namespace {
+
+const int MaxHeaderBytes = 64 * 1024 + 16; // SOI + a full APP1 segment
+const int PaddingTolerance = 24;            // Per channel, for bars that went through JPEG compression
+const int MaxOrientationSegments = 16;      // Exif APP1 follows SOI (and at most an APP0) in practice
+
+// Bounds-checked TIFF reader over the APP1 payload
+class TiffView
+{
+public:
+    TiffView(const uchar *data, int size) : m_data(data), m_size(size), m_bigEndian(false) {}
+
+    bool init()
+    {
+        if (m_size < 8) return false;
+        if (m_data[0] == 'I' && m_data[1] == 'I') m_bigEndian = false;
+        else if (m_data[0] == 'M' && m_data[1] == 'M') m_bigEndian = true;
+        else return false;
+        return u16(2) == 42;
+    }
+
+    bool inRange(qint64 offset, qint64 length) const { return offset >= 0 && length >= 0 && offset + length <= m_size; }
+
+    quint32 u16(qint64 offset) const
+    {
+        if (!inRange(offset, 2)) return 0;
+        const uchar *p = m_data + offset;
+        return m_bigEndian ? (quint32(p[0]) << 8) | p[1] : (quint32(p[1]) << 8) | p[0];
+    }
+
+    quint32 u32(qint64 offset) const
+    {
+        if (!inRange(offset, 4)) return 0;
+        const uchar *p = m_data + offset;
+        return m_bigEndian ? (quint32(p[0]) << 24) | (quint32(p[1]) << 16) | (quint32(p[2]) << 8) | p[3]
+                           : (quint32(p[3]) << 24) | (quint32(p[2]) << 16) | (quint32(p[1]) << 8) | p[0];
+    }
+
+    // Value of a SHORT or LONG entry (both fit in the 4-byte value field)
+    quint32 entryValue(qint64 entryOffset) const
+    {
+        const quint32 type = u16(entryOffset + 2);
+        return type == 3 ? u16(entryOffset + 8) : u32(entryOffset + 8);
+    }
+
+    template <typename Visitor>
+    quint32 walkIfd(quint32 ifdOffset, Visitor visit) const // Returns the next IFD offset
+    {
+        if (!inRange(ifdOffset, 2)) return 0;
+        const quint32 entryCount = u16(ifdOffset);
+        if (!inRange(ifdOffset + 2, qint64(entryCount) * 12 + 4)) return 0;
+        for (quint32 i = 0; i < entryCount; ++i) {
+            const qint64 entry = ifdOffset + 2 + qint64(i) * 12;
+            visit(u16(entry), entry);
+        }
+        return u32(ifdOffset + 2 + qint64(entryCount) * 12);
+    }
+
+    quint32 firstIfd() const { return u32(4); }
+
+private:
+    const uchar *m_data;
+    int m_size;
+    bool m_bigEndian;
+};
+
+// Same mapping as Qt's JPEG handler uses for QImageReader::setAutoTransform
+QImageIOHandler::Transformations transformationsForOrientation(int orientation)
+{
+    switch (orientation) {
+    case 2: return QImageIOHandler::TransformationMirror;
+    case 3: return QImageIOHandler::TransformationRotate180;
+    case 4: return QImageIOHandler::TransformationFlip;
+    case 5: return QImageIOHandler::TransformationFlipAndRotate90;
+    case 6: return QImageIOHandler::TransformationRotate90;
+    case 7: return QImageIOHandler::TransformationMirrorAndRotate90;
+    case 8: return QImageIOHandler::TransformationRotate270;
+    default: return QImageIOHandler::TransformationNone;
+    }
+}
+
+// Applied in the same order as Qt does on the decode path, so a thumbnail from the EXIF block and
+// one from the full image come out oriented alike
+QImage applyOrientation(const QImage &image, int orientation)
+{
+    const QImageIOHandler::Transformations transformations = transformationsForOrientation(orientation);
+    if (transformations == QImageIOHandler::TransformationNone) {
+        return image;
+    }
+    if (transformations == QImageIOHandler::TransformationRotate270) {
+        return image.transformed(QTransform().rotate(270));
+    }
+    QImage oriented = image.mirrored(transformations.testFlag(QImageIOHandler::TransformationMirror),
+                                     transformations.testFlag(QImageIOHandler::TransformationFlip));
+    if (transformations.testFlag(QImageIOHandler::TransformationRotate90)) {
+        oriented = oriented.transformed(QTransform().rotate(90));
+    }
+    return oriented;
+}
+
+// True if everything outside content is one flat colour (letterbox bars), within JPEG noise
+bool isPadding(const QImage &image, const QRect &content)
+{
+    const QImage pixels = image.convertToFormat(QImage::Format_RGB32);
+    const QRgb reference = pixels.pixel(0, 0);
+    for (int y = 0; y < pixels.height(); ++y) {
+        const QRgb *line = reinterpret_cast<const QRgb *>(pixels.constScanLine(y));
+        for (int x = 0; x < pixels.width(); ++x) {
+            if (content.contains(x, y)) {
+                continue;
+            }
+            if (qAbs(qRed(line[x]) - qRed(reference)) > PaddingTolerance
+                || qAbs(qGreen(line[x]) - qGreen(reference)) > PaddingTolerance
+                || qAbs(qBlue(line[x]) - qBlue(reference)) > PaddingTolerance) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+bool parse(const uchar *data, int size, ExifThumbnailInfo *info)
+{
+    if (!data || !info || size < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+        return false;
+    }
+
+    // Walk the marker segments up to the first APP1 carrying "Exif\0\0"
+    int position = 2;
+    while (position + 4 <= size) {
+        if (data[position] != 0xFF) return false;
+        const uchar marker = data[position + 1];
+        if (marker == 0xD8 || marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) { position += 2; continue; } // No length field
+        if (marker == 0xDA || marker == 0xD9) return false; // Image data reached without EXIF
+        const int segmentLength = (data[position + 2] << 8) | data[position + 3];
+        const int payload = position + 4;
+        if (segmentLength < 2) return false;
+        if (marker == 0xE1 && segmentLength >= 8 && payload + 6 <= size && memcmp(data + payload, "Exif\0\0", 6) == 0) {
+            const int tiffStart = payload + 6;
+            const int tiffSize = qMin(size, position + 2 + segmentLength) - tiffStart;
+            TiffView tiff(data + tiffStart, tiffSize);
+            if (!tiff.init()) return false;
+
+            ExifThumbnailInfo result;
+            quint32 exifIfd = 0;
+            const quint32 ifd1 = tiff.walkIfd(tiff.firstIfd(), [&](quint32 tag, qint64 entry) {
+                if (tag == 0x0112) result.orientation = int(tiff.entryValue(entry));
+                else if (tag == 0x8769) exifIfd = tiff.entryValue(entry);
+            });
+            if (exifIfd != 0) {
+                tiff.walkIfd(exifIfd, [&](quint32 tag, qint64 entry) {
+                    if (tag == 0xA002) result.pixelWidth = int(tiff.entryValue(entry));
+                    else if (tag == 0xA003) result.pixelHeight = int(tiff.entryValue(entry));
+                });
+            }
+            if (ifd1 == 0) return false;
+
+            quint32 thumbnailOffset = 0;
+            quint32 thumbnailLength = 0;
+            quint32 compression = 6;
+            tiff.walkIfd(ifd1, [&](quint32 tag, qint64 entry) {
+                if (tag == 0x0201) thumbnailOffset = tiff.entryValue(entry);
+                else if (tag == 0x0202) thumbnailLength = tiff.entryValue(entry);
+                else if (tag == 0x0103) compression = tiff.entryValue(entry);
+            });
+            if (compression != 6 || thumbnailOffset == 0 || thumbnailLength == 0
+                || !tiff.inRange(thumbnailOffset, thumbnailLength)) {
+                return false; // Uncompressed (TIFF strip) thumbnails are rare, not worth supporting
+            }
+            if (result.orientation < 1 || result.orientation > 8) result.orientation = 1;
+            result.offset = tiffStart + int(thumbnailOffset);
+            result.length = int(thumbnailLength);
+            *info = result;
+            return true;
+        }
+        position += 2 + segmentLength;
+    }
+    return false;
+}
+
+QImage read(const QString &filePath, const QSize &boundingSize)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QImage();
+    }
+    const QByteArray header = file.read(MaxHeaderBytes);
+    ExifThumbnailInfo info;
+    if (!parse(reinterpret_cast<const uchar *>(header.constData()), int(header.size()), &info)) {
+        return QImage();
+    }
+
+    // Tools that crop or resize but copy the EXIF block through leave the old thumbnail behind, so it
+    // has to agree with the frame that is actually stored
+    const QSize frameSize = ImageHeaderProbe::probeJpeg(file);
+    if (!frameSize.isValid()) {
+        return QImage();
+    }
+    if (info.pixelWidth > 0 && info.pixelHeight > 0 && QSize(info.pixelWidth, info.pixelHeight) != frameSize) {
+        return QImage(); // Edited after the camera wrote the EXIF block
+    }
+
+    QImage thumbnail = QImage::fromData(reinterpret_cast<const uchar *>(header.constData()) + info.offset, info.length, "JPG");
+    if (thumbnail.isNull()) {
+        return QImage();
+    }
+
+    const QSize fitted = frameSize.scaled(thumbnail.size(), Qt::KeepAspectRatio);
+    if (fitted.isEmpty()) {
+        return QImage();
+    }
+    if (qAbs(fitted.width() - thumbnail.width()) > 1 || qAbs(fitted.height() - thumbnail.height()) > 1) {
+        // Cameras pad thumbnails to 4:3 or 16:9; crop the bars back to the main image's aspect ratio.
+        // Any other aspect mismatch means the picture itself no longer matches.
+        const QRect content((thumbnail.width() - fitted.width()) / 2, (thumbnail.height() - fitted.height()) / 2,
+                            fitted.width(), fitted.height());
+        if (!isPadding(thumbnail, content)) {
+            return QImage();
+        }
+        thumbnail = thumbnail.copy(content);
+    }
+    thumbnail = applyOrientation(thumbnail, info.orientation);
+
+    // Only usable if it doesn't need upscaling to fill the requested box
+    const QSize needed = thumbnail.size().scaled(boundingSize, Qt::KeepAspectRatio);
+    if (thumbnail.width() < needed.width() || thumbnail.height() < needed.height()) {
+        return QImage();
+    }
+    return thumbnail;
+}
+
+int readOrientation(const QString &filePath)
+{
+    QFile file(filePath);
+    uchar segment[4];
+    if (!file.open(QIODevice::ReadOnly) || file.read(reinterpret_cast<char *>(segment), 2) != 2
+        || segment[0] != 0xFF || segment[1] != 0xD8) {
+        return 1;
+    }
+    qint64 position = 2;
+    for (int i = 0; i < MaxOrientationSegments; ++i) {
+        if (!file.seek(position) || file.read(reinterpret_cast<char *>(segment), 4) != 4 || segment[0] != 0xFF) {
+            return 1;
+        }
+        const uchar marker = segment[1];
+        if (marker == 0xFF) {
+            position += 1; // Fill byte
+            continue;
+        }
+        const int segmentLength = (segment[2] << 8) | segment[3];
+        if (marker == 0xDA || marker == 0xD9 || segmentLength < 2) {
+            return 1; // Image data reached without EXIF
+        }
+        if (marker == 0xE1 && segmentLength >= 8) {
+            const QByteArray payload = file.read(segmentLength - 2);
+            if (payload.size() >= 6 && memcmp(payload.constData(), "Exif\0\0", 6) == 0) {
+                TiffView tiff(reinterpret_cast<const uchar *>(payload.constData()) + 6, int(payload.size()) - 6);
+                int orientation = 1;
+                if (tiff.init()) {
+                    tiff.walkIfd(tiff.firstIfd(), [&](quint32 tag, qint64 entry) {
+                        if (tag == 0x0112) orientation = int(tiff.entryValue(entry));
+                    });
+                }
+                return orientation >= 1 && orientation <= 8 ? orientation : 1;
+            }
+        }
+        position += 2 + segmentLength;
+    }
+    return 1;
+}
+
+} // namespace ExifThumbnailReader
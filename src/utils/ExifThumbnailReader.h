@@ -0,0 +1,39 @@
+#ifndef EXIFTHUMBNAILREADER_H
+#define EXIFTHUMBNAILREADER_H
+
+#include <QImage>
+#include <QSize>
+#include <QString>
+
+// Where the embedded JPEG thumbnail (EXIF IFD1) sits inside a file's first bytes, plus the
+// metadata needed to judge whether it can stand in for the real image.
+struct ExifThumbnailInfo {
+    int offset = 0;       // Byte offset of the thumbnail JPEG from the start of the buffer
+    int length = 0;
+    int orientation = 1;  // EXIF orientation (1-8) of the main image, which the thumbnail shares
+    int pixelWidth = 0;   // Main image size from the Exif sub-IFD, 0 if absent
+    int pixelHeight = 0;
+};
+
+// Reads EXIF thumbnails out of JPEG files with a single small read (APP1 is capped at 64 KB),
+// so browsing a freshly imported folder doesn't pull whole camera files off disk.
+namespace ExifThumbnailReader {
+
+// Pure parser, no I/O: data must start with the JPEG SOI marker
+bool parse(const uchar *data, int size, ExifThumbnailInfo *info);
+
+// Returns the embedded thumbnail, oriented like the main image and with letterbox bars cropped,
+// if it covers boundingSize (aspect kept) and still matches the stored frame (SOF size, and the
+// Exif pixel size when present). Otherwise returns a null image and the caller decodes the file.
+QImage read(const QString &filePath, const QSize &boundingSize);
+
+// EXIF orientation (1-8) of a JPEG file, 1 if it has none or isn't a JPEG. Seeks over the segments
+// in front of APP1 and reads only the Exif block, thumbnail or not.
+int readOrientation(const QString &filePath);
+
+// Orientations 5-8 rotate by 90 degrees, so the displayed size is the stored one transposed
+inline bool swapsAxes(int orientation) { return orientation >= 5 && orientation <= 8; }
+
+} // namespace ExifThumbnailReader
+
+#endif // EXIFTHUMBNAILREADER_H
@@ -0,0 +1,132 @@
+#include "ImageHeaderProbe.h"
+#include <QFile>
+#include <QImageReader>
+#include <cstring>
+
+namespace ImageHeaderProbe {
+
+namespace {
+
+const int HeaderBytes = 64;           // Enough for every fixed-layout header below
+const int MaxJpegSegments = 64;       // A frame header further in than this is not a well-formed file
+
+quint32 be16(const uchar *p) { return (quint32(p[0]) << 8) | p[1]; }
+quint32 be32(const uchar *p) { return (quint32(p[0]) << 24) | (quint32(p[1]) << 16) | (quint32(p[2]) << 8) | p[3]; }
+quint32 le16(const uchar *p) { return (quint32(p[1]) << 8) | p[0]; }
+quint32 le24(const uchar *p) { return (quint32(p[2]) << 16) | (quint32(p[1]) << 8) | p[0]; }
+quint32 le32(const uchar *p) { return (quint32(p[3]) << 24) | (quint32(p[2]) << 16) | (quint32(p[1]) << 8) | p[0]; }
+
+bool isJpeg(const uchar *data, int size) { return size >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF; }
+
+bool isStartOfFrame(uchar marker)
+{
+    // SOF0..SOF15 minus DHT (C4), JPG (C8) and DAC (CC), which share the range
+    return marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+}
+
+QSize validSize(qint64 width, qint64 height)
+{
+    return (width > 0 && height > 0 && width <= 1 << 20 && height <= 1 << 20) ? QSize(int(width), int(height)) : QSize();
+}
+
+} // namespace
+
+QSize probeJpeg(QFile &file)
+{
+    qint64 position = 2;
+    uchar segment[9];
+    for (int i = 0; i < MaxJpegSegments; ++i) {
+        if (!file.seek(position) || file.read(reinterpret_cast<char *>(segment), 4) != 4) {
+            return QSize();
+        }
+        if (segment[0] != 0xFF) {
+            return QSize();
+        }
+        if (segment[1] == 0xFF) {
+            position += 1; // Fill byte
+            continue;
+        }
+        const quint32 length = be16(segment + 2);
+        if (isStartOfFrame(segment[1])) {
+            if (file.read(reinterpret_cast<char *>(segment + 4), 5) != 5) {
+                return QSize();
+            }
+            return validSize(be16(segment + 7), be16(segment + 5)); // Precision, height, width
+        }
+        if (segment[1] == 0xD9 || segment[1] == 0xDA || length < 2) {
+            return QSize(); // End of image or scan data before any frame header
+        }
+        position += 2 + length;
+    }
+    return QSize();
+}
+
+QSize parse(const uchar *data, int size)
+{
+    if (size >= 24 && memcmp(data, "\x89PNG\r\n\x1a\n", 8) == 0 && memcmp(data + 12, "IHDR", 4) == 0) {
+        return validSize(be32(data + 16), be32(data + 20));
+    }
+    if (size >= 10 && (memcmp(data, "GIF87a", 6) == 0 || memcmp(data, "GIF89a", 6) == 0)) {
+        return validSize(le16(data + 6), le16(data + 8));
+    }
+    if (size >= 26 && data[0] == 'B' && data[1] == 'M') {
+        if (le32(data + 14) == 12) {
+            return validSize(le16(data + 18), le16(data + 20)); // OS/2 BITMAPCOREHEADER
+        }
+        const qint32 height = qint32(le32(data + 22)); // Negative for top-down bitmaps
+        return validSize(qint32(le32(data + 18)), height < 0 ? -qint64(height) : height);
+    }
+    if (size >= 30 && memcmp(data, "RIFF", 4) == 0 && memcmp(data + 8, "WEBP", 4) == 0) {
+        if (memcmp(data + 12, "VP8 ", 4) == 0 && data[23] == 0x9D && data[24] == 0x01 && data[25] == 0x2A) {
+            return validSize(le16(data + 26) & 0x3FFF, le16(data + 28) & 0x3FFF);
+        }
+        if (memcmp(data + 12, "VP8L", 4) == 0 && data[20] == 0x2F) {
+            const quint32 bits = le32(data + 21);
+            return validSize((bits & 0x3FFF) + 1, ((bits >> 14) & 0x3FFF) + 1);
+        }
+        if (memcmp(data + 12, "VP8X", 4) == 0) {
+            return validSize(le24(data + 24) + 1, le24(data + 27) + 1);
+        }
+        return QSize();
+    }
+    if (size >= 4 && isJpeg(data, size)) {
+        // Frame header within the buffer (no EXIF in front of it); probe() seeks for the other case
+        int position = 2;
+        while (position + 9 <= size && data[position] == 0xFF) {
+            const uchar marker = data[position + 1];
+            if (marker == 0xFF) { ++position; continue; }
+            if (isStartOfFrame(marker)) {
+                return validSize(be16(data + position + 7), be16(data + position + 5));
+            }
+            const quint32 length = be16(data + position + 2);
+            if (marker == 0xD9 || marker == 0xDA || length < 2) break;
+            position += 2 + int(length);
+        }
+    }
+    return QSize();
+}
+
+QSize probe(const QString &filePath)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QSize();
+    }
+    uchar header[HeaderBytes];
+    const int headerSize = int(file.read(reinterpret_cast<char *>(header), HeaderBytes));
+    if (headerSize <= 0) {
+        return QSize();
+    }
+    QSize size = parse(header, headerSize);
+    if (!size.isValid() && isJpeg(header, headerSize)) {
+        size = probeJpeg(file);
+    }
+    if (!size.isValid()) {
+        file.close();
+        QImageReader reader(filePath); // TIFF and anything unusual
+        size = reader.size();
+    }
+    return size;
+}
+
+} // namespace ImageHeaderProbe
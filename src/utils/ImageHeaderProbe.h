@@ -0,0 +1,27 @@
+#ifndef IMAGEHEADERPROBE_H
+#define IMAGEHEADERPROBE_H
+
+#include <QSize>
+#include <QString>
+
+class QFile;
+
+// Image dimensions from the first bytes of a file, without going through QImageReader's plugin
+// probing. Knows PNG, JPEG, GIF, BMP and WebP; JPEGs are walked segment by segment with seeks,
+// so a large EXIF/ICC block in front of the frame header is skipped rather than read.
+namespace ImageHeaderProbe {
+
+// Pure parser, no I/O. Returns an invalid size if the format is unknown or the header is cut off.
+QSize parse(const uchar *data, int size);
+
+// Frame size from the SOF marker of an open JPEG file (the file must start with SOI). Walks the
+// segments from the start, reading 9 bytes per segment and seeking over the rest, so EXIF/ICC
+// blocks and their embedded thumbnails are skipped. Invalid size if there is no frame header.
+QSize probeJpeg(QFile &file);
+
+// Stored size (before EXIF rotation). Falls back to QImageReader for other formats (e.g. TIFF).
+QSize probe(const QString &filePath);
+
+} // namespace ImageHeaderProbe
+
+#endif // IMAGEHEADERPROBE_H
@@ -0,0 +1,282 @@
+#include "PackIndexStore.h"
+#include <QDateTime>
+#include <QDir>
+#include <QHash>
+#include <QPair>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+const qint64 IndexHeaderSize = 16;
+const qint64 RecordSize = qint64(sizeof(PackIndexStore::Record));
+const qint64 MinCompactBytes = 4 * 1024 * 1024; // Smaller packs are not worth rewriting
+const char OpenedMarkerName[] = "last_opened";
+static_assert(sizeof(PackIndexStore::Record) == 32, "Index records must stay 32 bytes");
+} // namespace
+
+PackIndexStore::PackIndexStore(const char magic[4], quint32 version)
+    : m_version(version)
+    , m_packMap(nullptr)
+    , m_packMapSize(0)
+{
+    std::memcpy(m_magic, magic, sizeof(m_magic));
+}
+
+PackIndexStore::~PackIndexStore()
+{
+    close();
+}
+
+quint64 PackIndexStore::fnv1a64(const char *data, qint64 size)
+{
+    quint64 hash = 14695981039346656037ULL;
+    for (qint64 i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool PackIndexStore::open(const QString &packPath, const QString &indexPath, const RecordVisitor &visitor)
+{
+    close();
+    m_packFile.setFileName(packPath);
+    m_indexFile.setFileName(indexPath);
+    if (!m_packFile.open(QIODevice::ReadWrite) || !m_indexFile.open(QIODevice::ReadWrite)) {
+        close();
+        return false;
+    }
+
+    const qint64 indexSize = m_indexFile.size();
+    const qint64 packSize = m_packFile.size();
+    bool valid = indexSize >= IndexHeaderSize;
+    if (valid) {
+        uchar *mapped = m_indexFile.map(0, indexSize);
+        if (!mapped) {
+            valid = false;
+        } else {
+            quint32 version = 0;
+            quint32 recordSize = 0;
+            std::memcpy(&version, mapped + 4, sizeof(version));
+            std::memcpy(&recordSize, mapped + 8, sizeof(recordSize));
+            valid = std::memcmp(mapped, m_magic, 4) == 0 && version == m_version && recordSize == quint32(RecordSize);
+            const qint64 recordCount = valid ? (indexSize - IndexHeaderSize) / RecordSize : 0;
+            for (qint64 i = 0; i < recordCount; ++i) {
+                Record record;
+                std::memcpy(&record, mapped + IndexHeaderSize + i * RecordSize, sizeof(record));
+                if (record.offset + record.length > quint64(packSize)) {
+                    continue; // Blob never made it to disk
+                }
+                visitor(record);
+            }
+            m_indexFile.unmap(mapped);
+            if (valid) {
+                m_indexFile.resize(IndexHeaderSize + recordCount * RecordSize);
+            }
+        }
+    }
+
+    if (!valid) { // New or unreadable index, start over
+        m_packFile.resize(0);
+        m_indexFile.resize(0);
+        if (!writeHeader(m_indexFile)) {
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PackIndexStore::writeHeader(QFile &indexFile) const
+{
+    char header[IndexHeaderSize] = {};
+    const quint32 recordSize = quint32(RecordSize);
+    std::memcpy(header, m_magic, 4);
+    std::memcpy(header + 4, &m_version, sizeof(m_version));
+    std::memcpy(header + 8, &recordSize, sizeof(recordSize));
+    if (!indexFile.seek(0) || indexFile.write(header, IndexHeaderSize) != IndexHeaderSize) {
+        return false;
+    }
+    return indexFile.flush();
+}
+
+void PackIndexStore::close()
+{
+    unmapPack();
+    m_packFile.close();
+    m_indexFile.close();
+}
+
+void PackIndexStore::clear()
+{
+    if (!isOpen()) {
+        return;
+    }
+    unmapPack();
+    m_packFile.resize(0);
+    m_indexFile.resize(IndexHeaderSize);
+}
+
+void PackIndexStore::unmapPack()
+{
+    if (m_packMap) {
+        m_packFile.unmap(m_packMap);
+        m_packMap = nullptr;
+        m_packMapSize = 0;
+    }
+}
+
+bool PackIndexStore::append(const char *data, qint64 size, Record *record)
+{
+    if (!isOpen() || !record) {
+        return false;
+    }
+    record->offset = quint64(m_packFile.size());
+    record->length = quint32(size);
+    if (!m_packFile.seek(qint64(record->offset)) || m_packFile.write(data, size) != size || !m_packFile.flush()) {
+        return false;
+    }
+    return appendRecord(*record); // Only now that the blob is on disk
+}
+
+bool PackIndexStore::appendRecord(const Record &record)
+{
+    if (!isOpen()
+        || !m_indexFile.seek(m_indexFile.size())
+        || m_indexFile.write(reinterpret_cast<const char *>(&record), RecordSize) != RecordSize) {
+        return false;
+    }
+    m_indexFile.flush();
+    return true;
+}
+
+bool PackIndexStore::read(const Record &record, void *out)
+{
+    if (record.length == 0) {
+        return true;
+    }
+    const qint64 end = qint64(record.offset) + qint64(record.length);
+    if (end > m_packMapSize) { // Appended since the last mapping
+        unmapPack();
+        const qint64 packSize = m_packFile.size();
+        if (packSize < end || !(m_packMap = m_packFile.map(0, packSize))) {
+            return false;
+        }
+        m_packMapSize = packSize;
+    }
+    std::memcpy(out, m_packMap + record.offset, record.length);
+    return true;
+}
+
+bool PackIndexStore::compactIfSparse(QVector<Record> *records)
+{
+    if (!isOpen() || !records) {
+        return false;
+    }
+    // Blobs are identified by offset and length; an empty blob may share its offset with the next one
+    typedef QPair<quint64, quint32> BlobKey;
+    QHash<BlobKey, quint64> newOffsets;
+    qint64 liveBytes = 0;
+    for (const Record &record : *records) {
+        const BlobKey blobKey(record.offset, record.length);
+        if (!newOffsets.contains(blobKey)) {
+            newOffsets.insert(blobKey, 0);
+            liveBytes += record.length;
+        }
+    }
+    const qint64 packSize = m_packFile.size();
+    if (packSize < MinCompactBytes || liveBytes * 2 >= packSize) {
+        return false;
+    }
+
+    const QString packPath = m_packFile.fileName();
+    const QString indexPath = m_indexFile.fileName();
+    QFile newPack(packPath + ".compact");
+    QFile newIndex(indexPath + ".compact");
+    bool written = newPack.open(QIODevice::WriteOnly | QIODevice::Truncate)
+        && newIndex.open(QIODevice::WriteOnly | QIODevice::Truncate) && writeHeader(newIndex);
+    newOffsets.clear();
+    QByteArray blob;
+    qint64 newPackSize = 0;
+    for (int i = 0; written && i < records->size(); ++i) {
+        Record record = records->at(i);
+        const BlobKey blobKey(record.offset, record.length);
+        auto it = newOffsets.constFind(blobKey);
+        if (it == newOffsets.constEnd()) {
+            blob.resize(qsizetype(record.length));
+            if (!read(record, blob.data()) || newPack.write(blob) != blob.size()) {
+                written = false;
+                break;
+            }
+            it = newOffsets.insert(blobKey, quint64(newPackSize));
+            newPackSize += record.length;
+        }
+        record.offset = it.value();
+        written = newIndex.write(reinterpret_cast<const char *>(&record), RecordSize) == RecordSize;
+    }
+    written = written && newPack.flush() && newIndex.flush();
+    newPack.close();
+    newIndex.close();
+    if (!written) {
+        QFile::remove(newPack.fileName());
+        QFile::remove(newIndex.fileName());
+        return false;
+    }
+
+    close();
+    // Index first: a crash between the steps leaves no index, and the next open starts the cache over
+    // instead of pairing an index with the wrong pack
+    QFile::remove(indexPath);
+    QFile::remove(packPath);
+    QFile::rename(newPack.fileName(), packPath);
+    QFile::rename(newIndex.fileName(), indexPath);
+    records->clear();
+    open(packPath, indexPath, [records](const Record &record) { records->append(record); });
+    return true;
+}
+
+void PackIndexStore::markOpened(const QString &directory)
+{
+    QFile marker(QDir(directory).filePath(OpenedMarkerName));
+    if (marker.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        marker.write(QByteArray::number(QDateTime::currentMSecsSinceEpoch()));
+    }
+}
+
+void PackIndexStore::prune(const QString &rootDirectory, qint64 maxBytes, const QStringList &keepDirectories)
+{
+    struct CacheDirectory {
+        QString path;
+        qint64 openedAt;
+        qint64 bytes;
+    };
+    QVector<CacheDirectory> directories;
+    qint64 totalBytes = 0;
+    const QFileInfoList entries = QDir(rootDirectory).entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QFileInfo &entry : entries) {
+        CacheDirectory directory{entry.absoluteFilePath(), 0, 0};
+        for (const QFileInfo &file : QDir(directory.path).entryInfoList(QDir::Files)) {
+            directory.bytes += file.size();
+        }
+        QFile marker(QDir(directory.path).filePath(OpenedMarkerName));
+        if (marker.open(QIODevice::ReadOnly)) {
+            directory.openedAt = marker.readAll().toLongLong(); // 0 (oldest) if unreadable
+        }
+        totalBytes += directory.bytes;
+        directories.append(directory);
+    }
+    std::sort(directories.begin(), directories.end(), [](const CacheDirectory &a, const CacheDirectory &b) {
+        return a.openedAt < b.openedAt;
+    });
+    for (const CacheDirectory &directory : directories) {
+        if (totalBytes <= maxBytes) {
+            break;
+        }
+        if (keepDirectories.contains(directory.path)) {
+            continue; // In use
+        }
+        if (QDir(directory.path).removeRecursively()) {
+            totalBytes -= directory.bytes;
+        }
+    }
+}
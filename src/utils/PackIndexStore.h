@@ -0,0 +1,72 @@
+#ifndef PACKINDEXSTORE_H
+#define PACKINDEXSTORE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QFile>
+#include <QStringList>
+#include <QVector>
+#include <functional>
+
+// Append-only blob store behind the on-disk caches (thumbnails, tag scores):
+//   <name>.pack - blobs appended back to back
+//   <name>.idx  - 16-byte header {magic, version, record size} followed by fixed 32-byte records
+// A record is appended only after its blob is on disk, and a torn trailing record (crash while
+// appending) is cut off on open, so the index never points past the pack. A header from another
+// format or version drops both files. The pack is memory-mapped for reads and remapped as it grows.
+// Superseded blobs stay in the pack until the owner compacts it (compactIfSparse, on open).
+// Not thread-safe; the owning cache serializes access with its own mutex.
+class PackIndexStore
+{
+public:
+    struct Record { // Written as-is; naturally 32 bytes with no padding
+        quint64 key = 0;
+        quint64 secondaryKey = 0; // Second lookup key, 0 if unused
+        quint64 offset = 0;
+        quint32 length = 0;       // Bytes
+        quint32 tag = 0;          // Caller-defined (e.g. blob format)
+    };
+
+    typedef std::function<void(const Record &)> RecordVisitor;
+
+    PackIndexStore(const char magic[4], quint32 version);
+    ~PackIndexStore();
+
+    // Opens or creates both files and calls visitor for each intact record, oldest first
+    bool open(const QString &packPath, const QString &indexPath, const RecordVisitor &visitor);
+    void close();
+    void clear(); // Drops every record and blob
+    bool isOpen() const { return m_indexFile.isOpen(); }
+
+    // Writes the blob, fills record->offset/length, then appends the record
+    bool append(const char *data, qint64 size, Record *record);
+    bool appendRecord(const Record &record); // Another key for a blob already in the pack
+    bool read(const Record &record, void *out); // Copies record.length bytes
+
+    // Rewrites both files with only the given live records once their blobs fill less than half of
+    // a pack of a few MB or more; a blob shared by several records is copied once. Returns true if
+    // the files were replaced, with records reloaded from the new index (empty, and the store
+    // closed or started over, if the new files could not be put in place); false if nothing changed.
+    bool compactIfSparse(QVector<Record> *records);
+
+    // Least-recently-opened eviction over sibling cache directories (one store each) under a root:
+    // markOpened() stamps a directory, prune() removes the oldest others until the total fits.
+    static void markOpened(const QString &directory);
+    static void prune(const QString &rootDirectory, qint64 maxBytes, const QStringList &keepDirectories);
+
+    static quint64 fnv1a64(const char *data, qint64 size);
+    static quint64 fnv1a64(const QByteArray &data) { return fnv1a64(data.constData(), data.size()); }
+
+private:
+    bool writeHeader(QFile &indexFile) const;
+    void unmapPack();
+
+    char m_magic[4];
+    quint32 m_version;
+    QFile m_packFile;
+    QFile m_indexFile;
+    uchar *m_packMap;
+    qint64 m_packMapSize;
+};
+
+#endif // PACKINDEXSTORE_H
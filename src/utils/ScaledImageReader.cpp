@@ -0,0 +1,56 @@
+#include "ScaledImageReader.h"
+#include <QImageReader>
+#include <QImageIOHandler>
+
+namespace ScaledImageReader {
+
+static QImage readWith(QImageReader &reader, const QSize &boundingSize, QString *errorString, QSize *sourceSize)
+{
+    reader.setAutoTransform(true);
+
+    const QSize storedSize = reader.size(); // As stored in the file, before EXIF rotation
+    if (sourceSize) {
+        *sourceSize = storedSize;
+        if (storedSize.isValid() && (reader.transformation() & QImageIOHandler::TransformationRotate90)) {
+            sourceSize->transpose();
+        }
+    }
+    if (boundingSize.isValid() && !boundingSize.isEmpty() && storedSize.isValid()) {
+        // setScaledSize() works on the stored orientation, so rotate the box instead of the image
+        QSize storedBounding = boundingSize;
+        if (reader.transformation() & QImageIOHandler::TransformationRotate90) {
+            storedBounding.transpose();
+        }
+        // Oversample 2x so the final smooth resize still has detail to work with
+        const QSize decodeSize = storedSize.scaled(storedBounding * 2, Qt::KeepAspectRatio);
+        if (decodeSize.width() < storedSize.width() && decodeSize.height() < storedSize.height()
+            && decodeSize.width() > 0 && decodeSize.height() > 0) {
+            reader.setScaledSize(decodeSize);
+        }
+    }
+
+    QImage image = reader.read();
+    if (image.isNull()) {
+        if (errorString) *errorString = reader.errorString();
+        return image;
+    }
+    if (boundingSize.isValid() && !boundingSize.isEmpty()
+        && image.size() != image.size().scaled(boundingSize, Qt::KeepAspectRatio)) {
+        image = image.scaled(boundingSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+    return image;
+}
+
+QImage read(const QString &filePath, const QSize &boundingSize, QString *errorString, QSize *sourceSize)
+{
+    QImageReader reader(filePath);
+    return readWith(reader, boundingSize, errorString, sourceSize);
+}
+
+QImage read(QIODevice *device, const QSize &boundingSize, QString *errorString, QSize *sourceSize)
+{
+    QImageReader reader(device);
+    return readWith(reader, boundingSize, errorString, sourceSize);
+}
+
+} // namespace ScaledImageReader
@@ -0,0 +1,23 @@
+#ifndef SCALEDIMAGEREADER_H
+#define SCALEDIMAGEREADER_H
+
+#include <QImage>
+#include <QSize>
+#include <QString>
+
+class QIODevice;
+
+// Decodes an image and fits it into boundingSize (aspect ratio kept, EXIF orientation applied),
+// without decoding more pixels than that needs. An invalid boundingSize means full size.
+// The decoder is asked for roughly twice the final size via QImageReader::setScaledSize, which the JPEG
+// plugin turns into libjpeg's DCT-domain 1/2..1/8 scaling, and a smooth resize produces the final image.
+// Formats without reduced decoding fall back to a full decode followed by the same resize.
+// sourceSize, if given, receives the full image size (after EXIF rotation) from the same header parse.
+namespace ScaledImageReader {
+
+QImage read(const QString &filePath, const QSize &boundingSize, QString *errorString = nullptr, QSize *sourceSize = nullptr);
+QImage read(QIODevice *device, const QSize &boundingSize, QString *errorString = nullptr, QSize *sourceSize = nullptr);
+
+} // namespace ScaledImageReader
+
+#endif // SCALEDIMAGEREADER_H
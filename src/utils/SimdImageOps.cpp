@@ -0,0 +1,107 @@
+#include "SimdImageOps.h"
+#include <QRgb>
+#include <algorithm>
+
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+#  if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    include <emmintrin.h>
+#    define SIMDIMAGEOPS_SSE2
+#  elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#    include <arm_neon.h>
+#    define SIMDIMAGEOPS_NEON
+#  endif
+#endif
+
+namespace SimdImageOps {
+
+void fill(float *dst, size_t count, float value)
+{
+    std::fill(dst, dst + count, value);
+}
+
+// Premultiplied colour over white: c + 255 * (1 - a / 255) == c + 255 - a.
+// Opaque pixels (a == 255, always the case for Format_RGB32) pass through unchanged.
+static inline void convertScalar(const uchar *src, int pixelCount, float *dst)
+{
+    const QRgb *pixels = reinterpret_cast<const QRgb *>(src);
+    for (int i = 0; i < pixelCount; ++i) {
+        const QRgb pixel = pixels[i];
+        const int background = 255 - qAlpha(pixel);
+        dst[0] = static_cast<float>(qBlue(pixel) + background);
+        dst[1] = static_cast<float>(qGreen(pixel) + background);
+        dst[2] = static_cast<float>(qRed(pixel) + background);
+        dst += 3;
+    }
+}
+
+#if defined(SIMDIMAGEOPS_SSE2)
+
+// One pixel in, four floats out (B, G, R, 255). Consecutive stores overlap by one float, so the
+// fourth lane is always overwritten by the next pixel's blue and never lands past the scanline.
+static inline void storePixelSse2(__m128i bgra32, __m128i white, float *dst)
+{
+    const __m128i alpha = _mm_shuffle_epi32(bgra32, _MM_SHUFFLE(3, 3, 3, 3));
+    const __m128i composited = _mm_add_epi32(bgra32, _mm_sub_epi32(white, alpha));
+    _mm_storeu_ps(dst, _mm_cvtepi32_ps(composited));
+}
+
+void bgraScanlineToBgrFloat(const uchar *src, int pixelCount, float *dst)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i white = _mm_set1_epi32(255);
+    int i = 0;
+    for (; i + 4 < pixelCount; i += 4) { // Keep at least one pixel for the tail so the last overlapping store stays in bounds
+        const __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4));
+        const __m128i lo16 = _mm_unpacklo_epi8(packed, zero); // Pixels 0-1 as u16
+        const __m128i hi16 = _mm_unpackhi_epi8(packed, zero); // Pixels 2-3 as u16
+        float *out = dst + i * 3;
+        storePixelSse2(_mm_unpacklo_epi16(lo16, zero), white, out);
+        storePixelSse2(_mm_unpackhi_epi16(lo16, zero), white, out + 3);
+        storePixelSse2(_mm_unpacklo_epi16(hi16, zero), white, out + 6);
+        storePixelSse2(_mm_unpackhi_epi16(hi16, zero), white, out + 9);
+    }
+    convertScalar(src + i * 4, pixelCount - i, dst + i * 3);
+}
+
+#elif defined(SIMDIMAGEOPS_NEON)
+
+static inline float32x4_t toFloat(uint16x4_t values)
+{
+    return vcvtq_f32_u32(vmovl_u16(values));
+}
+
+void bgraScanlineToBgrFloat(const uchar *src, int pixelCount, float *dst)
+{
+    int i = 0;
+    for (; i + 8 <= pixelCount; i += 8) {
+        const uint8x8x4_t bgra = vld4_u8(src + i * 4); // De-interleaves 8 pixels into B, G, R, A lanes
+        const uint8x8_t background = vmvn_u8(bgra.val[3]); // 255 - a
+        const uint16x8_t b = vmovl_u8(vadd_u8(bgra.val[0], background));
+        const uint16x8_t g = vmovl_u8(vadd_u8(bgra.val[1], background));
+        const uint16x8_t r = vmovl_u8(vadd_u8(bgra.val[2], background));
+
+        float32x4x3_t low;
+        low.val[0] = toFloat(vget_low_u16(b));
+        low.val[1] = toFloat(vget_low_u16(g));
+        low.val[2] = toFloat(vget_low_u16(r));
+        vst3q_f32(dst + i * 3, low); // Re-interleaves as B, G, R
+
+        float32x4x3_t high;
+        high.val[0] = toFloat(vget_high_u16(b));
+        high.val[1] = toFloat(vget_high_u16(g));
+        high.val[2] = toFloat(vget_high_u16(r));
+        vst3q_f32(dst + i * 3 + 12, high);
+    }
+    convertScalar(src + i * 4, pixelCount - i, dst + i * 3);
+}
+
+#else
+
+void bgraScanlineToBgrFloat(const uchar *src, int pixelCount, float *dst)
+{
+    convertScalar(src, pixelCount, dst);
+}
+
+#endif
+
+} // namespace SimdImageOps
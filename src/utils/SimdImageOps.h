@@ -0,0 +1,21 @@
+#ifndef SIMDIMAGEOPS_H
+#define SIMDIMAGEOPS_H
+
+#include <QtGlobal>
+#include <cstddef>
+
+// Scanline kernels for turning decoded images into model input tensors.
+// SSE2 on x86-64, NEON on ARM, plain C++ everywhere else.
+namespace SimdImageOps {
+
+// Fills count floats with value (used for the letterbox padding)
+void fill(float *dst, size_t count, float value);
+
+// Converts pixelCount pixels of a QImage::Format_RGB32 or Format_ARGB32_Premultiplied scanline
+// into packed B,G,R floats in [0, 255], compositing translucent pixels onto white.
+// Writes exactly pixelCount * 3 floats.
+void bgraScanlineToBgrFloat(const uchar *src, int pixelCount, float *dst);
+
+} // namespace SimdImageOps
+
+#endif // SIMDIMAGEOPS_H
@@ -0,0 +1,73 @@
+#include "SimdScoreOps.h"
+#include <QtAlgorithms>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define SIMDSCOREOPS_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#  include <arm_neon.h>
+#  define SIMDSCOREOPS_NEON
+#endif
+
+namespace SimdScoreOps {
+
+static inline size_t indicesAboveScalar(const float *scores, size_t begin, size_t count, float threshold,
+                                        quint32 *indicesOut, size_t written)
+{
+    for (size_t i = begin; i < count; ++i) {
+        indicesOut[written] = static_cast<quint32>(i);
+        written += scores[i] > threshold ? 1 : 0; // Branchless: the slot is simply reused on a miss
+    }
+    return written;
+}
+
+#if defined(SIMDSCOREOPS_SSE2)
+
+size_t indicesAbove(const float *scores, size_t count, float threshold, quint32 *indicesOut)
+{
+    const __m128 limit = _mm_set1_ps(threshold);
+    size_t written = 0;
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        // One 16-bit mask per 16 scores; hits are rare, so most iterations end at the zero test
+        unsigned mask = unsigned(_mm_movemask_ps(_mm_cmpgt_ps(_mm_loadu_ps(scores + i), limit)))
+            | unsigned(_mm_movemask_ps(_mm_cmpgt_ps(_mm_loadu_ps(scores + i + 4), limit))) << 4
+            | unsigned(_mm_movemask_ps(_mm_cmpgt_ps(_mm_loadu_ps(scores + i + 8), limit))) << 8
+            | unsigned(_mm_movemask_ps(_mm_cmpgt_ps(_mm_loadu_ps(scores + i + 12), limit))) << 12;
+        while (mask) {
+            indicesOut[written++] = static_cast<quint32>(i + qCountTrailingZeroBits(mask));
+            mask &= mask - 1;
+        }
+    }
+    return indicesAboveScalar(scores, i, count, threshold, indicesOut, written);
+}
+
+#elif defined(SIMDSCOREOPS_NEON)
+
+size_t indicesAbove(const float *scores, size_t count, float threshold, quint32 *indicesOut)
+{
+    const float32x4_t limit = vdupq_n_f32(threshold);
+    size_t written = 0;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const uint32x4_t low = vcgtq_f32(vld1q_f32(scores + i), limit);
+        const uint32x4_t high = vcgtq_f32(vld1q_f32(scores + i + 4), limit);
+        const uint16x8_t both = vcombine_u16(vmovn_u32(low), vmovn_u32(high));
+        if (vgetq_lane_u64(vreinterpretq_u64_u16(both), 0) == 0 && vgetq_lane_u64(vreinterpretq_u64_u16(both), 1) == 0) {
+            continue; // No hit among these 8
+        }
+        written = indicesAboveScalar(scores, i, i + 8, threshold, indicesOut, written);
+    }
+    return indicesAboveScalar(scores, i, count, threshold, indicesOut, written);
+}
+
+#else
+
+size_t indicesAbove(const float *scores, size_t count, float threshold, quint32 *indicesOut)
+{
+    return indicesAboveScalar(scores, 0, count, threshold, indicesOut, 0);
+}
+
+#endif
+
+} // namespace SimdScoreOps
@@ -0,0 +1,17 @@
+#ifndef SIMDSCOREOPS_H
+#define SIMDSCOREOPS_H
+
+#include <QtGlobal>
+#include <cstddef>
+
+// Kernels over tagger output rows (~10k sigmoid scores per image, nearly all close to zero).
+// SSE2 on x86-64, NEON on ARM, plain C++ everywhere else.
+namespace SimdScoreOps {
+
+// Writes the indices of the scores strictly greater than threshold to indicesOut, in ascending
+// order, and returns how many were written. indicesOut must have room for count entries.
+size_t indicesAbove(const float *scores, size_t count, float threshold, quint32 *indicesOut);
+
+} // namespace SimdScoreOps
+
+#endif // SIMDSCOREOPS_H
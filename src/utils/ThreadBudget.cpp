@@ -0,0 +1,171 @@
+#include "ThreadBudget.h"
+#include <QThread>
+#include <QStringList>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDebug>
+#include <algorithm>
+#ifdef Q_OS_LINUX
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#endif
+
+namespace ThreadBudget {
+
+int logicalProcessors()
+{
+    return qMax(1, QThread::idealThreadCount());
+}
+
+int thumbnailThreads()
+{
+    return qBound(1, logicalProcessors() / 2, 4); // Mostly I/O bound, more threads only add contention
+}
+
+int thumbnailThreadsForStorage(const QString &path, int overrideCount)
+{
+    if (overrideCount > 0) {
+        return qMin(overrideCount, thumbnailThreads()); // More would eat into the inference budget
+    }
+    if (isRotationalStorage(path)) {
+        return qMin(2, thumbnailThreads()); // One reading while the other decodes
+    }
+    return thumbnailThreads();
+}
+
+bool isRotationalStorage(const QString &path)
+{
+#ifdef Q_OS_LINUX
+    struct stat info;
+    if (stat(QFile::encodeName(path).constData(), &info) != 0) {
+        return false;
+    }
+    const QString devicePath = QFileInfo(QString("/sys/dev/block/%1:%2").arg(major(info.st_dev)).arg(minor(info.st_dev))).canonicalFilePath();
+    // Partitions have no queue/ of their own, it lives on the parent disk
+    for (QString directory = devicePath; directory.startsWith("/sys/devices/"); directory = QFileInfo(directory).path()) {
+        QFile rotational(directory + "/queue/rotational");
+        if (rotational.open(QIODevice::ReadOnly)) {
+            return rotational.readAll().trimmed() == "1";
+        }
+    }
+#else
+    Q_UNUSED(path);
+#endif
+    return false;
+}
+
+int bulkDecodeThreads()
+{
+    return qBound(1, logicalProcessors() / 4, 4);
+}
+
+int inferenceThreads()
+{
+    return qMax(1, logicalProcessors() - thumbnailThreads());
+}
+
+QVector<QVector<int>> numaNodeProcessors()
+{
+    QVector<QVector<int>> nodes;
+#ifdef Q_OS_LINUX
+    QDir nodeRoot("/sys/devices/system/node");
+    QStringList nodeNames = nodeRoot.entryList({"node*"}, QDir::Dirs);
+    std::sort(nodeNames.begin(), nodeNames.end(), [](const QString &a, const QString &b) {
+        return a.mid(4).toInt() < b.mid(4).toInt();
+    });
+    for (const QString &nodeName : nodeNames) {
+        QFile cpuList(nodeRoot.filePath(nodeName + "/cpulist"));
+        if (!cpuList.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+        QVector<int> processors;
+        for (const QByteArray &range : cpuList.readAll().trimmed().split(',')) { // e.g. "0-7,16-23"
+            const QList<QByteArray> bounds = range.split('-');
+            bool firstOk = false;
+            bool lastOk = false;
+            const int first = bounds.value(0).toInt(&firstOk);
+            const int last = bounds.size() > 1 ? bounds.at(1).toInt(&lastOk) : first;
+            if (!firstOk || (bounds.size() > 1 && !lastOk)) {
+                continue;
+            }
+            for (int processor = first; processor <= last && processor < logicalProcessors(); ++processor) {
+                processors.append(processor);
+            }
+        }
+        if (!processors.isEmpty()) {
+            nodes.append(processors);
+        }
+    }
+#endif
+    if (nodes.isEmpty()) {
+        QVector<int> processors;
+        for (int processor = 0; processor < logicalProcessors(); ++processor) {
+            processors.append(processor);
+        }
+        nodes.append(processors);
+    }
+    return nodes;
+}
+
+int resolveInferenceSessions(int requested)
+{
+    // ViT inference stops scaling within one session at around 8 threads, so "auto" adds a session
+    // per 8 processors of budget; several sessions then run batches side by side
+    const int available = qMax(1, inferenceThreads() / 2);
+    if (requested <= 0) {
+        return qMax(1, inferenceThreads() / 8);
+    }
+    return qMin(requested, available);
+}
+
+int resolveIntraOpThreads(int requested, int sessionCount)
+{
+    const int available = qMax(1, inferenceThreads() / qMax(1, sessionCount));
+    if (requested <= 0) {
+        return available;
+    }
+    if (requested > available) {
+        qWarning() << "ThreadBudget: Requested" << requested << "intra-op threads, only" << available << "available. Clamping.";
+        return available;
+    }
+    return requested;
+}
+
+int resolveInterOpThreads(int requested, int intraOpThreads, bool parallelExecution, int sessionCount)
+{
+    if (!parallelExecution) {
+        return 1; // The inter-op pool is only used by ORT_PARALLEL
+    }
+    // Each inter-op task can fan out to the intra-op pool
+    const int available = qMax(1, inferenceThreads() / qMax(1, sessionCount) / qMax(1, intraOpThreads));
+    if (requested <= 0) {
+        return available;
+    }
+    return qMin(requested, available);
+}
+
+QString pinnedIntraOpAffinities(int intraOpThreads, int sessionIndex)
+{
+    const int workerThreads = intraOpThreads - 1;
+    if (workerThreads <= 0) {
+        return QString();
+    }
+    // Node-major order, so consecutive blocks fill one node before moving on to the next.
+    // Thumbnail and bulk decode threads are not pinned anywhere; they are left to the scheduler.
+    QVector<int> processors;
+    for (const QVector<int> &node : numaNodeProcessors()) {
+        processors += node;
+    }
+    const int first = qMax(0, sessionIndex) * intraOpThreads; // The calling thread's slot is part of each block
+    if (first + workerThreads > processors.size()) {
+        return QString();
+    }
+    QStringList affinities;
+    for (int i = 0; i < workerThreads; ++i) {
+        affinities.append(QString::number(processors.at(first + i) + 1)); // ORT processor ids are 1-based
+    }
+    return affinities.join(';');
+}
+
+} // namespace ThreadBudget
@@ -0,0 +1,39 @@
+#ifndef THREADBUDGET_H
+#define THREADBUDGET_H
+
+#include <QString>
+#include <QVector>
+
+// Splits the machine's logical processors between the I/O side (thumbnail workers, global
+// thread pool, bulk caption decoders) and ONNX Runtime inference so they don't oversubscribe.
+namespace ThreadBudget {
+
+int logicalProcessors();
+int thumbnailThreads();   // Thumbnail workers and the global QThreadPool
+// Thumbnail decode threads for a dataset at the given path: fewer on spinning disks, where
+// parallel reads just turn into seeks. A positive override (user setting) wins, up to thumbnailThreads().
+int thumbnailThreadsForStorage(const QString &path, int overrideCount = 0);
+bool isRotationalStorage(const QString &path); // Linux only, false elsewhere or if unknown
+int bulkDecodeThreads();  // Image decoders feeding a bulk caption job
+int inferenceThreads();   // What is left for the intra-op pool ("auto"), shared by all sessions
+
+// Logical processors (0-based) of each NUMA node. One node holding every processor when the
+// topology is flat or unknown (anything but Linux).
+QVector<QVector<int>> numaNodeProcessors();
+
+// Resolves the requested counts (0 = auto) against the budget. With several inference sessions
+// the intra-op budget is split between them.
+int resolveInferenceSessions(int requested);
+int resolveIntraOpThreads(int requested, int sessionCount = 1);
+int resolveInterOpThreads(int requested, int intraOpThreads, bool parallelExecution, int sessionCount = 1);
+
+// Value for ORT's "session.intra_op_thread_affinities": pins each intra-op worker thread
+// (the calling thread is not part of the list) to its own logical processor. Session i gets the
+// i-th block of intraOpThreads processors, taken node by node so a session stays on one NUMA
+// node where the block fits.
+// Empty if there are not enough processors to do so.
+QString pinnedIntraOpAffinities(int intraOpThreads, int sessionIndex = 0);
+
+} // namespace ThreadBudget
+
+#endif // THREADBUDGET_H